@@ -19,6 +19,9 @@
 //
 
 #include <immer/detail/ref_count_base.hpp>
+#include <immer/refcount/biased_refcount_policy.hpp>
+#include <immer/refcount/refcount_policy.hpp>
+#include <immer/refcount/unsafe_refcount_policy.hpp>
 
 #include <nonius/nonius_single.h++>
 #include <boost/intrusive_ptr.hpp>
@@ -29,6 +32,7 @@
 #include <memory>
 #include <utility>
 #include <array>
+#include <thread>
 #include <vector>
 
 constexpr auto benchmark_size = 32u;
@@ -154,3 +158,85 @@ NONIUS_BENCHMARK("manual - memcopy", [] (nonius::chronometer meter)
         return r;
     });
 })
+
+template <typename RefcountPolicy>
+auto benchmark_policy_inc_dec()
+{
+    return [] (nonius::chronometer meter)
+    {
+        std::array<RefcountPolicy, benchmark_size> objs;
+        auto r = 0;
+        meter.measure([&] {
+            for (auto& x : objs)
+                x.inc();
+            for (auto& x : objs)
+                r += x.dec();
+            return r;
+        });
+    };
+}
+
+template <typename RefcountPolicy>
+auto benchmark_policy_release()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto objs = std::vector<std::array<RefcountPolicy, benchmark_size>>(
+            meter.runs());
+        auto r = 0;
+        meter.measure([&] (int i) {
+            for (auto& x : objs[i])
+                r += x.dec();
+            return r;
+        });
+    };
+}
+
+// Objects are created by the benchmark thread and then copied and
+// dropped by a few others, like the nodes of a container that is
+// shared with worker threads.
+template <typename RefcountPolicy>
+auto benchmark_policy_handoff()
+{
+    return [] (nonius::chronometer meter)
+    {
+        constexpr auto handoff_size = benchmark_size * 1024u;
+        constexpr auto handoff_threads = 4u;
+        auto objs = std::vector<RefcountPolicy>(handoff_size);
+        meter.measure([&] {
+            auto r = std::atomic<int>{0};
+            auto threads = std::vector<std::thread>{};
+            for (auto i = 0u; i < handoff_threads; ++i)
+                threads.emplace_back([&] {
+                    auto n = 0;
+                    for (auto& x : objs) {
+                        x.inc();
+                        n += x.dec();
+                    }
+                    r += n;
+                });
+            for (auto& t : threads)
+                t.join();
+            return r.load();
+        });
+    };
+}
+
+NONIUS_BENCHMARK("policy - inc dec - refcount",
+                 benchmark_policy_inc_dec<immer::refcount_policy>())
+NONIUS_BENCHMARK("policy - inc dec - biased",
+                 benchmark_policy_inc_dec<immer::biased_refcount_policy>())
+NONIUS_BENCHMARK("policy - inc dec - unsafe",
+                 benchmark_policy_inc_dec<immer::unsafe_refcount_policy>())
+
+NONIUS_BENCHMARK("policy - release - refcount",
+                 benchmark_policy_release<immer::refcount_policy>())
+NONIUS_BENCHMARK("policy - release - biased",
+                 benchmark_policy_release<immer::biased_refcount_policy>())
+NONIUS_BENCHMARK("policy - release - unsafe",
+                 benchmark_policy_release<immer::unsafe_refcount_policy>())
+
+NONIUS_BENCHMARK("policy - handoff - refcount",
+                 benchmark_policy_handoff<immer::refcount_policy>())
+NONIUS_BENCHMARK("policy - handoff - biased",
+                 benchmark_policy_handoff<immer::biased_refcount_policy>())
@@ -26,6 +26,7 @@
 #include <immer/array.hpp>
 #include <immer/flex_vector.hpp>
 #include <immer/vector.hpp>
+#include <immer/heap/slab_heap.hpp>
 
 #if IMMER_BENCHMARK_EXPERIMENTAL
 #include <immer/experimental/dvektor.hpp>
@@ -290,6 +291,25 @@ auto generic_reduce()
     };
 }
 
+template <typename Vektor,
+          typename PushFn=push_back_fn>
+auto generic_parallel_reduce()
+{
+    return [] (nonius::parameters params)
+    {
+        auto n = params.get<N>();
+
+        auto v = Vektor{};
+        for (auto i = 0u; i < n; ++i)
+            v = PushFn{}(std::move(v), i);
+
+        return [=] {
+            auto volatile x = immer::parallel_accumulate(v, 0u);
+            return x;
+        };
+    };
+}
+
 template <typename Vektor,
           typename PushFn=push_back_fn>
 auto generic_random()
@@ -314,6 +334,9 @@ auto generic_random()
 };
 
 using def_memory = immer::default_memory_policy;
+using slab_memory = immer::memory_policy<
+    immer::free_list_heap_policy<immer::slab_heap<>>,
+    immer::default_refcount_policy>;
 
 NONIUS_BENCHMARK("flex/5B",     generic_iter<immer::flex_vector<unsigned,def_memory,5>>())
 NONIUS_BENCHMARK("flex/F/5B",   generic_iter<immer::flex_vector<unsigned,def_memory,5>,push_front_fn>())
@@ -336,6 +359,7 @@ NONIUS_BENCHMARK("flex/F/5B/idx",   generic_idx<immer::flex_vector<unsigned,def_
 NONIUS_BENCHMARK("vector/4B/idx",   generic_idx<immer::vector<unsigned,def_memory,4>>())
 NONIUS_BENCHMARK("vector/5B/idx",   generic_idx<immer::vector<unsigned,def_memory,5>>())
 NONIUS_BENCHMARK("vector/6B/idx",   generic_idx<immer::vector<unsigned,def_memory,6>>())
+NONIUS_BENCHMARK("vector/5B/idx/slab", generic_idx<immer::vector<unsigned,slab_memory,5>>())
 #if IMMER_BENCHMARK_EXPERIMENTAL
 NONIUS_BENCHMARK("dvektor/4B/idx",  generic_idx<immer::dvektor<unsigned,def_memory,4>>())
 NONIUS_BENCHMARK("dvektor/5B/idx",  generic_idx<immer::dvektor<unsigned,def_memory,5>>())
@@ -348,6 +372,10 @@ NONIUS_BENCHMARK("vector/4B/reduce", generic_reduce<immer::vector<unsigned,def_m
 NONIUS_BENCHMARK("vector/5B/reduce", generic_reduce<immer::vector<unsigned,def_memory,5>>())
 NONIUS_BENCHMARK("vector/6B/reduce", generic_reduce<immer::vector<unsigned,def_memory,6>>())
 
+NONIUS_BENCHMARK("flex/5B/preduce",   generic_parallel_reduce<immer::flex_vector<unsigned,def_memory,5>>())
+NONIUS_BENCHMARK("flex/F/5B/preduce", generic_parallel_reduce<immer::flex_vector<unsigned,def_memory,5>,push_front_fn>())
+NONIUS_BENCHMARK("vector/5B/preduce", generic_parallel_reduce<immer::vector<unsigned,def_memory,5>>())
+
 #if IMMER_BENCHMARK_STEADY
 NONIUS_BENCHMARK("steady/random",      generic_random<steady::vector<unsigned>>())
 #endif
@@ -357,6 +385,7 @@ NONIUS_BENCHMARK("flex/F/5B/random",   generic_random<immer::flex_vector<unsigne
 NONIUS_BENCHMARK("vector/4B/random",   generic_random<immer::vector<unsigned,def_memory,4>>())
 NONIUS_BENCHMARK("vector/5B/random",   generic_random<immer::vector<unsigned,def_memory,5>>())
 NONIUS_BENCHMARK("vector/6B/random",   generic_random<immer::vector<unsigned,def_memory,6>>())
+NONIUS_BENCHMARK("vector/5B/random/slab", generic_random<immer::vector<unsigned,slab_memory,5>>())
 #if IMMER_BENCHMARK_EXPERIMENTAL
 NONIUS_BENCHMARK("dvektor/4B/random",  generic_random<immer::dvektor<unsigned,def_memory,4>>())
 NONIUS_BENCHMARK("dvektor/5B/random",  generic_random<immer::dvektor<unsigned,def_memory,5>>())
@@ -0,0 +1,147 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <nonius/nonius_single.h++>
+
+#include <immer/atom.hpp>
+#include <immer/vector.hpp>
+#include <immer/vector_transient.hpp>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+NONIUS_PARAM(N, std::size_t{1000})
+
+constexpr auto background_threads = 4u;
+
+using vector_t = immer::vector<unsigned>;
+
+// The traditional way of sharing a value between threads: every
+// access copies the vector while holding a mutex, and writers compute
+// the new version inside the critical section.
+struct mutex_box
+{
+    mutable std::mutex mutex;
+    vector_t value;
+
+    mutex_box(vector_t v) : value{std::move(v)} {}
+
+    vector_t load() const
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        return value;
+    }
+
+    template <typename Fn>
+    vector_t update(Fn&& fn)
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        return value = fn(value);
+    }
+};
+
+using atom_box = immer::atom<vector_t>;
+
+// Runs `fn` repeatedly in `count` threads until destroyed.
+struct background
+{
+    std::atomic<bool> done {false};
+    std::vector<std::thread> threads;
+
+    background(unsigned count, std::function<void()> fn)
+    {
+        for (auto i = 0u; i < count; ++i)
+            threads.emplace_back([this, fn] {
+                while (!done.load(std::memory_order_relaxed))
+                    fn();
+            });
+    }
+
+    ~background()
+    {
+        done = true;
+        for (auto& t : threads)
+            t.join();
+    }
+};
+
+auto make_vector(std::size_t n)
+{
+    auto v = vector_t{}.transient();
+    for (auto i = 0u; i < n; ++i)
+        v.push_back(i);
+    return v.persistent();
+}
+
+// Readers load the current version while other threads keep
+// publishing new ones.
+template <typename Box>
+auto generic_load()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+        Box box{make_vector(n)};
+        background writers{background_threads, [&] {
+            box.update([] (auto v) {
+                auto i = v[0] % v.size();
+                return v.set(0, v[0] + 1).set(i, v[i] + 1);
+            });
+        }};
+
+        meter.measure([&] {
+            auto r = 0u;
+            for (auto i = 0u; i < n; ++i)
+                r += box.load()[i];
+            return r;
+        });
+    };
+}
+
+// One writer publishes new versions while other threads keep loading
+// the current one.
+template <typename Box>
+auto generic_update()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+        Box box{make_vector(n)};
+        background readers{background_threads, [&] {
+            auto v = box.load();
+            volatile auto x = v[v.size() / 2];
+            (void) x;
+        }};
+
+        meter.measure([&] {
+            for (auto i = 0u; i < n; ++i)
+                box.update([&] (auto v) { return v.set(i, v[i] + 1); });
+            return box.load();
+        });
+    };
+}
+
+NONIUS_BENCHMARK("load/mutex",   generic_load<mutex_box>())
+NONIUS_BENCHMARK("load/atom",    generic_load<atom_box>())
+NONIUS_BENCHMARK("update/mutex", generic_update<mutex_box>())
+NONIUS_BENCHMARK("update/atom",  generic_update<atom_box>())
@@ -0,0 +1,116 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <nonius/nonius_single.h++>
+
+#include <immer/atom.hpp>
+#include <immer/epoch_atom.hpp>
+#include <immer/vector.hpp>
+#include <immer/vector_transient.hpp>
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Contention between readers grows with their number, sweep it with
+// something like `-p readers:*:1:2:7` to measure from 1 to 64 threads.
+NONIUS_PARAM(N, std::size_t{1000})
+NONIUS_PARAM(readers, 1u)
+
+using vector_t = immer::vector<unsigned>;
+
+// Runs `fn` repeatedly in `count` threads until destroyed.
+struct background
+{
+    std::atomic<bool> done {false};
+    std::vector<std::thread> threads;
+
+    background(unsigned count, std::function<void()> fn)
+    {
+        for (auto i = 0u; i < count; ++i)
+            threads.emplace_back([this, fn] {
+                while (!done.load(std::memory_order_relaxed))
+                    fn();
+            });
+    }
+
+    ~background()
+    {
+        done = true;
+        for (auto& t : threads)
+            t.join();
+    }
+};
+
+auto make_vector(std::size_t n)
+{
+    auto v = vector_t{}.transient();
+    for (auto i = 0u; i < n; ++i)
+        v.push_back(i);
+    return v.persistent();
+}
+
+struct atom_reader
+{
+    template <typename Fn>
+    static auto read(const immer::atom<vector_t>& box, Fn&& fn)
+    { return fn(box.load()); }
+};
+
+struct epoch_reader
+{
+    template <typename Fn>
+    static auto read(const immer::epoch_atom<vector_t>& box, Fn&& fn)
+    { return box.read(fn); }
+};
+
+// The measured thread and `readers - 1` other ones look up elements
+// of the current version, each lookup being a separate read, while
+// one writer keeps publishing new versions.
+template <typename Box, typename Reader>
+auto generic_read()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+        Box box{make_vector(n)};
+        auto lookup = [n] (std::size_t i) {
+            return [i, n] (const vector_t& v) { return v[i % n]; };
+        };
+        background others{meter.param<readers>() - 1, [&] {
+            volatile auto x = Reader::read(box, lookup(n / 2));
+            (void) x;
+        }};
+        background writer{1, [&] {
+            box.update([] (auto v) { return v.set(0, v[0] + 1); });
+        }};
+
+        meter.measure([&] {
+            auto r = 0u;
+            for (auto i = 0u; i < n; ++i)
+                r += Reader::read(box, lookup(i));
+            return r;
+        });
+    };
+}
+
+NONIUS_BENCHMARK("read/atom",  generic_read<immer::atom<vector_t>, atom_reader>())
+NONIUS_BENCHMARK("read/epoch", generic_read<immer::epoch_atom<vector_t>, epoch_reader>())
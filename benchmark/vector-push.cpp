@@ -116,6 +116,23 @@ auto generic_move()
     };
 };
 
+template <typename Vektor>
+auto generic_range()
+{
+    return [] (nonius::chronometer meter)
+    {
+        auto n = meter.param<N>();
+        if (n > get_limit<Vektor>{})
+            nonius::skip();
+
+        auto data = std::vector<unsigned>(n);
+        std::iota(data.begin(), data.end(), 0u);
+        measure(meter, [&] {
+            return Vektor(data.data(), data.data() + n);
+        });
+    };
+};
+
 template <typename Vektor>
 auto generic()
 {
@@ -151,6 +168,10 @@ NONIUS_BENCHMARK("t/vector/GC", generic_mut<immer::vector_transient<unsigned,gc_
 NONIUS_BENCHMARK("t/vector/NO", generic_mut<immer::vector_transient<unsigned,basic_memory,5>>())
 NONIUS_BENCHMARK("t/vector/UN", generic_mut<immer::vector_transient<unsigned,unsafe_memory,5>>())
 
+NONIUS_BENCHMARK("r/vector/5B", generic_range<immer::vector<unsigned,def_memory,5>>())
+NONIUS_BENCHMARK("r/vector/NO", generic_range<immer::vector<unsigned,basic_memory,5>>())
+NONIUS_BENCHMARK("r/flex/5B",   generic_range<immer::flex_vector<unsigned,def_memory,5>>())
+
 NONIUS_BENCHMARK("flex/5B",    generic<immer::flex_vector<unsigned,def_memory,5>>())
 NONIUS_BENCHMARK("flex_s/GC",  generic<immer::flex_vector<std::size_t,gc_memory,5>>())
 
@@ -0,0 +1,30 @@
+#include <immer/heap/arena_heap.hpp>
+#include <immer/memory_policy.hpp>
+#include <immer/vector.hpp>
+
+#include <iostream>
+
+// include:squares/start
+// alias the vector type for the temporary values that only live
+// while computing the result
+template <typename T>
+using temp_vector = immer::vector<T, immer::arena_memory_policy>;
+
+immer::vector<int> squares(int n)
+{
+    // everything allocated by temp_vector is released at once when
+    // the arena goes out of scope
+    immer::arena a;
+    auto v = temp_vector<int>{};
+    for (auto i = 0; i < n; ++i)
+        v = v.push_back(i * i);
+    // copy the result out of the arena before it is released
+    return immer::vector<int>(v.begin(), v.end());
+}
+// include:squares/end
+
+int main()
+{
+    for (auto x : squares(10)) std::cout << x << " ";
+    std::cout << std::endl;
+}
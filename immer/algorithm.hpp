@@ -20,6 +20,13 @@
 
 #pragma once
 
+#include <immer/detail/rbts/operations.hpp>
+#include <immer/detail/thread_pool.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <numeric>
 
 namespace immer {
@@ -43,4 +50,160 @@ Fn&& for_each(VectorT&& v, Fn&& fn)
     return std::forward<Fn>(fn);
 }
 
+/*!
+ * Compares the containers `a` and `b`, calling `on_insert(i, y)` for
+ * every element `y` of `b` that is not in `a`, `on_erase(i, x)` for
+ * every element `x` of `a` that is not in `b` and `on_change(i, x, y)`
+ * for pairs of elements that compare different and take the same place
+ * in both.  The index `i` is the position of the element in `b` for
+ * insertions and changes, and its position in `a` for erasures.
+ * Subtrees that are shared between both containers are lined up and
+ * skipped even when they are at different indices, so when `b` was
+ * derived from `a`, for example by inserting or erasing elements in
+ * the middle of a flex_vector, the cost is proportional to the size of
+ * the modifications and only the modified elements are reported.
+ */
+template <typename VectorT,
+          typename InsertFn,
+          typename EraseFn,
+          typename ChangeFn>
+void diff(const VectorT& a, const VectorT& b,
+          InsertFn&& on_insert, EraseFn&& on_erase, ChangeFn&& on_change)
+{
+    a.impl().diff(b.impl(), on_insert, on_erase, on_change);
+}
+
+/*!
+ * Executor that runs tasks in a process wide pool with one thread per
+ * hardware core.  This is the executor used by the parallel algorithms
+ * when none is given.  An executor is any callable object that takes
+ * a nullary function object and arranges for it to be called,
+ * possibly in a different thread.
+ */
+struct default_executor
+{
+    template <typename Fn>
+    void operator() (Fn&& fn) const
+    { detail::thread_pool::instance().post(std::forward<Fn>(fn)); }
+};
+
+namespace detail {
+
+template <typename Executor>
+std::size_t parallel_concurrency(const Executor&)
+{ return std::max(std::thread::hardware_concurrency(), 1u); }
+
+inline std::size_t parallel_concurrency(const default_executor&)
+{ return thread_pool::instance().size(); }
+
+// Runs `fn(first, last)` over the chunks of every subtree of `v` in a
+// separate task, where `make_fn(i)` creates the function for the
+// `i`-th subtree in order.  Returns the number of subtrees.
+template <typename VectorT, typename Executor, typename MakeFn>
+std::size_t parallel_for_each_subtree(const VectorT& v,
+                                      Executor& exec,
+                                      MakeFn&& make_fn)
+{
+    // a few tasks per thread give some room for balancing the load
+    constexpr auto tasks_per_thread = 4u;
+    auto grain = v.size() / (parallel_concurrency(exec) * tasks_per_thread);
+    task_group group;
+    auto count = std::size_t{};
+    v.impl().for_each_subtree(grain, [&] (auto pos) {
+        group.run(exec, [pos, fn = make_fn(count++)] () mutable {
+            pos.visit(rbts::for_each_chunk_visitor{}, fn);
+        });
+    });
+    group.wait();
+    return count;
+}
+
+} // namespace detail
+
+/*!
+ * Apply operation `fn` for every *chunk* of data in the vector, like
+ * `v.for_each_chunk(fn)`, but processing independent subtrees in
+ * parallel tasks run by `exec`.  `fn` may be called concurrently from
+ * several threads and chunks are not visited in any particular order.
+ * Returns once all chunks have been processed, rethrowing the first
+ * exception thrown by `fn`, if any.
+ */
+template <typename VectorT, typename Fn, typename Executor>
+void parallel_for_each_chunk(const VectorT& v, Fn&& fn, Executor&& exec)
+{
+    detail::parallel_for_each_subtree(v, exec, [&] (std::size_t) {
+        return [&] (auto first, auto last) { fn(first, last); };
+    });
+}
+
+template <typename VectorT, typename Fn>
+void parallel_for_each_chunk(const VectorT& v, Fn&& fn)
+{ parallel_for_each_chunk(v, std::forward<Fn>(fn), default_executor{}); }
+
+/*!
+ * Returns the result of combining `init` and the result of applying
+ * `transform` to every element of `v` using `reduce`.  Parts of the
+ * vector are reduced in parallel in tasks run by `exec`, so `reduce`
+ * must be associative, but it does not need to be commutative:
+ * partial results are combined in order.
+ */
+template <typename VectorT, typename T, typename ReduceFn,
+          typename TransformFn, typename Executor>
+T parallel_transform_reduce(const VectorT& v, T init,
+                            ReduceFn&& reduce, TransformFn&& transform,
+                            Executor&& exec)
+{
+    auto partials = std::deque<std::unique_ptr<T>>{};
+    detail::parallel_for_each_subtree(v, exec, [&] (std::size_t) {
+        partials.emplace_back();
+        auto& result = partials.back();
+        return [&] (auto first, auto last) {
+            if (!result)
+                result = std::make_unique<T>(transform(*first++));
+            for (; first != last; ++first)
+                *result = reduce(std::move(*result), transform(*first));
+        };
+    });
+    for (auto& p : partials)
+        if (p)
+            init = reduce(std::move(init), std::move(*p));
+    return init;
+}
+
+template <typename VectorT, typename T, typename ReduceFn,
+          typename TransformFn>
+T parallel_transform_reduce(const VectorT& v, T init,
+                            ReduceFn&& reduce, TransformFn&& transform)
+{
+    return parallel_transform_reduce(v, std::move(init),
+                                     std::forward<ReduceFn>(reduce),
+                                     std::forward<TransformFn>(transform),
+                                     default_executor{});
+}
+
+/*!
+ * Parallel version of `immer::accumulate`, combining the elements of
+ * `v` with the associative operation `op` (`std::plus<>` by default)
+ * in tasks run by `exec`.
+ */
+template <typename VectorT, typename T, typename Fn, typename Executor>
+T parallel_accumulate(const VectorT& v, T init, Fn&& op, Executor&& exec)
+{
+    return parallel_transform_reduce(
+        v, std::move(init), std::forward<Fn>(op),
+        [] (const auto& x) -> const auto& { return x; },
+        std::forward<Executor>(exec));
+}
+
+template <typename VectorT, typename T, typename Fn>
+T parallel_accumulate(const VectorT& v, T init, Fn&& op)
+{
+    return parallel_accumulate(v, std::move(init), std::forward<Fn>(op),
+                               default_executor{});
+}
+
+template <typename VectorT, typename T>
+T parallel_accumulate(const VectorT& v, T init)
+{ return parallel_accumulate(v, std::move(init), std::plus<>{}); }
+
 } // namespace immer
@@ -0,0 +1,568 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <immer/detail/rbts/position.hpp>
+#include <immer/detail/rbts/rbtree.hpp>
+#include <immer/detail/util.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace immer {
+
+/*!
+ * Describes how to write and read values of type `T` that are not
+ * trivially copyable in an archive.  It has to be specialized with two
+ * static functions, `void save(std::ostream&, const T&)` and
+ * `T load(std::istream&)`.  Trivially copyable values are written as
+ * raw bytes and do not need it.
+ */
+template <typename T>
+struct archive_codec;
+
+/*!
+ * Thrown when reading an archive that is malformed or that was not
+ * written for the same type of container.
+ */
+struct archive_error : std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
+
+namespace detail {
+namespace rbts {
+
+// The archive starts with a header followed by a sequence of records,
+// all in native byte order.  Nodes get consecutive ids in the order
+// in which they are written, and they are written after their
+// children, so that they can be rebuilt in one pass.
+constexpr char archive_magic[8] = { 'i','m','m','e','r','a','r','c' };
+constexpr std::uint32_t archive_format = 1;
+
+enum class archive_record : std::uint8_t
+{
+    leaf,    // count, values
+    inner,   // count, child ids
+    relaxed, // count, child ids, sizes
+    version  // size, shift, root id, tail id
+};
+
+template <typename T, typename NodeT>
+struct archive_header
+{
+    char          magic[8];
+    std::uint32_t format;
+    std::uint32_t value_size;
+    std::uint8_t  bits;
+    std::uint8_t  bits_leaf;
+
+    static archive_header make()
+    {
+        auto h = archive_header{};
+        std::memcpy(h.magic, archive_magic, sizeof(archive_magic));
+        h.format     = archive_format;
+        h.value_size = sizeof(T);
+        h.bits       = NodeT::bits;
+        h.bits_leaf  = NodeT::bits_leaf;
+        return h;
+    }
+
+    bool matches(const archive_header& other) const
+    {
+        return std::memcmp(magic, other.magic, sizeof(magic)) == 0
+            && format == other.format
+            && value_size == other.value_size
+            && bits == other.bits
+            && bits_leaf == other.bits_leaf;
+    }
+};
+
+template <typename T>
+void archive_write(std::ostream& out, const T& x)
+{
+    out.write(reinterpret_cast<const char*>(&x), sizeof(T));
+}
+
+template <typename T>
+T archive_read(std::istream& in)
+{
+    auto x = T{};
+    if (!in.read(reinterpret_cast<char*>(&x), sizeof(T)))
+        throw archive_error{"unexpected end of archive"};
+    return x;
+}
+
+template <typename T>
+void archive_write_values(std::ostream& out, const T* first, count_t n,
+                          std::true_type)
+{
+    out.write(reinterpret_cast<const char*>(first), n * sizeof(T));
+}
+
+template <typename T>
+void archive_write_values(std::ostream& out, const T* first, count_t n,
+                          std::false_type)
+{
+    for (auto last = first + n; first != last; ++first)
+        archive_codec<T>::save(out, *first);
+}
+
+template <typename T>
+void archive_read_values(std::istream& in, T* first, count_t n,
+                         std::true_type)
+{
+    if (!in.read(reinterpret_cast<char*>(first), n * sizeof(T)))
+        throw archive_error{"unexpected end of archive"};
+}
+
+template <typename T>
+void archive_read_values(std::istream& in, T* first, count_t n,
+                         std::false_type)
+{
+    auto i = count_t{};
+    try {
+        for (; i < n; ++i)
+            new (first + i) T(archive_codec<T>::load(in));
+    } catch (...) {
+        destroy_n(first, i);
+        throw;
+    }
+}
+
+struct archive_save_visitor
+{
+    using this_t = archive_save_visitor;
+
+    template <typename Pos, typename Saver>
+    friend void visit_relaxed(this_t, Pos&& p, Saver& s)
+    { s.save_inner(p, std::true_type{}); }
+
+    template <typename Pos, typename Saver>
+    friend void visit_regular(this_t, Pos&& p, Saver& s)
+    { s.save_inner(p, std::false_type{}); }
+
+    template <typename Pos, typename Saver>
+    friend void visit_leaf(this_t, Pos&& p, Saver& s)
+    { s.save_leaf(p); }
+};
+
+template <typename Container>
+struct archive_saver
+{
+    using tree_t = std::decay_t<decltype(std::declval<Container>().impl())>;
+    using node_t = typename tree_t::node_t;
+    using value_t = typename node_t::value_t;
+    using trivial_t = std::is_trivially_copyable<value_t>;
+
+    // A node may be seen with different sizes, for example, when a
+    // leaf is shared by a vector and a slice of it, so they are
+    // identified by both.
+    using key_t = std::pair<const node_t*, size_t>;
+
+    struct key_hash
+    {
+        std::size_t operator() (const key_t& k) const
+        {
+            auto h = std::hash<const node_t*>{}(k.first);
+            return h ^ (std::hash<size_t>{}(k.second) + 0x9e3779b9
+                        + (h << 6) + (h >> 2));
+        }
+    };
+
+    std::ostream& out;
+    std::unordered_map<key_t, std::uint64_t, key_hash> ids;
+    std::vector<std::uint64_t> stack;
+    // Saved containers are kept alive, so that their nodes are not
+    // freed and their addresses reused for different nodes.
+    std::vector<Container> saved;
+
+    archive_saver(std::ostream& o)
+        : out{o}
+    {
+        archive_write(out, archive_header<value_t, node_t>::make());
+    }
+
+    bool known(key_t key)
+    {
+        auto it = ids.find(key);
+        if (it == ids.end())
+            return false;
+        stack.push_back(it->second);
+        return true;
+    }
+
+    void add(key_t key)
+    {
+        auto id = std::uint64_t(ids.size());
+        ids.emplace(key, id);
+        stack.push_back(id);
+    }
+
+    template <typename Pos, typename Relaxed>
+    void save_inner(Pos& p, Relaxed relaxed)
+    {
+        auto key = key_t{ p.node(), subtree_size(p, 0) };
+        if (known(key))
+            return;
+        auto first = stack.size();
+        p.each(archive_save_visitor{}, *this);
+        auto n = count_t(stack.size() - first);
+        assert(n == p.count());
+        archive_write(out, relaxed
+                      ? archive_record::relaxed
+                      : archive_record::inner);
+        archive_write(out, n);
+        out.write(reinterpret_cast<const char*>(stack.data() + first),
+                  n * sizeof(std::uint64_t));
+        write_sizes(p, n, relaxed);
+        stack.resize(first);
+        add(key);
+    }
+
+    template <typename Pos>
+    void write_sizes(Pos& p, count_t n, std::true_type)
+    {
+        auto sizes = p.relaxed()->sizes;
+        for (auto i = count_t{}; i < n; ++i)
+            archive_write(out, std::uint64_t(sizes[i]));
+    }
+
+    template <typename Pos>
+    void write_sizes(Pos&, count_t, std::false_type)
+    {}
+
+    template <typename Pos>
+    void save_leaf(Pos& p)
+    {
+        auto key = key_t{ p.node(), p.count() };
+        if (known(key))
+            return;
+        archive_write(out, archive_record::leaf);
+        archive_write(out, count_t(p.count()));
+        archive_write_values(out, p.node()->leaf(), p.count(), trivial_t{});
+        add(key);
+    }
+
+    void save(const Container& v)
+    {
+        auto& t = v.impl();
+        t.traverse(archive_save_visitor{}, *this);
+        assert(stack.size() == 2);
+        archive_write(out, archive_record::version);
+        archive_write(out, std::uint64_t(t.size));
+        archive_write(out, std::uint32_t(t.shift));
+        archive_write(out, stack[0]);
+        archive_write(out, stack[1]);
+        stack.clear();
+        saved.push_back(v);
+        if (!out)
+            throw archive_error{"could not write archive"};
+    }
+};
+
+template <typename Container>
+struct archive_loader
+{
+    using tree_t = std::decay_t<decltype(std::declval<Container>().impl())>;
+    using node_t = typename tree_t::node_t;
+    using value_t = typename node_t::value_t;
+    using trivial_t = std::is_trivially_copyable<value_t>;
+
+    static constexpr auto B  = node_t::bits;
+    static constexpr auto BL = node_t::bits_leaf;
+    static constexpr bool supports_relaxed =
+        !std::is_same<tree_t, rbtree<value_t, typename node_t::memory,
+                                     B, BL>>::value;
+
+    // Every node is owned once by the loader until it is destroyed.
+    // Children are always loaded before their parents, so releasing
+    // the nodes in reverse order never frees a node that is still
+    // referenced by the loader.
+    struct entry
+    {
+        node_t*      node;
+        archive_record kind;
+        count_t      count;
+        unsigned     height;
+    };
+
+    std::istream& in;
+    std::vector<entry> nodes;
+
+    archive_loader(std::istream& i)
+        : in{i}
+    {
+        auto h = archive_read<archive_header<value_t, node_t>>(in);
+        if (!archive_header<value_t, node_t>::make().matches(h))
+            throw archive_error{"archive does not match the container type"};
+    }
+
+    ~archive_loader()
+    {
+        for (auto it = nodes.rbegin(); it != nodes.rend(); ++it) {
+            auto p = it->node;
+            if (p->dec()) {
+                switch (it->kind) {
+                case archive_record::leaf:
+                    node_t::delete_leaf(p, it->count);
+                    break;
+                case archive_record::inner:
+                    release_children(p, it->count);
+                    node_t::delete_inner(p);
+                    break;
+                default:
+                    release_children(p, it->count);
+                    node_t::delete_inner_r(p);
+                    break;
+                }
+            }
+        }
+    }
+
+    static void release_children(node_t* p, count_t n)
+    {
+        for (auto c = p->inner(), e = c + n; c != e; ++c) {
+            auto last = (*c)->dec();
+            assert(!last);
+            (void) last;
+        }
+    }
+
+    const entry& child(std::uint64_t id)
+    {
+        if (id >= nodes.size())
+            throw archive_error{"invalid node id in archive"};
+        return nodes[id];
+    }
+
+    void load_leaf()
+    {
+        auto n = archive_read<count_t>(in);
+        if (n > branches<BL>)
+            throw archive_error{"invalid leaf size in archive"};
+        nodes.reserve(nodes.size() + 1);
+        auto p = node_t::make_leaf_n(n);
+        try {
+            archive_read_values(in, p->leaf(), n, trivial_t{});
+        } catch (...) {
+            node_t::heap::deallocate(p);
+            throw;
+        }
+        nodes.push_back({ p, archive_record::leaf, n, 0 });
+    }
+
+    void load_inner(archive_record kind)
+    {
+        if (kind == archive_record::relaxed && !supports_relaxed)
+            throw archive_error{"relaxed node in archive of vectors"};
+        auto n = archive_read<count_t>(in);
+        if (n > branches<B> || (n == 0 && kind == archive_record::relaxed))
+            throw archive_error{"invalid inner node size in archive"};
+        std::uint64_t ids[branches<B>];
+        std::uint64_t sizes[branches<B>];
+        auto height = 1u;
+        for (auto i = count_t{}; i < n; ++i) {
+            ids[i] = archive_read<std::uint64_t>(in);
+            auto& c = child(ids[i]);
+            auto h = c.height + 1;
+            if (i == 0)
+                height = h;
+            else if (h != height)
+                throw archive_error{"unbalanced node in archive"};
+        }
+        if (kind == archive_record::relaxed) {
+            for (auto i = count_t{}; i < n; ++i) {
+                sizes[i] = archive_read<std::uint64_t>(in);
+                if (i > 0 && sizes[i] < sizes[i - 1])
+                    throw archive_error{"invalid relaxed sizes in archive"};
+            }
+        }
+        nodes.reserve(nodes.size() + 1);
+        auto p = kind == archive_record::relaxed
+            ? node_t::make_inner_r_n(n)
+            : node_t::make_inner_n(n);
+        if (kind == archive_record::relaxed) {
+            auto r = p->relaxed();
+            r->count = n;
+            std::copy(sizes, sizes + n, r->sizes);
+        }
+        for (auto i = count_t{}; i < n; ++i)
+            p->inner() [i] = nodes[ids[i]].node->inc();
+        nodes.push_back({ p, kind, n, height });
+    }
+
+    static std::uint64_t tail_offset(const entry& root, std::uint64_t size)
+    {
+        return
+            root.kind == archive_record::relaxed
+                            ? root.node->relaxed()->sizes[root.count - 1] :
+            size            ? (size - 1) & ~mask<BL>
+            /* otherwise */ : 0;
+    }
+
+    tree_t load_version()
+    {
+        auto size  = archive_read<std::uint64_t>(in);
+        auto shift = archive_read<std::uint32_t>(in);
+        auto& root = child(archive_read<std::uint64_t>(in));
+        auto& tail = child(archive_read<std::uint64_t>(in));
+        if (shift < BL || (shift - BL) % B != 0 ||
+            root.kind == archive_record::leaf ||
+            (root.count && root.height != (shift - BL) / B + 1) ||
+            tail.kind != archive_record::leaf ||
+            tail.count != size - tail_offset(root, size))
+            throw archive_error{"invalid version in archive"};
+        return { size_t(size), shift_t(shift),
+                 root.node->inc(), tail.node->inc() };
+    }
+
+    bool load(Container& v)
+    {
+        while (true) {
+            auto tag = std::uint8_t{};
+            if (!in.read(reinterpret_cast<char*>(&tag), 1))
+                return false;
+            switch (archive_record(tag)) {
+            case archive_record::leaf:
+                load_leaf();
+                break;
+            case archive_record::inner:
+            case archive_record::relaxed:
+                load_inner(archive_record(tag));
+                break;
+            case archive_record::version:
+                v = Container(load_version());
+                return true;
+            default:
+                throw archive_error{"invalid record in archive"};
+            }
+        }
+    }
+};
+
+} // namespace rbts
+} // namespace detail
+
+/*!
+ * Writes versions of a `vector` or a `flex_vector` to a binary
+ * stream, preserving the structural sharing between them: every node
+ * is written only once, no matter in how many of the saved versions
+ * it appears.  This is most useful to store the history of a value,
+ * where each version shares most of its nodes with the previous one.
+ *
+ * The writer keeps a reference to all the saved containers, so that
+ * the identity of their nodes remains valid while it is alive.
+ * Values are written as raw bytes when they are trivially copyable,
+ * and with @ref archive_codec otherwise.  The archive uses the native
+ * byte order and data layout, so it should be read in the same kind
+ * of platform where it was written.
+ *
+ * @rst
+ *
+ * .. code-block:: c++
+ *
+ *    auto out = std::ofstream{"history.bin", std::ios::binary};
+ *    auto writer = immer::archive_writer<immer::flex_vector<int>>{out};
+ *    for (auto& v : history)
+ *        writer.save(v);
+ *
+ * @endrst
+ */
+template <typename Container>
+class archive_writer
+{
+public:
+    using container_type = Container;
+
+    /*!
+     * Starts a new archive in `out`, by writing its header.
+     */
+    archive_writer(std::ostream& out) : impl_{out} {}
+
+    /*!
+     * Appends `v` to the archive, writing only the nodes that were
+     * not written before.
+     */
+    void save(const Container& v) { impl_.save(v); }
+
+    /*!
+     * Returns the number of versions saved so far.
+     */
+    std::size_t size() const { return impl_.saved.size(); }
+
+private:
+    detail::rbts::archive_saver<Container> impl_;
+};
+
+/*!
+ * Reads the versions written by an @ref archive_writer, in the same
+ * order.  The loaded containers share their nodes exactly like the
+ * saved ones did.  Throws @ref archive_error when the archive was not
+ * written for the same type of container or it is malformed.  The
+ * structure of the nodes is checked while reading, but not the
+ * consistency of their sizes, so archives should come from a trusted
+ * source.
+ *
+ * @rst
+ *
+ * .. code-block:: c++
+ *
+ *    auto in = std::ifstream{"history.bin", std::ios::binary};
+ *    auto reader = immer::archive_reader<immer::flex_vector<int>>{in};
+ *    auto v = immer::flex_vector<int>{};
+ *    while (reader.load(v))
+ *        history.push_back(v);
+ *
+ * @endrst
+ */
+template <typename Container>
+class archive_reader
+{
+public:
+    using container_type = Container;
+
+    /*!
+     * Starts reading the archive in `in`, by checking its header.
+     */
+    archive_reader(std::istream& in) : impl_{in} {}
+
+    /*!
+     * Reads the next version into `v`.  Returns `false`, leaving `v`
+     * untouched, when there are no more versions.
+     */
+    bool load(Container& v) { return impl_.load(v); }
+
+private:
+    detail::rbts::archive_loader<Container> impl_;
+};
+
+} // namespace immer
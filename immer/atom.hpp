@@ -0,0 +1,139 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <immer/detail/atom_impl.hpp>
+#include <immer/memory_policy.hpp>
+
+namespace immer {
+
+/*!
+ * Stores a value of an immutable type `T` that can be read and
+ * replaced from multiple threads at the same time.  This is the
+ * building block to publish successive versions of a container from
+ * one or more writer threads to many readers.
+ *
+ * @tparam T The type of the value to be stored.  It should be cheap
+ *           to copy, like any of the immutable containers in this
+ *           library.
+ * @tparam MemoryPolicy Memory management policy. See @ref
+ *           memory_policy.
+ *
+ * @rst
+ *
+ * Each stored value lives in a reference counted box allocated with
+ * the heap of the ``MemoryPolicy``.  Loading a value only needs to
+ * take a reference to the current box, and the tree nodes of the
+ * container inside are shared with it, so readers never observe a
+ * half written value and never wait for a writer to build a new one.
+ *
+ * When the memory policy uses :cpp:class:`immer::refcount_policy`,
+ * the reference is taken with *split reference counts*: readers
+ * first count themselves in the low bits of the pointer to the box,
+ * and a writer replacing the box moves that count to the box before
+ * releasing it.  With :cpp:class:`immer::no_refcount_policy` boxes
+ * are reclaimed by the garbage collector.  In both cases no operation
+ * takes a lock.
+ *
+ * .. code-block:: c++
+ *
+ *    auto current = immer::atom<immer::vector<int>>{};
+ *
+ *    // writer thread
+ *    current.update([] (auto v) { return v.push_back(42); });
+ *
+ *    // reader threads
+ *    auto v = current.load();
+ *
+ * @endrst
+ */
+template <typename T,
+          typename MemoryPolicy = default_memory_policy>
+class atom
+{
+    using impl_t = detail::atom_impl_t<T, MemoryPolicy>;
+
+public:
+    using value_type = T;
+    using memory_policy = MemoryPolicy;
+
+    /*!
+     * Constructs an atom holding a default constructed `T`.
+     */
+    atom() : impl_{T{}} {}
+
+    /*!
+     * Constructs an atom holding `value`.
+     */
+    atom(T value) : impl_{std::move(value)} {}
+
+    atom(const atom&) = delete;
+    atom(atom&&) = delete;
+    atom& operator=(const atom&) = delete;
+    atom& operator=(atom&&) = delete;
+
+    /*!
+     * Returns a copy of the current value.
+     */
+    T load() const { return impl_.load(); }
+
+    /*!
+     * Same as `load()`.
+     */
+    operator T() const { return impl_.load(); }
+
+    /*!
+     * Replaces the current value with `value`.  The previous value is
+     * released outside of any critical section.
+     */
+    void store(T value) { impl_.store(std::move(value)); }
+
+    /*!
+     * Same as `store(value)`.
+     */
+    atom& operator=(T value)
+    {
+        impl_.store(std::move(value));
+        return *this;
+    }
+
+    /*!
+     * Replaces the current value with `value` and returns the value
+     * it had before, atomically.
+     */
+    T exchange(T value) { return impl_.exchange(std::move(value)); }
+
+    /*!
+     * Replaces the current value `x` with `fn(x)` and returns the new
+     * value.  The new value is computed without holding any lock and
+     * then published only if no other thread changed the atom in the
+     * meantime; otherwise, `fn` is called again with the newer value.
+     * This means that `fn` may be invoked more than once and should
+     * not have side effects.
+     */
+    template <typename Fn>
+    T update(Fn&& fn) { return impl_.update(std::forward<Fn>(fn)); }
+
+private:
+    impl_t impl_;
+};
+
+} // namespace immer
@@ -55,9 +55,20 @@
 
 #define IMMER_DESCENT_DEEP 0
 
+/*!
+ * When defined to `1`, the heaps keep the counters that can be
+ * inspected with `immer::heap_stats_snapshot()`.
+ */
+#ifndef IMMER_HEAP_STATS
+#define IMMER_HEAP_STATS 0
+#endif
+
+#include <cstddef>
+
 namespace immer {
 
 const auto default_bits = 5;
 const auto default_free_list_size = 1 << 10;
+const auto default_free_list_budget = std::size_t{1} << 26;
 
 } // namespace immer
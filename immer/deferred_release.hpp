@@ -0,0 +1,253 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <immer/flex_vector.hpp>
+#include <immer/vector.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace immer {
+namespace detail {
+
+/*!
+ * A subtree whose reference is pending to be released.  The `step`
+ * function drops the reference and, if the node dies, queues its
+ * children instead of releasing them recursively.
+ */
+struct release_entry
+{
+    using step_t = void (*)(const release_entry&, std::vector<release_entry>&);
+
+    step_t        step;
+    void*         node;
+    rbts::shift_t shift;
+    rbts::size_t  size;
+};
+
+template <typename Dummy=void>
+struct release_queue
+{
+    static std::mutex mutex;
+    static std::vector<release_entry> pending;
+    // Number of entries taken out of `pending` by the calls to
+    // `release_pending` that are still running.
+    static std::size_t taken;
+};
+
+template <typename D>
+std::mutex release_queue<D>::mutex;
+template <typename D>
+std::vector<release_entry> release_queue<D>::pending;
+template <typename D>
+std::size_t release_queue<D>::taken = 0;
+
+namespace rbts {
+
+template <typename NodeT>
+void release_step_inner(const release_entry& x, std::vector<release_entry>& out);
+
+template <typename NodeT>
+void release_step_leaf(const release_entry& x, std::vector<release_entry>& out);
+
+struct defer_visitor
+{
+    using this_t = defer_visitor;
+
+    template <typename Pos>
+    friend void visit_inner(this_t, Pos&& p, std::vector<release_entry>& out)
+    {
+        using node_t = node_type<Pos>;
+        out.push_back({ &release_step_inner<node_t>,
+                        p.node(), p.shift(), subtree_size(p, 0) });
+    }
+
+    template <typename Pos>
+    friend void visit_leaf(this_t, Pos&& p, std::vector<release_entry>& out)
+    {
+        using node_t = node_type<Pos>;
+        out.push_back({ &release_step_leaf<node_t>,
+                        p.node(), 0, p.count() });
+    }
+};
+
+struct release_visitor
+{
+    using this_t = release_visitor;
+
+    template <typename Pos>
+    friend void visit_relaxed(this_t, Pos&& p, std::vector<release_entry>& out)
+    {
+        using node_t = node_type<Pos>;
+        auto node = p.node();
+        if (node->dec()) {
+            p.each(defer_visitor{}, out);
+            node_t::delete_inner_r(node);
+        }
+    }
+
+    template <typename Pos>
+    friend void visit_regular(this_t, Pos&& p, std::vector<release_entry>& out)
+    {
+        using node_t = node_type<Pos>;
+        auto node = p.node();
+        if (node->dec()) {
+            p.each(defer_visitor{}, out);
+            node_t::delete_inner(node);
+        }
+    }
+
+    template <typename Pos>
+    friend void visit_leaf(this_t, Pos&& p, std::vector<release_entry>&)
+    {
+        using node_t = node_type<Pos>;
+        auto node = p.node();
+        if (node->dec())
+            node_t::delete_leaf(node, p.count());
+    }
+};
+
+template <typename NodeT>
+void release_step_inner(const release_entry& x, std::vector<release_entry>& out)
+{
+    // make room for the children before dropping the reference, so
+    // running out of memory does not leak them
+    out.reserve(out.size() + branches<NodeT::bits>);
+    auto node = static_cast<NodeT*>(x.node);
+    if (x.size)
+        visit_maybe_relaxed_sub(node, x.shift, x.size, release_visitor{}, out);
+    else
+        make_empty_regular_pos(node).visit(release_visitor{}, out);
+}
+
+template <typename NodeT>
+void release_step_leaf(const release_entry& x, std::vector<release_entry>& out)
+{
+    auto node = static_cast<NodeT*>(x.node);
+    if (x.size)
+        make_leaf_sub_pos(node, x.size).visit(release_visitor{}, out);
+    else
+        make_empty_leaf_pos(node).visit(release_visitor{}, out);
+}
+
+template <typename Tree>
+void deferred_release_tree(const Tree& t)
+{
+    using node_t  = typename Tree::node_t;
+    auto& q       = release_queue<>::pending;
+    auto tail_off = t.tail_offset();
+    std::lock_guard<std::mutex> lock{release_queue<>::mutex};
+    q.reserve(q.size() + 2);
+    t.inc();
+    q.push_back({ &release_step_inner<node_t>, t.root, t.shift, tail_off });
+    q.push_back({ &release_step_leaf<node_t>, t.tail, 0, t.size - tail_off });
+}
+
+} // namespace rbts
+} // namespace detail
+
+/*!
+ * Releases the contents of the vector `v` later, during a call to
+ * @ref release_pending, and leaves `v` empty.  This takes constant
+ * time, no matter how big the vector is, so it can be used to drop
+ * big vectors in latency sensitive code.  Only the nodes that are
+ * not shared with other vectors are actually freed when the pending
+ * work is done.
+ */
+template <typename T, typename MP, detail::rbts::bits_t B, detail::rbts::bits_t BL>
+void deferred_release(vector<T, MP, B, BL>&& v)
+{
+    detail::rbts::deferred_release_tree(v.impl());
+    v = {};
+}
+
+/*!
+ * Like @ref deferred_release for `vector`, but for a `flex_vector`.
+ */
+template <typename T, typename MP, detail::rbts::bits_t B, detail::rbts::bits_t BL>
+void deferred_release(flex_vector<T, MP, B, BL>&& v)
+{
+    detail::rbts::deferred_release_tree(v.impl());
+    v = {};
+}
+
+/*!
+ * Does part of the work left by @ref deferred_release, releasing at
+ * most `max_nodes` nodes.  It returns the number of subtrees that
+ * are still pending, counting those that concurrent calls are
+ * working on, so it only returns zero when all the work is done.  It
+ * can be called every now and then from the thread that owns the
+ * containers, so that every call takes a bounded time, or
+ * repeatedly from a background thread, or both.  The latter
+ * requires a thread-safe reference counting policy and heap.
+ *
+ * @rst
+ *
+ * .. code-block:: c++
+ *
+ *    std::atomic<bool> done{false};
+ *    auto reaper = std::thread{[&] {
+ *        while (!done)
+ *            if (!immer::release_pending())
+ *                std::this_thread::sleep_for(std::chrono::milliseconds{1});
+ *    }};
+ *
+ * @endrst
+ */
+inline std::size_t release_pending(std::size_t max_nodes = 1024)
+{
+    using detail::release_queue;
+    auto& q    = release_queue<>::pending;
+    auto work  = std::vector<detail::release_entry>{};
+    auto taken = std::size_t{};
+    {
+        // only take what this call may get through, so the rest is
+        // left for concurrent calls
+        std::lock_guard<std::mutex> lock{release_queue<>::mutex};
+        taken = std::min(max_nodes, q.size());
+        work.assign(q.end() - taken, q.end());
+        q.erase(q.end() - taken, q.end());
+        release_queue<>::taken += taken;
+    }
+    for (auto n = std::size_t{}; n < max_nodes && !work.empty(); ++n) {
+        auto x = work.back();
+        work.pop_back();
+        try {
+            x.step(x, work);
+        } catch (...) {
+            work.push_back(x);
+            std::lock_guard<std::mutex> lock{release_queue<>::mutex};
+            q.insert(q.end(), work.begin(), work.end());
+            release_queue<>::taken -= taken;
+            throw;
+        }
+    }
+    std::lock_guard<std::mutex> lock{release_queue<>::mutex};
+    q.insert(q.end(), work.begin(), work.end());
+    release_queue<>::taken -= taken;
+    return q.size() + release_queue<>::taken;
+}
+
+} // namespace immer
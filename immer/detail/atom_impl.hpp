@@ -0,0 +1,277 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <immer/detail/util.hpp>
+#include <immer/refcount/no_refcount_policy.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace immer {
+namespace detail {
+
+// The value published by an atom.  It is immutable once it has been
+// made visible to other threads, so it may be read without holding
+// any lock as long as a reference to it is owned.
+template <typename T, typename MemoryPolicy>
+struct atom_box : MemoryPolicy::refcount
+{
+    T value;
+    void* memory;
+
+    atom_box(T v) : value{std::move(v)} {}
+};
+
+// Boxes are placed at addresses multiple of `Align`, so that the low
+// bits of the pointers to them are free to store something else.
+template <typename T, typename MemoryPolicy, std::size_t Align = 1>
+struct atom_box_traits
+{
+    using box_t = atom_box<T, MemoryPolicy>;
+
+    static constexpr std::size_t padding =
+        Align > alignof(box_t) ? Align - 1 : 0;
+
+    using heap  = typename MemoryPolicy::heap::template apply<
+        sizeof(box_t) + padding>::type;
+
+    static box_t* make(T v)
+    {
+        auto m = check_alloc(heap::allocate(sizeof(box_t) + padding));
+        auto p = reinterpret_cast<void*>(
+            (reinterpret_cast<std::uintptr_t>(m) + padding)
+            & ~std::uintptr_t{padding});
+        try {
+            auto b = new (p) box_t{std::move(v)};
+            b->memory = m;
+            return b;
+        } catch (...) {
+            heap::deallocate(m);
+            throw;
+        }
+    }
+
+    static void destroy(box_t* b)
+    {
+        auto m = b->memory;
+        b->~box_t();
+        heap::deallocate(m);
+    }
+};
+
+// Atom implementation for reference counted memory policies, using
+// split reference counts.  The low bits of the pointer to the current
+// box count the readers that are about to take a reference to it.  A
+// writer that replaces the box moves that count to the reference
+// count of the box, so no reader ever touches a box that may have
+// been freed, and no operation takes a lock.  Readers only wait for
+// each other when `max_readers` of them are between the two atomic
+// operations of `acquire()` at the same time.
+template <typename T, typename MemoryPolicy>
+struct refcount_atom_impl
+{
+    static constexpr std::uintptr_t max_readers = 63;
+
+    using traits = atom_box_traits<T, MemoryPolicy, max_readers + 1>;
+    using box_t  = typename traits::box_t;
+
+    struct handle
+    {
+        box_t* ptr;
+
+        handle(box_t* p) : ptr{p} {}
+        handle(handle&& other) : ptr{other.ptr} { other.ptr = nullptr; }
+        handle(const handle&) = delete;
+        ~handle() { if (ptr) release(ptr); }
+
+        box_t* operator-> () const { return ptr; }
+        box_t* get() const { return ptr; }
+        box_t* reset() { auto p = ptr; ptr = nullptr; return p; }
+    };
+
+    mutable std::atomic<std::uintptr_t> box_;
+
+    refcount_atom_impl(T v)
+        : box_{reinterpret_cast<std::uintptr_t>(traits::make(std::move(v)))}
+    {}
+
+    ~refcount_atom_impl()
+    {
+        release(box(box_.load(std::memory_order_acquire)));
+    }
+
+    static box_t* box(std::uintptr_t w)
+    { return reinterpret_cast<box_t*>(w & ~max_readers); }
+
+    static std::uintptr_t readers(std::uintptr_t w)
+    { return w & max_readers; }
+
+    static void release(box_t* b)
+    {
+        if (b->dec())
+            traits::destroy(b);
+    }
+
+    // Gives the references of the readers that were counted in `w`,
+    // which is no longer published, to its box.
+    static box_t* retire(std::uintptr_t w)
+    {
+        auto b = box(w);
+        for (auto n = readers(w); n; --n)
+            b->inc();
+        return b;
+    }
+
+    handle acquire() const
+    {
+        auto w = box_.load(std::memory_order_relaxed);
+        do {
+            while (readers(w) == max_readers) {
+                std::this_thread::yield();
+                w = box_.load(std::memory_order_relaxed);
+            }
+        } while (!box_.compare_exchange_weak(w, w + 1,
+                                             std::memory_order_acquire,
+                                             std::memory_order_relaxed));
+        auto b = box(w);
+        b->inc();
+        w = w + 1;
+        while (!box_.compare_exchange_weak(w, w - 1,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+            // Boxes are never published twice, so when the pointer
+            // changed, the writer already gave our count to the box.
+            if (box(w) != b) {
+                b->dec_unsafe();
+                break;
+            }
+        }
+        return { b };
+    }
+
+    box_t* swap(box_t* b)
+    {
+        return retire(box_.exchange(reinterpret_cast<std::uintptr_t>(b),
+                                    std::memory_order_acq_rel));
+    }
+
+    T load() const
+    {
+        return acquire()->value;
+    }
+
+    void store(T v)
+    {
+        release(swap(traits::make(std::move(v))));
+    }
+
+    T exchange(T v)
+    {
+        auto old = handle{swap(traits::make(std::move(v)))};
+        return old->value;
+    }
+
+    template <typename Fn>
+    T update(Fn&& fn)
+    {
+        while (true) {
+            auto old  = acquire();
+            auto next = handle{traits::make(fn(old->value))};
+            auto result = next->value;
+            auto w = box_.load(std::memory_order_relaxed);
+            // Holding a reference to `old` guarantees that it was not
+            // freed and reused in the meantime, so comparing the
+            // pointer is enough to detect writes.
+            while (box(w) == old.get()) {
+                if (box_.compare_exchange_weak(
+                        w, reinterpret_cast<std::uintptr_t>(next.get()),
+                        std::memory_order_acq_rel,
+                        std::memory_order_relaxed)) {
+                    next.reset();
+                    release(retire(w));
+                    return result;
+                }
+            }
+        }
+    }
+};
+
+// Atom implementation for memory policies without reference
+// counting.  Boxes are never freed while reachable, so the pointer to
+// the current one can be manipulated with plain atomics and every
+// operation is lock-free.
+template <typename T, typename MemoryPolicy>
+struct gc_atom_impl
+{
+    using traits = atom_box_traits<T, MemoryPolicy>;
+    using box_t  = typename traits::box_t;
+
+    std::atomic<box_t*> box_;
+
+    gc_atom_impl(T v)
+        : box_{traits::make(std::move(v))}
+    {}
+
+    T load() const
+    {
+        return box_.load(std::memory_order_acquire)->value;
+    }
+
+    void store(T v)
+    {
+        box_.store(traits::make(std::move(v)), std::memory_order_release);
+    }
+
+    T exchange(T v)
+    {
+        return box_.exchange(traits::make(std::move(v)),
+                             std::memory_order_acq_rel)->value;
+    }
+
+    template <typename Fn>
+    T update(Fn&& fn)
+    {
+        auto old = box_.load(std::memory_order_acquire);
+        while (true) {
+            auto next = traits::make(fn(old->value));
+            if (box_.compare_exchange_weak(old, next,
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_acquire))
+                return next->value;
+            // `next` was never published, give it back right away.
+            traits::destroy(next);
+        }
+    }
+};
+
+template <typename T, typename MemoryPolicy>
+using atom_impl_t = std::conditional_t<
+    std::is_same<typename MemoryPolicy::refcount,
+                 no_refcount_policy>::value,
+    gc_atom_impl<T, MemoryPolicy>,
+    refcount_atom_impl<T, MemoryPolicy>>;
+
+} // namespace detail
+} // namespace immer
@@ -0,0 +1,366 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <immer/config.hpp>
+#include <immer/detail/hamts/node.hpp>
+
+#include <utility>
+
+namespace immer {
+namespace detail {
+namespace hamts {
+
+template <typename T,
+          typename Hash,
+          typename Equal,
+          typename MemoryPolicy,
+          bits_t B>
+struct champ_iterator;
+
+// Compressed hash-array mapped prefix-tree, as described in
+// "Optimizing Hash-Array Mapped Tries for Fast and Lean Immutable JVM
+// Collections" (Steindorfer and Vinju, 2015).  `Hash` and `Equal` are
+// called with stored values and with the keys passed to `get` and
+// `sub`, so the containers can look values up by a projection of
+// them.  The tree is kept in canonical form: no inner node but the
+// root holds a single value and no subtree.
+template <typename T,
+          typename Hash,
+          typename Equal,
+          typename MemoryPolicy,
+          bits_t B>
+struct champ
+{
+    static constexpr auto bits = B;
+
+    using node_t = node<T, MemoryPolicy, B>;
+
+    node_t* root;
+    size_t  size;
+
+    static const champ empty;
+
+    champ(node_t* r, size_t sz)
+        : root{r}, size{sz}
+    {}
+
+    champ(const champ& other)
+        : champ{other.root, other.size}
+    {
+        inc();
+    }
+
+    champ(champ&& other)
+        : champ{empty}
+    {
+        swap(*this, other);
+    }
+
+    champ& operator=(const champ& other)
+    {
+        auto next = other;
+        swap(*this, next);
+        return *this;
+    }
+
+    champ& operator=(champ&& other)
+    {
+        swap(*this, other);
+        return *this;
+    }
+
+    friend void swap(champ& x, champ& y)
+    {
+        using std::swap;
+        swap(x.root, y.root);
+        swap(x.size, y.size);
+    }
+
+    ~champ()
+    {
+        dec();
+    }
+
+    void inc() const
+    {
+        root->inc();
+    }
+
+    void dec() const
+    {
+        dec_node(root, 0);
+    }
+
+    static void dec_node(node_t* node, shift_t shift)
+    {
+        if (shift == max_shift<B>) {
+            while (node && node->dec()) {
+                auto next = node->collision_next();
+                node_t::delete_collision(node);
+                node = next;
+            }
+        } else if (node->dec()) {
+            auto fst = node->children();
+            auto lst = fst + node->children_count();
+            for (; fst != lst; ++fst)
+                dec_node(*fst, shift + B);
+            node_t::delete_inner(node);
+        }
+    }
+
+    template <typename Fn>
+    void for_each_chunk(Fn&& fn) const
+    {
+        for_each_chunk_traversal(root, 0, fn);
+    }
+
+    template <typename Fn>
+    static void for_each_chunk_traversal(node_t* node, shift_t shift, Fn&& fn)
+    {
+        if (shift == max_shift<B>) {
+            for (; node; node = node->collision_next())
+                fn(node->collision(), node->collision() + 1);
+        } else {
+            if (auto n = node->data_count())
+                fn(node->values(), node->values() + n);
+            auto fst = node->children();
+            auto lst = fst + node->children_count();
+            for (; fst != lst; ++fst)
+                for_each_chunk_traversal(*fst, shift + B, fn);
+        }
+    }
+
+    template <typename K>
+    const T* get(const K& k) const
+    {
+        auto node = root;
+        auto hash = Hash{}(k);
+        for (auto shift = shift_t{}; shift < max_shift<B>; shift += B) {
+            auto bit = bitmap_t{1} << ((hash >> shift) & mask<B>);
+            if (node->nodemap() & bit) {
+                auto offset = popcount(node->nodemap() & (bit - 1));
+                node = node->children() [offset];
+            } else if (node->datamap() & bit) {
+                auto offset = popcount(node->datamap() & (bit - 1));
+                auto value  = node->values() + offset;
+                return Equal{}(*value, k) ? value : nullptr;
+            } else {
+                return nullptr;
+            }
+        }
+        for (; node; node = node->collision_next())
+            if (Equal{}(*node->collision(), k))
+                return node->collision();
+        return nullptr;
+    }
+
+    // Copies the collision nodes in `[head, target)` in front of
+    // `rest`, whose reference is taken over.
+    static node_t* copy_collision_prefix(node_t* head, node_t* target,
+                                         node_t* rest)
+    {
+        try {
+            for (; head != target; head = head->collision_next())
+                rest = node_t::make_collision(*head->collision(), rest);
+        } catch (...) {
+            dec_node(rest, max_shift<B>);
+            throw;
+        }
+        return rest;
+    }
+
+    template <typename U>
+    static std::pair<node_t*, bool>
+    do_add(node_t* node, U&& v, hash_t hash, shift_t shift)
+    {
+        if (shift == max_shift<B>) {
+            for (auto p = node; p; p = p->collision_next()) {
+                if (Equal{}(*p->collision(), v)) {
+                    auto next = p->collision_next();
+                    auto rest = node_t::make_collision(std::forward<U>(v), next);
+                    if (next) next->inc();
+                    return { copy_collision_prefix(node, p, rest), false };
+                }
+            }
+            auto result = node_t::make_collision(std::forward<U>(v), node);
+            node->inc();
+            return { result, true };
+        } else {
+            auto bit = bitmap_t{1} << ((hash >> shift) & mask<B>);
+            if (node->nodemap() & bit) {
+                auto offset = popcount(node->nodemap() & (bit - 1));
+                auto result = do_add(node->children() [offset],
+                                     std::forward<U>(v), hash, shift + B);
+                try {
+                    result.first = node_t::copy_inner_replace(
+                        node, offset, result.first);
+                } catch (...) {
+                    dec_node(result.first, shift + B);
+                    throw;
+                }
+                return result;
+            } else if (node->datamap() & bit) {
+                auto offset = popcount(node->datamap() & (bit - 1));
+                auto& value = node->values() [offset];
+                if (Equal{}(value, v)) {
+                    return { node_t::copy_inner_replace_value(
+                                 node, offset, std::forward<U>(v)),
+                             false };
+                } else {
+                    auto child = node_t::make_merged(shift + B,
+                                                     value, Hash{}(value),
+                                                     std::forward<U>(v), hash);
+                    try {
+                        return { node_t::copy_inner_replace_merged(
+                                     node, bit, offset, child),
+                                 true };
+                    } catch (...) {
+                        dec_node(child, shift + B);
+                        throw;
+                    }
+                }
+            } else {
+                return { node_t::copy_inner_insert_value(
+                             node, bit, std::forward<U>(v)),
+                         true };
+            }
+        }
+    }
+
+    champ add(T v) const
+    {
+        auto hash = Hash{}(v);
+        auto res  = do_add(root, std::move(v), hash, 0);
+        return { res.first, res.second ? size + 1 : size };
+    }
+
+    // Result of removing a value from a subtree: either the value was
+    // not there, or the subtree now holds only one value that should
+    // be inlined in the parent, or a new subtree.
+    struct sub_result
+    {
+        enum kind_t
+        {
+            nothing,
+            singleton,
+            tree
+        };
+
+        union data_t
+        {
+            const T* singleton;
+            node_t*  tree;
+        };
+
+        kind_t kind;
+        data_t data;
+
+        sub_result()             : kind{nothing} {}
+        sub_result(const T* x)   : kind{singleton} { data.singleton = x; }
+        sub_result(node_t* x)    : kind{tree} { data.tree = x; }
+    };
+
+    template <typename K>
+    static sub_result do_sub(node_t* node, const K& k,
+                             hash_t hash, shift_t shift)
+    {
+        if (shift == max_shift<B>) {
+            for (auto p = node; p; p = p->collision_next()) {
+                if (Equal{}(*p->collision(), k)) {
+                    auto next = p->collision_next();
+                    auto size = count_t{};
+                    for (auto q = node; q; q = q->collision_next())
+                        ++size;
+                    assert(size >= 2);
+                    if (size == 2)
+                        return p == node ? next->collision() : node->collision();
+                    if (next) next->inc();
+                    return copy_collision_prefix(node, p, next);
+                }
+            }
+            return {};
+        } else {
+            auto bit = bitmap_t{1} << ((hash >> shift) & mask<B>);
+            if (node->nodemap() & bit) {
+                auto offset = popcount(node->nodemap() & (bit - 1));
+                auto result = do_sub(node->children() [offset],
+                                     k, hash, shift + B);
+                switch (result.kind) {
+                case sub_result::nothing:
+                    return {};
+                case sub_result::singleton:
+                    return node->datamap() == 0 &&
+                        node->children_count() == 1 &&
+                        shift > 0
+                        ? result
+                        : node_t::copy_inner_replace_inline(
+                            node, bit, offset, *result.data.singleton);
+                case sub_result::tree:
+                    try {
+                        return node_t::copy_inner_replace(
+                            node, offset, result.data.tree);
+                    } catch (...) {
+                        dec_node(result.data.tree, shift + B);
+                        throw;
+                    }
+                }
+            } else if (node->datamap() & bit) {
+                auto offset = popcount(node->datamap() & (bit - 1));
+                if (Equal{}(node->values() [offset], k)) {
+                    if (node->children_count() == 0 &&
+                        node->data_count() == 2 &&
+                        shift > 0)
+                        return node->values() + (1 - offset);
+                    else
+                        return node_t::copy_inner_remove_value(
+                            node, bit, offset);
+                }
+            }
+            return {};
+        }
+    }
+
+    template <typename K>
+    champ sub(const K& k) const
+    {
+        auto hash = Hash{}(k);
+        auto res  = do_sub(root, k, hash, 0);
+        switch (res.kind) {
+        case sub_result::nothing:
+            return *this;
+        case sub_result::tree:
+            return { res.data.tree, size - 1 };
+        default:
+            IMMER_UNREACHABLE;
+        }
+    }
+};
+
+template <typename T, typename H, typename E, typename MP, bits_t B>
+const champ<T, H, E, MP, B> champ<T, H, E, MP, B>::empty = {
+    node_t::make_empty_inner(),
+    0,
+};
+
+} // namespace hamts
+} // namespace detail
+} // namespace immer
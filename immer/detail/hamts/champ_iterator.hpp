@@ -0,0 +1,152 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <immer/detail/hamts/champ.hpp>
+
+#include <boost/iterator/iterator_facade.hpp>
+
+namespace immer {
+namespace detail {
+namespace hamts {
+
+template <typename T, typename Hash, typename Eq, typename MP, bits_t B>
+struct champ_iterator : boost::iterator_facade<
+    champ_iterator<T, Hash, Eq, MP, B>,
+    T,
+    boost::forward_traversal_tag,
+    const T&>
+{
+    using tree_t = champ<T, Hash, Eq, MP, B>;
+    using node_t = typename tree_t::node_t;
+
+    struct end_t {};
+
+    champ_iterator() = default;
+
+    champ_iterator(const tree_t& v)
+        : depth_ { 0 }
+    {
+        path_[0] = &v.root;
+        set_current(v.root);
+        ensure_valid();
+    }
+
+    champ_iterator(const tree_t& v, end_t)
+        : cur_   { nullptr }
+        , end_   { nullptr }
+        , depth_ { 0 }
+    {
+        path_[0] = &v.root;
+    }
+
+private:
+    friend class boost::iterator_core_access;
+
+    // Values are visited in depth-first order: first the values of an
+    // inner node, then its subtrees.  `path_[d]` points to the slot
+    // holding the node at depth `d`, so the next sibling is just the
+    // next slot in the parent.  Collision nodes are below
+    // `max_depth<B>`, where `collision_` is the one being visited.
+    T*      cur_;
+    T*      end_;
+    count_t depth_;
+    node_t* collision_;
+    node_t* const* path_[max_depth<B> + 1];
+
+    void set_current(node_t* node)
+    {
+        if (depth_ < max_depth<B>) {
+            cur_ = node->values();
+            end_ = cur_ + node->data_count();
+        } else {
+            collision_ = node;
+            cur_ = node->collision();
+            end_ = cur_ + 1;
+        }
+    }
+
+    bool step_down()
+    {
+        if (depth_ < max_depth<B>) {
+            auto parent = *path_[depth_];
+            if (parent->nodemap()) {
+                ++depth_;
+                path_[depth_] = parent->children();
+                set_current(*path_[depth_]);
+                return true;
+            }
+        } else if (auto next = collision_->collision_next()) {
+            set_current(next);
+            return true;
+        }
+        return false;
+    }
+
+    bool step_right()
+    {
+        while (depth_ > 0) {
+            auto parent = *path_[depth_ - 1];
+            auto last   = parent->children() + parent->children_count();
+            auto next   = path_[depth_] + 1;
+            if (next < last) {
+                path_[depth_] = next;
+                set_current(*next);
+                return true;
+            }
+            --depth_;
+        }
+        return false;
+    }
+
+    void ensure_valid()
+    {
+        while (cur_ == end_) {
+            while (step_down())
+                if (cur_ != end_)
+                    return;
+            if (!step_right()) {
+                cur_ = end_ = nullptr;
+                return;
+            }
+        }
+    }
+
+    void increment()
+    {
+        ++cur_;
+        ensure_valid();
+    }
+
+    bool equal(const champ_iterator& other) const
+    {
+        return cur_ == other.cur_;
+    }
+
+    const T& dereference() const
+    {
+        return *cur_;
+    }
+};
+
+} // namespace hamts
+} // namespace detail
+} // namespace immer
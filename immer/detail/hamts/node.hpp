@@ -0,0 +1,600 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <immer/detail/util.hpp>
+#include <immer/detail/hamts/bits.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+#ifdef NDEBUG
+#define IMMER_HAMTS_TAGGED_NODE 0
+#else
+#define IMMER_HAMTS_TAGGED_NODE 1
+#endif
+
+namespace immer {
+namespace detail {
+namespace hamts {
+
+template <typename T>
+using aligned_storage_for =
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+// Node of a hash array mapped trie.  Inner nodes, those above
+// `max_depth<B>`, are CHAMP nodes: they contain a bitmap of the
+// positions that hold a subtree (`nodemap`), a bitmap of the
+// positions that hold a value (`datamap`), the children inline and a
+// pointer to a separately allocated array of values.  Keeping the
+// values apart means that updating a subtree does not copy the values
+// of its ancestors, which are just shared.
+//
+// Values whose hashes are completely equal are kept at the bottom in
+// a list of *collision* nodes, each holding one value.  This keeps
+// every allocation bounded by the size of the biggest inner node,
+// regardless of the number of collisions.
+template <typename T,
+          typename MemoryPolicy,
+          bits_t   B>
+struct node
+{
+    static constexpr auto bits = B;
+
+    using node_t      = node;
+    using memory      = MemoryPolicy;
+    using heap_policy = typename memory::heap;
+    using transience  = typename memory::transience_t;
+    using refs_t      = typename memory::refcount;
+    using ownee_t     = typename transience::ownee;
+    using edit_t      = typename transience::edit;
+    using value_t     = T;
+
+    static_assert(branches<B> <= sizeof(bitmap_t) * 8,
+                  "the bitmap is too small for this branching factor");
+
+    enum class kind_t
+    {
+        collision,
+        inner
+    };
+
+    struct meta_t
+        : refs_t
+        , ownee_t
+    {};
+
+    static constexpr bool has_meta = !std::is_empty<meta_t>{};
+
+    struct values_meta_t
+    {
+        meta_t meta;
+        aligned_storage_for<T> buffer;
+    };
+
+    struct values_no_meta_t : meta_t
+    {
+        aligned_storage_for<T> buffer;
+    };
+
+    using values_t = std::conditional_t<has_meta,
+                                        values_meta_t,
+                                        values_no_meta_t>;
+
+    struct inner_t
+    {
+        bitmap_t  nodemap;
+        bitmap_t  datamap;
+        values_t* values;
+        aligned_storage_for<node_t*> buffer;
+    };
+
+    struct collision_t
+    {
+        node_t* next;
+        aligned_storage_for<T> buffer;
+    };
+
+    union data_t
+    {
+        inner_t     inner;
+        collision_t collision;
+    };
+
+    struct impl_meta_t
+    {
+        meta_t meta;
+#if IMMER_HAMTS_TAGGED_NODE
+        kind_t kind;
+#endif
+        data_t data;
+    };
+
+    struct impl_no_meta_t : meta_t
+    {
+#if IMMER_HAMTS_TAGGED_NODE
+        kind_t kind;
+#endif
+        data_t data;
+    };
+
+    using impl_t = std::conditional_t<has_meta,
+                                      impl_meta_t,
+                                      impl_no_meta_t>;
+
+    static_assert(
+        std::is_standard_layout<impl_t>::value,
+        "payload must be of standard layout so we can use offsetof");
+
+    impl_t impl;
+
+    constexpr static std::size_t sizeof_values_n(count_t count)
+    {
+        return offsetof(values_t, buffer)
+            +  sizeof(aligned_storage_for<T>) * count;
+    }
+
+    constexpr static std::size_t sizeof_inner_n(count_t count)
+    {
+        return offsetof(impl_t, data.inner.buffer)
+            +  sizeof(inner_t::buffer) * count;
+    }
+
+    constexpr static std::size_t sizeof_collision =
+        offsetof(impl_t, data.collision.buffer)
+        + sizeof(collision_t::buffer);
+
+    constexpr static std::size_t max_sizeof_values =
+        sizeof_values_n(branches<B>);
+
+    constexpr static std::size_t max_sizeof_inner =
+        sizeof_inner_n(branches<B>);
+
+    using heap = typename heap_policy::template apply<
+        max_sizeof_inner,
+        max_sizeof_values,
+        sizeof_collision
+    >::type;
+
+#if IMMER_HAMTS_TAGGED_NODE
+    kind_t kind() const
+    {
+        return impl.kind;
+    }
+#endif
+
+    bitmap_t nodemap() const
+    {
+        assert(kind() == kind_t::inner);
+        return impl.data.inner.nodemap;
+    }
+
+    bitmap_t datamap() const
+    {
+        assert(kind() == kind_t::inner);
+        return impl.data.inner.datamap;
+    }
+
+    count_t children_count() const
+    {
+        return popcount(nodemap());
+    }
+
+    count_t data_count() const
+    {
+        return popcount(datamap());
+    }
+
+    node_t** children()
+    {
+        assert(kind() == kind_t::inner);
+        return reinterpret_cast<node_t**>(&impl.data.inner.buffer);
+    }
+
+    T* values()
+    {
+        assert(kind() == kind_t::inner);
+        auto p = impl.data.inner.values;
+        return p ? reinterpret_cast<T*>(&p->buffer) : nullptr;
+    }
+
+    T* collision()
+    {
+        assert(kind() == kind_t::collision);
+        return reinterpret_cast<T*>(&impl.data.collision.buffer);
+    }
+
+    node_t* collision_next()
+    {
+        assert(kind() == kind_t::collision);
+        return impl.data.collision.next;
+    }
+
+    template <typename U> friend auto meta_(U* x)       -> decltype(static_cast<meta_t&>(*x)) { return *x; }
+    template <typename U> friend auto meta_(const U* x) -> decltype(static_cast<const meta_t&>(*x)) { return *x; }
+    template <typename U> friend auto meta_(U* x)       -> decltype(static_cast<meta_t&>(x->meta)) { return x->meta; }
+    template <typename U> friend auto meta_(const U* x) -> decltype(static_cast<const meta_t&>(x->meta)) { return x->meta; }
+    template <typename U> friend auto meta_(U* x)       -> decltype(static_cast<meta_t&>(x->impl)) { return x->impl; }
+    template <typename U> friend auto meta_(const U* x) -> decltype(static_cast<const meta_t&>(x->impl)) { return x->impl; }
+    template <typename U> friend auto meta_(U* x)       -> decltype(static_cast<meta_t&>(x->impl.meta)) { return x->impl.meta; }
+    template <typename U> friend auto meta_(const U* x) -> decltype(static_cast<const meta_t&>(x->impl.meta)) { return x->impl.meta; }
+
+    template <typename U> static refs_t& refs(const U* x) { return const_cast<meta_t&>(meta_(x)); }
+    template <typename U> static refs_t& refs(U* x) { return meta_(x); }
+
+    template <typename U> static const ownee_t& ownee(const U* x) { return meta_(x); }
+    template <typename U> static ownee_t& ownee(U* x) { return meta_(x); }
+
+    // the root of the empty containers is created during static
+    // initialization and lives as long as the program
+    static node_t* make_empty_inner()
+    {
+        auto p = new (check_alloc(allocate_immortal<heap>(sizeof_inner_n(0)))) node_t;
+        p->impl.data.inner.nodemap = 0;
+        p->impl.data.inner.datamap = 0;
+        p->impl.data.inner.values  = nullptr;
+#if IMMER_HAMTS_TAGGED_NODE
+        p->impl.kind = node_t::kind_t::inner;
+#endif
+        return p;
+    }
+
+    // Allocates an inner node with room for `nn` children and `nv`
+    // values.  Both bitmaps are left empty and the contents
+    // uninitialized.
+    static node_t* make_inner_n(count_t nn, count_t nv)
+    {
+        assert(nn <= branches<B>);
+        assert(nv <= branches<B>);
+        auto p = new (check_alloc(heap::allocate(sizeof_inner_n(nn)))) node_t;
+        p->impl.data.inner.nodemap = 0;
+        p->impl.data.inner.datamap = 0;
+        p->impl.data.inner.values  = nullptr;
+#if IMMER_HAMTS_TAGGED_NODE
+        p->impl.kind = node_t::kind_t::inner;
+#endif
+        if (nv) {
+            try {
+                p->impl.data.inner.values =
+                    new (check_alloc(heap::allocate(sizeof_values_n(nv)))) values_t;
+            } catch (...) {
+                heap::deallocate(p);
+                throw;
+            }
+        }
+        return p;
+    }
+
+    // Makes a collision node holding `x` followed by `next`.  The
+    // reference to `next` is taken over only when no exception is
+    // thrown.
+    template <typename U>
+    static node_t* make_collision(U&& x, node_t* next)
+    {
+        auto p = new (check_alloc(heap::allocate(sizeof_collision))) node_t;
+#if IMMER_HAMTS_TAGGED_NODE
+        p->impl.kind = node_t::kind_t::collision;
+#endif
+        p->impl.data.collision.next = next;
+        try {
+            new (p->collision()) T{ std::forward<U>(x) };
+        } catch (...) {
+            heap::deallocate(p);
+            throw;
+        }
+        return p;
+    }
+
+    // Makes the subtree at `shift` containing the values `x` and `y`,
+    // with hashes `xh` and `yh`.  The values are placed as soon as
+    // their hashes diverge, or in a collision list when they never do.
+    template <typename U>
+    static node_t* make_merged(shift_t shift,
+                               const T& x, hash_t xh,
+                               U&& y, hash_t yh)
+    {
+        if (shift < max_shift<B>) {
+            auto xi = (xh >> shift) & mask<B>;
+            auto yi = (yh >> shift) & mask<B>;
+            if (xi != yi) {
+                auto p = make_inner_n(0, 2);
+                auto v = p->values();
+                auto xo = xi < yi ? 0 : 1;
+                p->impl.data.inner.datamap = (bitmap_t{1} << xi)
+                                           | (bitmap_t{1} << yi);
+                try {
+                    new (v + xo) T{ x };
+                    try {
+                        new (v + (1 - xo)) T{ std::forward<U>(y) };
+                    } catch (...) {
+                        v[xo].~T();
+                        throw;
+                    }
+                } catch (...) {
+                    deallocate_inner(p);
+                    throw;
+                }
+                return p;
+            } else {
+                auto p = make_inner_n(1, 0);
+                p->impl.data.inner.nodemap = bitmap_t{1} << xi;
+                try {
+                    p->children() [0] = make_merged(shift + B,
+                                                    x, xh,
+                                                    std::forward<U>(y), yh);
+                } catch (...) {
+                    deallocate_inner(p);
+                    throw;
+                }
+                return p;
+            }
+        } else {
+            auto p = make_collision(std::forward<U>(y), nullptr);
+            try {
+                return make_collision(x, p);
+            } catch (...) {
+                delete_collision(p);
+                throw;
+            }
+        }
+    }
+
+    // Copy of `src` where the child at `offset` is replaced by
+    // `child`, whose reference is taken over when no exception is
+    // thrown.  The values are shared.
+    static node_t* copy_inner_replace(node_t* src, count_t offset,
+                                      node_t* child)
+    {
+        auto n   = src->children_count();
+        auto dst = make_inner_n(n, 0);
+        auto srcp = src->children();
+        auto dstp = dst->children();
+        dst->impl.data.inner.nodemap = src->nodemap();
+        dst->impl.data.inner.datamap = src->datamap();
+        share_values(dst, src);
+        inc_nodes(srcp, offset);
+        inc_nodes(srcp + offset + 1, n - offset - 1);
+        std::uninitialized_copy(srcp, srcp + offset, dstp);
+        dstp[offset] = child;
+        std::uninitialized_copy(srcp + offset + 1, srcp + n, dstp + offset + 1);
+        return dst;
+    }
+
+    // Copy of `src` where the value at `offset` is replaced by `x`.
+    template <typename U>
+    static node_t* copy_inner_replace_value(node_t* src, count_t offset,
+                                            U&& x)
+    {
+        auto nn  = src->children_count();
+        auto nv  = src->data_count();
+        auto dst = make_inner_n(nn, nv);
+        auto srcv = src->values();
+        auto dstv = dst->values();
+        auto i    = dstv;
+        dst->impl.data.inner.nodemap = src->nodemap();
+        dst->impl.data.inner.datamap = src->datamap();
+        try {
+            i = std::uninitialized_copy(srcv, srcv + offset, i);
+            new (i) T{ std::forward<U>(x) };
+            ++i;
+            i = std::uninitialized_copy(srcv + offset + 1, srcv + nv, i);
+        } catch (...) {
+            destroy_n(dstv, i - dstv);
+            deallocate_inner(dst);
+            throw;
+        }
+        copy_children(dst, src, nn);
+        return dst;
+    }
+
+    // Copy of `src` with `x` added at the position given by `bit`.
+    template <typename U>
+    static node_t* copy_inner_insert_value(node_t* src, bitmap_t bit, U&& x)
+    {
+        assert(!(src->nodemap() & bit));
+        assert(!(src->datamap() & bit));
+        auto offset = popcount(src->datamap() & (bit - 1));
+        auto nn   = src->children_count();
+        auto nv   = src->data_count();
+        auto dst  = make_inner_n(nn, nv + 1);
+        auto srcv = src->values();
+        auto dstv = dst->values();
+        auto i    = dstv;
+        dst->impl.data.inner.nodemap = src->nodemap();
+        dst->impl.data.inner.datamap = src->datamap() | bit;
+        try {
+            i = std::uninitialized_copy(srcv, srcv + offset, i);
+            new (i) T{ std::forward<U>(x) };
+            ++i;
+            i = std::uninitialized_copy(srcv + offset, srcv + nv, i);
+        } catch (...) {
+            destroy_n(dstv, i - dstv);
+            deallocate_inner(dst);
+            throw;
+        }
+        copy_children(dst, src, nn);
+        return dst;
+    }
+
+    // Copy of `src` without the value at `offset` at the position
+    // given by `bit`.
+    static node_t* copy_inner_remove_value(node_t* src, bitmap_t bit,
+                                           count_t offset)
+    {
+        assert(src->datamap() & bit);
+        auto nn   = src->children_count();
+        auto nv   = src->data_count();
+        auto dst  = make_inner_n(nn, nv - 1);
+        auto srcv = src->values();
+        auto dstv = dst->values();
+        auto i    = dstv;
+        dst->impl.data.inner.nodemap = src->nodemap();
+        dst->impl.data.inner.datamap = src->datamap() & ~bit;
+        try {
+            i = std::uninitialized_copy(srcv, srcv + offset, i);
+            i = std::uninitialized_copy(srcv + offset + 1, srcv + nv, i);
+        } catch (...) {
+            destroy_n(dstv, i - dstv);
+            deallocate_inner(dst);
+            throw;
+        }
+        copy_children(dst, src, nn);
+        return dst;
+    }
+
+    // Copy of `src` where the value at `offset` at the position given
+    // by `bit` is replaced by the subtree `child`, whose reference is
+    // taken over when no exception is thrown.
+    static node_t* copy_inner_replace_merged(node_t* src, bitmap_t bit,
+                                             count_t offset, node_t* child)
+    {
+        assert(!(src->nodemap() & bit));
+        assert(src->datamap() & bit);
+        auto noffset = popcount(src->nodemap() & (bit - 1));
+        auto nn   = src->children_count();
+        auto nv   = src->data_count();
+        auto dst  = make_inner_n(nn + 1, nv - 1);
+        auto srcv = src->values();
+        auto dstv = dst->values();
+        auto i    = dstv;
+        dst->impl.data.inner.nodemap = src->nodemap() | bit;
+        dst->impl.data.inner.datamap = src->datamap() & ~bit;
+        try {
+            i = std::uninitialized_copy(srcv, srcv + offset, i);
+            i = std::uninitialized_copy(srcv + offset + 1, srcv + nv, i);
+        } catch (...) {
+            destroy_n(dstv, i - dstv);
+            deallocate_inner(dst);
+            throw;
+        }
+        auto srcp = src->children();
+        auto dstp = dst->children();
+        inc_nodes(srcp, nn);
+        std::uninitialized_copy(srcp, srcp + noffset, dstp);
+        dstp[noffset] = child;
+        std::uninitialized_copy(srcp + noffset, srcp + nn, dstp + noffset + 1);
+        return dst;
+    }
+
+    // Copy of `src` where the child at `offset` at the position given
+    // by `bit` is replaced by the value `x`.
+    static node_t* copy_inner_replace_inline(node_t* src, bitmap_t bit,
+                                             count_t offset, const T& x)
+    {
+        assert(src->nodemap() & bit);
+        assert(!(src->datamap() & bit));
+        auto voffset = popcount(src->datamap() & (bit - 1));
+        auto nn   = src->children_count();
+        auto nv   = src->data_count();
+        auto dst  = make_inner_n(nn - 1, nv + 1);
+        auto srcv = src->values();
+        auto dstv = dst->values();
+        auto i    = dstv;
+        dst->impl.data.inner.nodemap = src->nodemap() & ~bit;
+        dst->impl.data.inner.datamap = src->datamap() | bit;
+        try {
+            i = std::uninitialized_copy(srcv, srcv + voffset, i);
+            new (i) T{ x };
+            ++i;
+            i = std::uninitialized_copy(srcv + voffset, srcv + nv, i);
+        } catch (...) {
+            destroy_n(dstv, i - dstv);
+            deallocate_inner(dst);
+            throw;
+        }
+        auto srcp = src->children();
+        auto dstp = dst->children();
+        inc_nodes(srcp, offset);
+        inc_nodes(srcp + offset + 1, nn - offset - 1);
+        std::uninitialized_copy(srcp, srcp + offset, dstp);
+        std::uninitialized_copy(srcp + offset + 1, srcp + nn, dstp + offset);
+        return dst;
+    }
+
+    static void share_values(node_t* dst, node_t* src)
+    {
+        auto v = src->impl.data.inner.values;
+        if (v)
+            refs(v).inc();
+        dst->impl.data.inner.values = v;
+    }
+
+    static void copy_children(node_t* dst, node_t* src, count_t n)
+    {
+        auto p = src->children();
+        inc_nodes(p, n);
+        std::uninitialized_copy(p, p + n, dst->children());
+    }
+
+    // Releases the memory of an inner node and its values array
+    // without destroying the values.
+    static void deallocate_inner(node_t* p)
+    {
+        assert(p->kind() == kind_t::inner);
+        if (auto v = p->impl.data.inner.values)
+            heap::deallocate(v);
+        heap::deallocate(p);
+    }
+
+    static void delete_inner(node_t* p)
+    {
+        assert(p->kind() == kind_t::inner);
+        auto v = p->impl.data.inner.values;
+        if (v && refs(v).dec()) {
+            destroy_n(p->values(), p->data_count());
+            heap::deallocate(v);
+        }
+        heap::deallocate(p);
+    }
+
+    static void delete_collision(node_t* p)
+    {
+        assert(p->kind() == kind_t::collision);
+        p->collision()->~T();
+        heap::deallocate(p);
+    }
+
+    node_t* inc()
+    {
+        refs(this).inc();
+        return this;
+    }
+
+    const node_t* inc() const
+    {
+        refs(this).inc();
+        return this;
+    }
+
+    bool dec() const { return refs(this).dec(); }
+
+    static void inc_nodes(node_t** p, count_t n)
+    {
+        for (auto i = p, e = i + n; i != e; ++i)
+            refs(*i).inc();
+    }
+};
+
+} // namespace hamts
+} // namespace detail
+} // namespace immer
@@ -0,0 +1,61 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <immer/config.hpp>
+
+#include <cstddef>
+
+namespace immer {
+namespace detail {
+
+enum class heap_kind
+{
+    malloc,
+    gc,
+    free_list,
+    thread_local_free_list,
+    unsafe_free_list,
+};
+
+/*!
+ * Records the activity of the heap `Heap`.  It is defined in
+ * `immer/heap/heap_stats.hpp` when `IMMER_HEAP_STATS` is enabled,
+ * otherwise all its operations do nothing, so heaps do not need to
+ * pull in the statistics registry.
+ */
+#if IMMER_HEAP_STATS
+template <typename Heap, heap_kind Kind, std::size_t Size = 0>
+struct heap_stats_recorder;
+#else
+template <typename Heap, heap_kind Kind, std::size_t Size = 0>
+struct heap_stats_recorder
+{
+    static void allocate(std::size_t, bool, std::size_t = 1) {}
+    static void allocate(std::size_t) {}
+    static void deallocate(std::size_t = 1) {}
+    static void deallocate_bytes(std::size_t) {}
+    static void park(std::ptrdiff_t) {}
+};
+#endif
+
+} // namespace detail
+} // namespace immer
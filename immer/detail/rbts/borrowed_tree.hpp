@@ -0,0 +1,66 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <new>
+#include <type_traits>
+
+namespace immer {
+namespace detail {
+namespace rbts {
+
+/*!
+ * Tree that refers to the nodes of another one without holding a
+ * reference to them.  It is copied and destroyed without touching
+ * any reference count, so the nodes must be kept alive by someone
+ * else for as long as it is used.
+ */
+template <typename Tree>
+class borrowed_tree
+{
+public:
+    borrowed_tree(const Tree& t)
+    { borrow(t); }
+
+    borrowed_tree(const borrowed_tree& other)
+        : borrowed_tree{other.get()}
+    {}
+
+    borrowed_tree& operator=(const borrowed_tree& other)
+    {
+        borrow(other.get());
+        return *this;
+    }
+
+    const Tree& get() const
+    { return *reinterpret_cast<const Tree*>(&storage_); }
+
+private:
+    // the tree is never destroyed, so it can just be overwritten
+    void borrow(const Tree& t)
+    { new (&storage_) Tree{t.size, t.shift, t.root, t.tail}; }
+
+    std::aligned_storage_t<sizeof(Tree), alignof(Tree)> storage_;
+};
+
+} // namespace rbts
+} // namespace detail
+} // namespace immer
@@ -24,6 +24,7 @@
 #include <immer/detail/util.hpp>
 #include <immer/detail/rbts/bits.hpp>
 
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <memory>
@@ -61,7 +62,7 @@ struct node
     using edit_t      = typename transience::edit;
     using value_t     = T;
 
-    enum class kind_t
+    enum class kind_t : unsigned char
     {
         leaf,
         inner
@@ -75,6 +76,16 @@ struct node
     static constexpr bool has_meta      = !std::is_empty<meta_t>{};
     static constexpr bool embed_relaxed = memory::prefer_fewer_bigger_objects;
 
+    // assume that we need to keep headroom space in the node when we
+    // are doing reference counting, since any node may become
+    // transient when it has only one reference.  When the memory
+    // policy prefers packed nodes instead, every node remembers
+    // whether it has headroom, and the ones that do not are
+    // reallocated the first time they need to grow in place
+    static constexpr bool refcounted     = !std::is_empty<refs_t>{};
+    static constexpr bool keep_headroom  = refcounted && memory::keep_headroom;
+    static constexpr bool track_headroom = refcounted && !memory::keep_headroom;
+
     struct relaxed_meta_t
     {
         meta_t  meta;
@@ -106,12 +117,25 @@ struct node
         aligned_storage_for<T> buffer;
     };
 
-    struct inner_t
+    struct inner_no_digest_t
     {
         relaxed_t*  relaxed;
         aligned_storage_for<node_t*> buffer;
     };
 
+    // the digest is constructed by the `make_inner_*` functions, so
+    // the node stays trivially constructible
+    struct inner_digest_t
+    {
+        relaxed_t*  relaxed;
+        aligned_storage_for<std::atomic<std::size_t>> digest;
+        aligned_storage_for<node_t*> buffer;
+    };
+
+    using inner_t = std::conditional_t<memory::cache_digests,
+                                       inner_digest_t,
+                                       inner_no_digest_t>;
+
     union data_t
     {
         inner_t inner;
@@ -135,9 +159,22 @@ struct node
         data_t data;
     };
 
-    using impl_t = std::conditional_t<has_meta,
-                                      impl_meta_t,
-                                      impl_no_meta_t>;
+    struct impl_refs_t
+    {
+        meta_t meta;
+        bool   immortal;
+        bool   headroom;
+#if IMMER_RBTS_TAGGED_NODE
+        kind_t kind;
+#endif
+        data_t data;
+    };
+
+    using impl_t = std::conditional_t<refcounted,
+                                      impl_refs_t,
+                                      std::conditional_t<has_meta,
+                                                         impl_meta_t,
+                                                         impl_no_meta_t>>;
 
     static_assert(
         std::is_standard_layout<impl_t>::value,
@@ -145,11 +182,6 @@ struct node
 
     impl_t impl;
 
-    // assume that we need to keep headroom space in the node when we
-    // are doing reference counting, since any node may become
-    // transient when it has only one reference
-    constexpr static bool keep_headroom = !std::is_empty<refs_t>{};
-
     constexpr static std::size_t sizeof_packed_leaf_n(count_t count)
     {
         return offsetof(impl_t, data.leaf.buffer)
@@ -193,8 +225,10 @@ struct node
     constexpr static std::size_t sizeof_inner_r_n(count_t n)
     { return keep_headroom ? max_sizeof_inner_r : sizeof_packed_inner_r_n(n); }
 
+    // separately allocated size tables may be shared by nodes with and
+    // without headroom, so they are never packed when counting refs
     constexpr static std::size_t sizeof_relaxed_n(count_t n)
-    { return keep_headroom ? max_sizeof_inner : sizeof_packed_relaxed_n(n); }
+    { return refcounted ? max_sizeof_relaxed : sizeof_packed_relaxed_n(n); }
 
     constexpr static std::size_t sizeof_leaf_n(count_t n)
     { return keep_headroom ? max_sizeof_leaf : sizeof_packed_leaf_n(n); }
@@ -202,6 +236,7 @@ struct node
     using heap = typename heap_policy::template apply<
         max_sizeof_inner,
         max_sizeof_inner_r,
+        max_sizeof_relaxed,
         max_sizeof_leaf
     >::type;
 
@@ -245,12 +280,65 @@ struct node
     template <typename U> static const ownee_t& ownee(const U* x) { return meta_(x); }
     template <typename U> static ownee_t& ownee(U* x) { return meta_(x); }
 
+    static bool headroom_(const impl_refs_t& x) { return !track_headroom || x.headroom; }
+    template <typename I> static bool headroom_(const I&) { return true; }
+
+    static bool immortal_(const impl_refs_t& x) { return x.immortal; }
+    template <typename I> static bool immortal_(const I&) { return false; }
+
+    static void init_flags_(impl_refs_t& x, bool headroom) { x.immortal = false; x.headroom = headroom; }
+    template <typename I> static void init_flags_(I&, bool) {}
+
+    static void make_immortal_(impl_refs_t& x) { x.immortal = true; }
+    template <typename I> static void make_immortal_(I&) {}
+
+    bool has_headroom() const { return headroom_(impl); }
+    bool is_immortal() const { return immortal_(impl); }
+    static void init_flags(node_t* p, bool headroom) { init_flags_(p->impl, headroom); }
+
+    // the nodes of the empty containers are shared by all threads, so
+    // their reference count is never touched, to avoid contention on
+    // it.  The extra reference keeps them from looking unique, so they
+    // are never mutated in place either
+    static node_t* make_immortal(node_t* p)
+    {
+        refs(p).inc();
+        make_immortal_(p->impl);
+        return p;
+    }
+
+    static node_t* make_empty_inner()
+    {
+        auto m = check_alloc(allocate_immortal<heap>(sizeof_inner_n(0)));
+        auto p = new (m) node_t;
+        init_flags(p, false);
+        p->impl.data.inner.relaxed = nullptr;
+        p->init_digest(frozen_digest);
+#if IMMER_RBTS_TAGGED_NODE
+        p->impl.kind = node_t::kind_t::inner;
+#endif
+        return make_immortal(p);
+    }
+
+    static node_t* make_empty_leaf()
+    {
+        auto m = check_alloc(allocate_immortal<heap>(sizeof_leaf_n(0)));
+        auto p = new (m) node_t;
+        init_flags(p, false);
+#if IMMER_RBTS_TAGGED_NODE
+        p->impl.kind = node_t::kind_t::leaf;
+#endif
+        return make_immortal(p);
+    }
+
     static node_t* make_inner_n(count_t n)
     {
         assert(n <= branches<B>);
         auto m = check_alloc(heap::allocate(sizeof_inner_n(n)));
         auto p = new (m) node_t;
+        init_flags(p, n == branches<B>);
         p->impl.data.inner.relaxed = nullptr;
+        p->init_digest();
 #if IMMER_RBTS_TAGGED_NODE
         p->impl.kind = node_t::kind_t::inner;
 #endif
@@ -261,8 +349,10 @@ struct node
     {
         auto m = check_alloc(heap::allocate(max_sizeof_inner));
         auto p = new (m) node_t;
+        init_flags(p, true);
         ownee(p) = e;
         p->impl.data.inner.relaxed = nullptr;
+        p->init_digest();
 #if IMMER_RBTS_TAGGED_NODE
         p->impl.kind = node_t::kind_t::inner;
 #endif
@@ -286,8 +376,10 @@ struct node
         }
         auto p = new (mp) node_t;
         auto r = new (mr) relaxed_t;
+        init_flags(p, n == branches<B>);
         r->count = 0;
         p->impl.data.inner.relaxed = r;
+        p->init_digest();
 #if IMMER_RBTS_TAGGED_NODE
         p->impl.kind = node_t::kind_t::inner;
 #endif
@@ -303,8 +395,10 @@ struct node
             [&] (auto) {
                 auto p = new (check_alloc(heap::allocate(node_t::sizeof_inner_r_n(n)))) node_t;
                 assert(r->count >= n);
+                init_flags(p, n == branches<B>);
                 refs(r).inc();
                 p->impl.data.inner.relaxed = r;
+                p->init_digest();
 #if IMMER_RBTS_TAGGED_NODE
                 p->impl.kind = node_t::kind_t::inner;
 #endif
@@ -328,10 +422,12 @@ struct node
         }
         auto p = new (mp) node_t;
         auto r = new (mr) relaxed_t;
+        init_flags(p, true);
         ownee(p) = e;
         static_if<!embed_relaxed>([&](auto){ ownee(r) = e; });
         r->count = 0;
         p->impl.data.inner.relaxed = r;
+        p->init_digest();
 #if IMMER_RBTS_TAGGED_NODE
         p->impl.kind = node_t::kind_t::inner;
 #endif
@@ -347,7 +443,9 @@ struct node
             [&] (auto) {
                 auto p = new (check_alloc(heap::allocate(node_t::max_sizeof_inner_r))) node_t;
                 refs(r).inc();
+                init_flags(p, true);
                 p->impl.data.inner.relaxed = r;
+                p->init_digest();
                 ownee(p) = e;
 #if IMMER_RBTS_TAGGED_NODE
                 p->impl.kind = node_t::kind_t::inner;
@@ -356,10 +454,27 @@ struct node
             });
     }
 
+    // Leaves of pointer free values do not need to be scanned by a
+    // tracing garbage collector.  Leaves owned by a transient must be
+    // scanned when the ownee points to the edit token, that could
+    // otherwise be collected and handed to another transient.
+    static constexpr bool norefs_leaf_n = is_pointer_free<T>::value;
+    static constexpr bool norefs_leaf_e =
+        norefs_leaf_n && std::is_empty<ownee_t>::value;
+
+    template <bool NoRefs>
+    static void* allocate_leaf(std::size_t size)
+    {
+        return static_if<NoRefs, void*>(
+            [&] (auto) { return heap::allocate(size, norefs_tag{}); },
+            [&] (auto) { return heap::allocate(size); });
+    }
+
     static node_t* make_leaf_n(count_t n)
     {
         assert(n <= branches<BL>);
-        auto p = new (check_alloc(heap::allocate(sizeof_leaf_n(n)))) node_t;
+        auto p = new (check_alloc(allocate_leaf<norefs_leaf_n>(sizeof_leaf_n(n)))) node_t;
+        init_flags(p, n == branches<BL>);
 #if IMMER_RBTS_TAGGED_NODE
         p->impl.kind = node_t::kind_t::leaf;
 #endif
@@ -368,7 +483,8 @@ struct node
 
     static node_t* make_leaf_e(edit_t e)
     {
-        auto p = new (check_alloc(heap::allocate(max_sizeof_leaf))) node_t;
+        auto p = new (check_alloc(allocate_leaf<norefs_leaf_e>(max_sizeof_leaf))) node_t;
+        init_flags(p, true);
         ownee(p) = e;
 #if IMMER_RBTS_TAGGED_NODE
         p->impl.kind = node_t::kind_t::leaf;
@@ -734,6 +850,111 @@ struct node
         return dst;
     }
 
+    template <typename U>
+    static node_t* copy_leaf_insert(node_t* src, count_t n, count_t idx, U&& x)
+    {
+        assert(idx <= n);
+        auto dst = copy_leaf_n(n + 1, src, idx);
+        try {
+            new (dst->leaf() + idx) T{std::forward<U>(x)};
+        } catch (...) {
+            destroy_n(dst->leaf(), idx);
+            heap::deallocate(dst);
+            throw;
+        }
+        try {
+            std::uninitialized_copy(
+                src->leaf() + idx, src->leaf() + n, dst->leaf() + idx + 1);
+        } catch (...) {
+            destroy_n(dst->leaf(), idx + 1);
+            heap::deallocate(dst);
+            throw;
+        }
+        return dst;
+    }
+
+    // like the above, but copying only the elements in `[first, last)`
+    template <typename U>
+    static node_t* copy_leaf_insert(node_t* src, count_t first, count_t last,
+                                    count_t idx, U&& x)
+    {
+        return do_copy_leaf_insert(make_leaf_n(last - first + 1),
+                                   src, first, last, idx, std::forward<U>(x));
+    }
+
+    template <typename U>
+    static node_t* copy_leaf_insert_e(edit_t e, node_t* src,
+                                      count_t first, count_t last,
+                                      count_t idx, U&& x)
+    {
+        return do_copy_leaf_insert(make_leaf_e(e),
+                                   src, first, last, idx, std::forward<U>(x));
+    }
+
+    template <typename U>
+    static node_t* do_copy_leaf_insert(node_t* dst, node_t* src,
+                                       count_t first, count_t last,
+                                       count_t idx, U&& x)
+    {
+        assert(first <= idx && idx <= last);
+        auto n   = idx - first;
+        try {
+            std::uninitialized_copy(
+                src->leaf() + first, src->leaf() + idx, dst->leaf());
+        } catch (...) {
+            heap::deallocate(dst);
+            throw;
+        }
+        try {
+            new (dst->leaf() + n) T{std::forward<U>(x)};
+        } catch (...) {
+            destroy_n(dst->leaf(), n);
+            heap::deallocate(dst);
+            throw;
+        }
+        try {
+            std::uninitialized_copy(
+                src->leaf() + idx, src->leaf() + last, dst->leaf() + n + 1);
+        } catch (...) {
+            destroy_n(dst->leaf(), n + 1);
+            heap::deallocate(dst);
+            throw;
+        }
+        return dst;
+    }
+
+    static node_t* copy_leaf_erase(node_t* src, count_t n,
+                                   count_t first, count_t last)
+    {
+        assert(first <= last && last <= n);
+        auto dst = copy_leaf_n(n - (last - first), src, first);
+        try {
+            std::uninitialized_copy(
+                src->leaf() + last, src->leaf() + n, dst->leaf() + first);
+        } catch (...) {
+            destroy_n(dst->leaf(), first);
+            heap::deallocate(dst);
+            throw;
+        }
+        return dst;
+    }
+
+    static node_t* copy_leaf_erase_e(edit_t e, node_t* src, count_t n,
+                                     count_t first, count_t last)
+    {
+        assert(first <= last && last <= n);
+        auto dst = copy_leaf_e(e, src, first);
+        try {
+            std::uninitialized_copy(
+                src->leaf() + last, src->leaf() + n, dst->leaf() + first);
+        } catch (...) {
+            destroy_n(dst->leaf(), first);
+            heap::deallocate(dst);
+            throw;
+        }
+        return dst;
+    }
+
     static void delete_inner(node_t* p)
     {
         assert(p->kind() == kind_t::inner);
@@ -766,6 +987,66 @@ struct node
             || ownee(this).can_mutate(e);
     }
 
+    // like `can_mutate()`, but also checks that there is room to add
+    // children or elements in place
+    bool can_grow(edit_t e) const
+    {
+        return has_headroom() && can_mutate(e);
+    }
+
+    // When the memory policy asks for it, inner nodes cache the digest
+    // of the elements in their subtree, as computed by `hash_visitor`.
+    // It is forgotten whenever the node is about to be changed in
+    // place.  Nodes that are shared by all threads or may live in
+    // read-only memory are frozen, so they never cache it.
+    static constexpr std::size_t no_digest     = ~std::size_t{};
+    static constexpr std::size_t frozen_digest = ~std::size_t{} - 1;
+
+    using digest_t = std::atomic<std::size_t>;
+
+    static_assert(std::is_trivially_destructible<digest_t>::value,
+                  "the digest is never destroyed");
+
+    static digest_t* digest_(inner_digest_t& x)
+    { return reinterpret_cast<digest_t*>(&x.digest); }
+    static digest_t* digest_(inner_no_digest_t&) { return nullptr; }
+
+    static void init_digest_(inner_digest_t& x, std::size_t d)
+    { new (&x.digest) digest_t{d}; }
+    static void init_digest_(inner_no_digest_t&, std::size_t) {}
+
+    std::size_t digest() const
+    {
+        assert(kind() == kind_t::inner);
+        auto x = digest_(const_cast<node_t*>(this)->impl.data.inner);
+        return x ? x->load(std::memory_order_relaxed) : no_digest;
+    }
+
+    void cache_digest(std::size_t d) const
+    {
+        assert(kind() == kind_t::inner);
+        auto x = digest_(const_cast<node_t*>(this)->impl.data.inner);
+        if (x && d < frozen_digest && x->load(std::memory_order_relaxed) == no_digest)
+            x->store(d, std::memory_order_relaxed);
+    }
+
+    void init_digest(std::size_t d = no_digest)
+    {
+        init_digest_(impl.data.inner, d);
+    }
+
+    void forget_digest()
+    {
+        if (auto x = digest_(impl.data.inner))
+            x->store(no_digest, std::memory_order_relaxed);
+    }
+
+    void freeze_digest()
+    {
+        if (auto x = digest_(impl.data.inner))
+            x->store(frozen_digest, std::memory_order_relaxed);
+    }
+
     relaxed_t* ensure_mutable_relaxed(edit_t e)
     {
         auto src_r = relaxed();
@@ -800,23 +1081,25 @@ struct node
 
     node_t* inc()
     {
-        refs(this).inc();
+        if (!is_immortal())
+            refs(this).inc();
         return this;
     }
 
     const node_t* inc() const
     {
-        refs(this).inc();
+        if (!is_immortal())
+            refs(this).inc();
         return this;
     }
 
-    bool dec() const { return refs(this).dec(); }
-    void dec_unsafe() const { refs(this).dec_unsafe(); }
+    bool dec() const { return !is_immortal() && refs(this).dec(); }
+    void dec_unsafe() const { if (!is_immortal()) refs(this).dec_unsafe(); }
 
     static void inc_nodes(node_t** p, count_t n)
     {
         for (auto i = p, e = i + n; i != e; ++i)
-            refs(*i).inc();
+            (*i)->inc();
     }
 
 #if IMMER_RBTS_TAGGED_NODE
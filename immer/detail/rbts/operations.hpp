@@ -21,13 +21,21 @@
 #pragma once
 
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <numeric>
+#include <tuple>
 #include <utility>
+#include <vector>
 
 #include <immer/config.hpp>
 #include <immer/detail/rbts/position.hpp>
 #include <immer/detail/rbts/visitor.hpp>
+#include <immer/detail/uninitialized_copy.hpp>
+#include <immer/detail/util.hpp>
+#include <immer/heap/tags.hpp>
 
 namespace immer {
 namespace detail {
@@ -92,6 +100,556 @@ struct for_each_chunk_visitor
     }
 };
 
+// Visits the chunks of the elements in `[first, pos.size())`.
+struct for_each_chunk_right_visitor
+{
+    using this_t = for_each_chunk_right_visitor;
+
+    template <typename Pos, typename Fn>
+    friend void visit_inner(this_t, Pos&& pos, size_t first, Fn&& fn)
+    {
+        auto idx = pos.subindex(first);
+        pos.nth_sub(idx, this_t{}, first - pos.size_before(idx), fn);
+        pos.each_right(for_each_chunk_visitor{}, idx + 1, fn);
+    }
+
+    template <typename Pos, typename Fn>
+    friend void visit_leaf(this_t, Pos&& pos, size_t first, Fn&& fn)
+    {
+        auto data = pos.node()->leaf();
+        fn(data + first, data + pos.count());
+    }
+};
+
+// Visits the chunks of the elements in `[0, last)`.
+struct for_each_chunk_left_visitor
+{
+    using this_t = for_each_chunk_left_visitor;
+
+    template <typename Pos, typename Fn>
+    friend void visit_inner(this_t, Pos&& pos, size_t last, Fn&& fn)
+    {
+        auto idx = pos.subindex(last - 1);
+        pos.each_left(for_each_chunk_visitor{}, idx, fn);
+        pos.nth_sub(idx, this_t{}, last - pos.size_before(idx), fn);
+    }
+
+    template <typename Pos, typename Fn>
+    friend void visit_leaf(this_t, Pos&& pos, size_t last, Fn&& fn)
+    {
+        auto data = pos.node()->leaf();
+        fn(data, data + last);
+    }
+};
+
+// Visits the chunks of the elements in `[first, last)`, where the
+// indices are relative to the beginning of the position and the range
+// is not empty.  Only the nodes overlapping the range are touched.
+struct for_each_chunk_i_visitor
+{
+    using this_t = for_each_chunk_i_visitor;
+
+    template <typename Pos, typename Fn>
+    friend void visit_inner(this_t, Pos&& pos,
+                            size_t first, size_t last, Fn&& fn)
+    {
+        assert(first < last);
+        auto l  = pos.subindex(first);
+        auto r  = pos.subindex(last - 1);
+        auto bl = pos.size_before(l);
+        if (l == r) {
+            pos.nth_sub(l, this_t{}, first - bl, last - bl, fn);
+        } else {
+            pos.nth_sub(l, for_each_chunk_right_visitor{}, first - bl, fn);
+            for (auto i = l + 1; i < r; ++i)
+                pos.nth_sub(i, for_each_chunk_visitor{}, fn);
+            pos.nth_sub(r, for_each_chunk_left_visitor{},
+                        last - pos.size_before(r), fn);
+        }
+    }
+
+    template <typename Pos, typename Fn>
+    friend void visit_leaf(this_t, Pos&& pos,
+                           size_t first, size_t last, Fn&& fn)
+    {
+        auto data = pos.node()->leaf();
+        fn(data + first, data + last);
+    }
+};
+
+// Like `for_each_chunk_i_visitor`, but stops as soon as `fn` returns
+// `false`, which is then returned.
+struct for_each_chunk_p_i_visitor
+{
+    using this_t = for_each_chunk_p_i_visitor;
+
+    template <typename Pos, typename Fn>
+    friend bool visit_inner(this_t, Pos&& pos,
+                            size_t first, size_t last, Fn&& fn)
+    {
+        assert(first < last);
+        auto l      = pos.subindex(first);
+        auto r      = pos.subindex(last - 1);
+        auto before = pos.size_before(l);
+        for (auto i = l; i <= r; ++i) {
+            auto size = pos.size_sbh(i, before);
+            auto f    = i == l ? first - before : 0;
+            auto e    = i == r ? last - before : size;
+            if (!pos.nth_sub(i, this_t{}, f, e, fn))
+                return false;
+            before += size;
+        }
+        return true;
+    }
+
+    template <typename Pos, typename Fn>
+    friend bool visit_leaf(this_t, Pos&& pos,
+                           size_t first, size_t last, Fn&& fn)
+    {
+        auto data = pos.node()->leaf();
+        return fn(data + first, data + last);
+    }
+};
+
+struct for_each_subtree_visitor
+{
+    using this_t = for_each_subtree_visitor;
+
+    template <typename Pos, typename Fn>
+    friend void visit_inner(this_t, Pos&& pos, size_t grain, Fn&& fn)
+    {
+        constexpr auto B = std::decay_t<Pos>::node_t::bits;
+        if ((std::uint64_t{1} << (pos.shift() + B)) <= grain)
+            fn(pos);
+        else
+            pos.each(this_t{}, grain, fn);
+    }
+
+    template <typename Pos, typename Fn>
+    friend void visit_leaf(this_t, Pos&& pos, size_t grain, Fn&& fn)
+    { fn(pos); }
+};
+
+// Folds the elements of a subtree into `digest`, like `hash_chunk_fn`.
+// When the memory policy enables it, the digest of the elements under
+// an inner node is cached in it, so the subtrees shared with a
+// container that was hashed before are not traversed again.
+template <typename Hash>
+struct hash_visitor
+{
+    using this_t = hash_visitor;
+    using fn_t   = hash_chunk_fn<Hash>;
+
+    template <typename Pos>
+    friend void visit_inner(this_t, Pos&& pos, std::size_t& digest)
+    {
+        using node_t = node_type<Pos>;
+        auto node = pos.node();
+        auto d    = node->digest();
+        if (d >= node_t::frozen_digest) {
+            d = 0;
+            pos.each(this_t{}, d);
+            node->cache_digest(d);
+        }
+        digest = digest * fn_t::power(subtree_size(pos, 0)) + d;
+    }
+
+    template <typename Pos>
+    friend void visit_leaf(this_t, Pos&& pos, std::size_t& digest)
+    {
+        auto data = pos.node()->leaf();
+        auto fn   = fn_t{digest};
+        fn(data, data + pos.count());
+        digest = fn.digest;
+    }
+};
+
+template <typename Iter>
+struct equals_chunk_fn
+{
+    Iter iter;
+    bool result;
+
+    template <typename T>
+    void operator() (const T* first, const T* last)
+    {
+        if (result) {
+            // the other iterator may be pointing to the very same
+            // leaf, in which case we do not need to look at it
+            if (first != &*iter)
+                result = std::equal(first, last, iter);
+            iter += last - first;
+        }
+    }
+};
+
+template <typename Iter>
+equals_chunk_fn<Iter> make_equals_chunk_fn(Iter iter)
+{
+    return { iter, true };
+}
+
+struct equals_visitor
+{
+    using this_t = equals_visitor;
+
+    // Compares, child by child, two inner nodes that are known to
+    // cover the same range of elements at the same level.  Children
+    // that are not aligned with a child on the other side are
+    // compared element-wise using the `first` iterator, that points
+    // to the first element of the other tree.
+    struct this_aux_t
+    {
+        template <typename PosR, typename PosL, typename Iter>
+        friend bool visit_inner(this_aux_t, PosR&& posr, PosL&& posl,
+                                Iter&& first, size_t idx)
+        {
+            auto nr = posr.node();
+            auto cl = posl.count();
+            auto cr = posr.count();
+            auto sbl = size_t{};
+            auto sbr = size_t{};
+            auto j   = count_t{};
+            for (auto i = count_t{}; i < cl; ++i) {
+                auto sl = posl.size_sbh(i, sbl);
+                while (j < cr && sbr < sbl)
+                    sbr += posr.size_sbh(j++, sbr);
+                if (j < cr && sbr == sbl && posr.size_sbh(j, sbr) == sl) {
+                    if (!posl.nth_sub(i, this_t{}, nr->inner() [j],
+                                      first, idx + sbl))
+                        return false;
+                } else {
+                    auto fn = make_equals_chunk_fn(first + (idx + sbl));
+                    posl.nth_sub(i, for_each_chunk_visitor{}, fn);
+                    if (!fn.result)
+                        return false;
+                }
+                sbl += sl;
+            }
+            return true;
+        }
+
+        template <typename PosR, typename PosL, typename Iter>
+        friend bool visit_leaf(this_aux_t, PosR&& posr, PosL&& posl,
+                               Iter&& first, size_t idx)
+        { IMMER_UNREACHABLE; }
+    };
+
+    template <typename PosL, typename NodeT, typename Iter>
+    friend bool visit_inner(this_t, PosL&& posl, NodeT* nr,
+                            Iter&& first, size_t idx)
+    {
+        return posl.node() == nr
+            || visit_maybe_relaxed_sub(nr, posl.shift(), posl.size(),
+                                       this_aux_t{}, posl, first, idx);
+    }
+
+    template <typename PosL, typename NodeT, typename Iter>
+    friend bool visit_leaf(this_t, PosL&& posl, NodeT* nr,
+                           Iter&& first, size_t idx)
+    {
+        auto nl = posl.node();
+        return nl == nr
+            || std::equal(nl->leaf(), nl->leaf() + posl.count(), nr->leaf());
+    }
+};
+
+// Computes the differences between two trees by lining up the
+// sequences of their subtrees, matching those that are the very same
+// node, as a sequence diff would do with equal elements.  The matched
+// subtrees are skipped even when they sit at different indices, so
+// edits that shift the elements that follow them, like inserting in
+// the middle of a relaxed tree, do not make the rest of the tree
+// differ.  Unmatched subtrees are opened one level at a time, the
+// tallest first, and matched again, until the only remaining
+// differences are between leaves, that are compared element by
+// element.  When one tree was derived from the other, the cost is thus
+// proportional to the nodes touched by the modifications.  Every item
+// keeps the index of its first element in its own tree, so that the
+// elements can be reported with their positions.
+template <typename NodeT,
+          typename InsertFn,
+          typename EraseFn,
+          typename ChangeFn>
+struct diff_fn
+{
+    using node_t  = NodeT;
+    using value_t = typename node_t::value_t;
+    static constexpr auto B  = node_t::bits;
+    static constexpr auto BL = node_t::bits_leaf;
+
+    struct item_t
+    {
+        node_t* node;
+        size_t  size;
+        shift_t shift;
+        bool    leaf;
+        size_t  index;
+
+        count_t height() const
+        { return leaf ? 0 : (shift - BL) / B + 1; }
+
+        bool operator< (const item_t& other) const
+        {
+            return std::less<node_t*>{}(node, other.node)
+                || (node == other.node && size < other.size);
+        }
+    };
+
+    using items_t = std::vector<item_t>;
+
+    InsertFn& on_insert;
+    EraseFn&  on_erase;
+    ChangeFn& on_change;
+
+    template <typename Tree>
+    void operator() (const Tree& a, const Tree& b)
+    {
+        auto xs = items(a);
+        auto ys = items(b);
+        diff(xs.data(), xs.data() + xs.size(),
+             ys.data(), ys.data() + ys.size());
+    }
+
+    template <typename Tree>
+    static items_t items(const Tree& t)
+    {
+        auto r = items_t{};
+        auto tail_off = t.tail_offset();
+        if (tail_off)
+            r.push_back({ t.root, tail_off, t.shift, false, 0 });
+        r.push_back({ t.tail, t.size - tail_off, 0, true, tail_off });
+        return r;
+    }
+
+    template <typename Fn>
+    static void each_sub(const item_t& x, Fn&& fn)
+    {
+        auto node  = x.node;
+        auto leaf  = x.shift == BL;
+        auto shift = leaf ? shift_t{} : x.shift - B;
+        if (auto r = node->relaxed()) {
+            auto sb = size_t{};
+            for (auto i = count_t{}; i < r->count; ++i) {
+                fn(item_t{ node->inner() [i], r->sizes[i] - sb, shift, leaf,
+                           x.index + sb });
+                sb = r->sizes[i];
+            }
+        } else {
+            auto full = size_t{1} << x.shift;
+            auto n    = static_cast<count_t>(((x.size - 1) >> x.shift) + 1);
+            for (auto i = count_t{}; i < n; ++i)
+                fn(item_t{ node->inner() [i],
+                           std::min(full, x.size - (size_t{i} << x.shift)),
+                           shift, leaf, x.index + (size_t{i} << x.shift) });
+        }
+    }
+
+    template <typename Fn>
+    static void each_element(const item_t& x, Fn& fn)
+    {
+        if (x.leaf) {
+            auto p = x.node->leaf();
+            for (auto i = size_t{}; i < x.size; ++i)
+                fn(x.index + i, p[i]);
+        } else
+            each_sub(x, [&] (const item_t& y) { each_element(y, fn); });
+    }
+
+    // Pairs of indices of the longest common subsequence of subtrees,
+    // found with the Hunt-Szymanski algorithm.
+    static std::vector<std::pair<std::size_t, std::size_t>>
+    match(const item_t* a, const item_t* ae, const item_t* b, const item_t* be)
+    {
+        struct link_t { std::size_t i, j, prev; };
+        auto npos  = ~std::size_t{};
+        auto order = std::vector<std::size_t>(ae - a);
+        std::iota(order.begin(), order.end(), std::size_t{});
+        std::stable_sort(order.begin(), order.end(),
+                         [&] (std::size_t x, std::size_t y) {
+                             return a[x] < a[y];
+                         });
+        auto links = std::vector<link_t>{};
+        auto tails = std::vector<std::size_t>{};
+        for (auto j = std::size_t{}; b + j != be; ++j) {
+            auto cands = std::equal_range(
+                order.begin(), order.end(), b[j],
+                [&] (const auto& x, const auto& y) {
+                    return at(a, x) < at(a, y);
+                });
+            for (auto it = cands.second; it != cands.first;) {
+                auto i = *--it;
+                auto k = std::lower_bound(
+                    tails.begin(), tails.end(), i,
+                    [&] (std::size_t l, std::size_t x) {
+                        return links[l].i < x;
+                    });
+                links.push_back({ i, j, k == tails.begin() ? npos : k[-1] });
+                if (k == tails.end())
+                    tails.push_back(links.size() - 1);
+                else
+                    *k = links.size() - 1;
+            }
+        }
+        auto r = std::vector<std::pair<std::size_t,
+                                       std::size_t>>(tails.size());
+        for (auto l = tails.empty() ? npos : tails.back(), k = r.size();
+             l != npos; l = links[l].prev)
+            r[--k] = { links[l].i, links[l].j };
+        return r;
+    }
+
+    // Matches are kept in runs that shift the elements by the same
+    // amount, and a run is only kept when it skips more elements than
+    // the shift it introduces, so that a few subtrees that happen to
+    // be shared between otherwise unrelated parts of the trees do not
+    // line up these parts with each other.
+    static std::vector<std::pair<std::size_t, std::size_t>>
+    anchors(const item_t* a, const item_t* ae,
+            const item_t* b, const item_t* be)
+    {
+        auto ms = match(a, ae, b, be);
+        auto pa = offsets(a, ae);
+        auto pb = offsets(b, be);
+        auto r  = decltype(ms){};
+        auto delta = [&] (std::pair<std::size_t, std::size_t> m) {
+            return static_cast<std::ptrdiff_t>(pb[m.second])
+                -  static_cast<std::ptrdiff_t>(pa[m.first]);
+        };
+        auto prev = std::ptrdiff_t{};
+        for (auto k = std::size_t{}, e = k; k < ms.size(); k = e) {
+            auto d = delta(ms[k]);
+            auto w = std::ptrdiff_t{};
+            for (e = k; e < ms.size() && delta(ms[e]) == d; ++e)
+                w += a[ms[e].first].size;
+            if (w >= (d > prev ? d - prev : prev - d)) {
+                r.insert(r.end(), ms.begin() + k, ms.begin() + e);
+                prev = d;
+            }
+        }
+        return r;
+    }
+
+    static std::vector<std::size_t> offsets(const item_t* a,
+                                            const item_t* ae)
+    {
+        auto r = std::vector<std::size_t>{};
+        auto o = std::size_t{};
+        for (; a != ae; o += a++->size)
+            r.push_back(o);
+        return r;
+    }
+
+    static bool same(const item_t& x, const item_t& y)
+    { return x.node == y.node && x.size == y.size; }
+
+    static const item_t& at(const item_t*, const item_t& x) { return x; }
+    static const item_t& at(const item_t* a, std::size_t i) { return a[i]; }
+
+    void diff(const item_t* a, const item_t* ae,
+              const item_t* b, const item_t* be)
+    {
+        // the common prefix and suffix are skipped first, so that
+        // subtrees that repeat in a tree are lined up with the
+        // occurrence at the same end of the other tree
+        for (; a != ae && b != be && same(*a, *b); ++a, ++b);
+        for (; a != ae && b != be && same(ae[-1], be[-1]); --ae, --be);
+        auto i = std::size_t{};
+        auto j = std::size_t{};
+        for (auto m : anchors(a, ae, b, be)) {
+            gap(a + i, a + m.first, b + j, b + m.second);
+            i = m.first + 1;
+            j = m.second + 1;
+        }
+        gap(a + i, ae, b + j, be);
+    }
+
+    void gap(const item_t* a, const item_t* ae,
+             const item_t* b, const item_t* be)
+    {
+        if (a == ae) {
+            for (; b != be; ++b)
+                each_element(*b, on_insert);
+        } else if (b == be) {
+            for (; a != ae; ++a)
+                each_element(*a, on_erase);
+        } else {
+            auto h = count_t{};
+            for (auto x = a; x != ae; ++x) h = std::max(h, x->height());
+            for (auto y = b; y != be; ++y) h = std::max(h, y->height());
+            if (h == 0)
+                leaves(a, ae, b, be);
+            else {
+                auto xs = open(a, ae, h);
+                auto ys = open(b, be, h);
+                diff(xs.data(), xs.data() + xs.size(),
+                     ys.data(), ys.data() + ys.size());
+            }
+        }
+    }
+
+    static items_t open(const item_t* a, const item_t* ae, count_t h)
+    {
+        auto r = items_t{};
+        for (; a != ae; ++a) {
+            if (a->height() == h)
+                each_sub(*a, [&] (const item_t& x) { r.push_back(x); });
+            else
+                r.push_back(*a);
+        }
+        return r;
+    }
+
+    // Elements of the unmatched leaves are compared position by
+    // position, after skipping their common prefix and suffix.  The
+    // leaves of each side are contiguous, so the index of an element is
+    // its offset from the first one.
+    void leaves(const item_t* a, const item_t* ae,
+                const item_t* b, const item_t* be)
+    {
+        auto xs = elements(a, ae);
+        auto ys = elements(b, be);
+        auto m  = std::min(xs.size(), ys.size());
+        auto p  = size_t{};
+        while (p < m && *xs[p] == *ys[p])
+            ++p;
+        auto s = size_t{};
+        while (s < m - p && *xs[xs.size() - 1 - s] == *ys[ys.size() - 1 - s])
+            ++s;
+        for (auto k = p; k < m - s; ++k)
+            if (!(*xs[k] == *ys[k]))
+                on_change(b->index + k, *xs[k], *ys[k]);
+        for (auto k = m - s; k < xs.size() - s; ++k)
+            on_erase(a->index + k, *xs[k]);
+        for (auto k = m - s; k < ys.size() - s; ++k)
+            on_insert(b->index + k, *ys[k]);
+    }
+
+    static std::vector<const value_t*> elements(const item_t* a,
+                                                const item_t* ae)
+    {
+        auto r = std::vector<const value_t*>{};
+        for (; a != ae; ++a) {
+            auto p = a->node->leaf();
+            for (auto e = p + a->size; p != e; ++p)
+                r.push_back(p);
+        }
+        return r;
+    }
+};
+
+template <typename Tree,
+          typename InsertFn,
+          typename EraseFn,
+          typename ChangeFn>
+void diff(const Tree& a, const Tree& b,
+          InsertFn& on_insert, EraseFn& on_erase, ChangeFn& on_change)
+{
+    using node_t = typename Tree::node_t;
+    diff_fn<node_t, InsertFn, EraseFn, ChangeFn>{
+        on_insert, on_erase, on_change }(a, b);
+}
+
 template <typename NodeT>
 struct update_visitor
 {
@@ -234,6 +792,7 @@ struct get_mut_visitor
         auto count   = pos.count();
         auto node    = pos.node();
         if (node->can_mutate(e)) {
+            node->forget_digest();
             return pos.towards_oh(this_t{}, idx, offset,
                                   e, &node->inner()[offset]);
         } else {
@@ -260,6 +819,7 @@ struct get_mut_visitor
         auto count   = pos.count();
         auto node    = pos.node();
         if (node->can_mutate(e)) {
+            node->forget_digest();
             return pos.towards_oh_ch(this_t{}, idx, offset, count,
                                      e, &node->inner()[offset]);
         } else {
@@ -315,7 +875,8 @@ struct push_tail_mut_visitor
         auto new_idx     = children == size_t{1} << level || level == BL
             ? idx + 1 : idx;
         auto new_child   = (node_t*){};
-        auto mutate      = Mutating && node->can_mutate(e);
+        auto mutate      = Mutating && node->can_grow(e);
+        if (mutate) node->forget_digest();
 
         if (new_idx >= branches<B>)
             return nullptr;
@@ -368,7 +929,8 @@ struct push_tail_mut_visitor
         auto node        = pos.node();
         auto idx         = pos.index(pos.size() - 1);
         auto new_idx     = pos.index(pos.size() + branches<BL> - 1);
-        auto mutate      = Mutating && node->can_mutate(e);
+        auto mutate      = Mutating && node->can_grow(e);
+        if (mutate) node->forget_digest();
         if (mutate) {
             node->inner()[new_idx] =
                 idx == new_idx  ? pos.last_oh(this_t{}, idx, e, tail)
@@ -522,6 +1084,7 @@ struct slice_right_mut_visitor
         auto idx = pos.index(last);
         auto node = pos.node();
         auto mutate = Mutating && node->can_mutate(e);
+        if (mutate) node->forget_digest();
         if (Collapse && idx == 0) {
             auto res = mutate
                 ? pos.towards_oh(this_t{}, last, idx, e)
@@ -559,6 +1122,7 @@ struct slice_right_mut_visitor
                     return { pos.shift(), nullptr, ts, tail };
                 } else if (Collapse && idx == 1 && pos.shift() > BL) {
                     auto newn = pos.node()->inner()[0];
+                    if (!mutate) newn->inc();
                     if (Mutating) pos.visit(dec_right_visitor{}, count_t{2});
                     return { pos.shift() - B, newn, ts, tail };
                 } else {
@@ -590,6 +1154,7 @@ struct slice_right_mut_visitor
         auto idx = pos.index(last);
         auto node = pos.node();
         auto mutate = Mutating && node->can_mutate(e);
+        if (mutate) node->forget_digest();
         if (Collapse && idx == 0) {
             auto res = mutate
                 ? pos.towards_oh(this_t{}, last, idx, e)
@@ -621,6 +1186,7 @@ struct slice_right_mut_visitor
                     return { pos.shift(), nullptr, ts, tail };
                 } else if (Collapse && idx == 1 && pos.shift() > BL) {
                     auto newn = pos.node()->inner()[0];
+                    if (!mutate) newn->inc();
                     if (Mutating) pos.visit(dec_right_visitor{}, count_t{2});
                     return { pos.shift() - B, newn, ts, tail };
                 } else {
@@ -824,6 +1390,7 @@ struct slice_left_mut_visitor
         auto count  = pos.count();
         auto node   = pos.node();
         auto mutate = Mutating && node->can_mutate(e);
+        if (mutate) node->forget_digest();
         auto left_size  = pos.size_before(idx);
         auto child_size = pos.size_sbh(idx, left_size);
         auto dropped_size = first;
@@ -879,6 +1446,7 @@ struct slice_left_mut_visitor
             // in place
             && !node_t::embed_relaxed
             && node->can_mutate(e);
+        if (mutate) node->forget_digest();
         auto left_size  = pos.size_before(idx);
         auto child_size = pos.size_sbh(idx, left_size);
         auto dropped_size = first;
@@ -1015,6 +1583,515 @@ struct slice_left_visitor
     };
 };
 
+// The new subtrees that take the place of a node that was changed by
+// `insert_visitor` or `erase_visitor`.  There is a `right` one only when
+// the node had to be split.
+template <typename NodeT>
+struct splice_result
+{
+    NodeT* left;
+    size_t left_size;
+    NodeT* right;
+    size_t right_size;
+};
+
+// Gathers the children of a node that is being rebuilt by
+// `insert_visitor` or `erase_visitor`.  Children are either taken from
+// the old node, and thus shared, or fresh, and thus owned by the
+// builder until they are put in the new nodes.
+template <typename NodeT>
+struct splice_builder
+{
+    using node_t   = NodeT;
+    using result_t = splice_result<NodeT>;
+
+    static constexpr auto B  = NodeT::bits;
+    static constexpr auto BL = NodeT::bits_leaf;
+
+    shift_t shift;
+    count_t count = 0;
+    node_t* nodes[branches<B> + 1];
+    size_t  sizes[branches<B> + 1];
+    bool    fresh[branches<B> + 1];
+
+    splice_builder(shift_t s) : shift{s} {}
+
+    template <typename Pos>
+    void copy(Pos&& pos, count_t first, count_t last)
+    {
+        auto sb = pos.size_before(first);
+        for (auto i = first; i < last; ++i) {
+            auto s = pos.size_sbh(i, sb);
+            add(pos.node()->inner() [i], s, false);
+            sb += s;
+        }
+    }
+
+    void add(node_t* n, size_t s, bool f)
+    {
+        assert(count <= branches<B>);
+        nodes[count] = n;
+        sizes[count] = s;
+        fresh[count] = f;
+        ++count;
+    }
+
+    void add(const result_t& r)
+    {
+        add(r.left, r.left_size, true);
+        if (r.right)
+            add(r.right, r.right_size, true);
+    }
+
+    // Merges every fresh child with one of its neighbours when both fit
+    // in a single node, so that erasing does not leave behind a trail
+    // of tiny nodes.
+    void merge()
+    {
+        for (auto i = count_t{}; i < count; ++i) {
+            if (fresh[i]) {
+                if (i + 1 < count && fits(i))
+                    merge(i);
+                else if (i > 0 && fits(i - 1))
+                    merge(--i);
+            }
+        }
+    }
+
+    bool fits(count_t i) const
+    {
+        return shift == BL
+            ? sizes[i] + sizes[i + 1] <= branches<BL>
+            : sub_count(i) + sub_count(i + 1) <= branches<B>;
+    }
+
+    count_t sub_count(count_t i) const
+    {
+        auto r = nodes[i]->relaxed();
+        return r ? r->count
+            : static_cast<count_t>(((sizes[i] - 1) >> (shift - B)) + 1);
+    }
+
+    void merge(count_t i)
+    {
+        auto n = shift == BL
+            ? node_t::copy_leaf(nodes[i], sizes[i],
+                                nodes[i + 1], sizes[i + 1])
+            : merge_inner(i);
+        release(i);
+        release(i + 1);
+        nodes[i] = n;
+        sizes[i] += sizes[i + 1];
+        fresh[i] = true;
+        --count;
+        for (auto j = i + 1; j < count; ++j) {
+            nodes[j] = nodes[j + 1];
+            sizes[j] = sizes[j + 1];
+            fresh[j] = fresh[j + 1];
+        }
+    }
+
+    node_t* merge_inner(count_t i)
+    {
+        auto ss = shift - B;
+        auto ca = sub_count(i);
+        auto cb = sub_count(i + 1);
+        auto n  = node_t::make_inner_r_n(ca + cb);
+        auto r  = n->relaxed();
+        auto sb = size_t{};
+        auto k  = count_t{};
+        for (auto j : { i, count_t(i + 1) }) {
+            auto m  = nodes[j];
+            auto mr = m->relaxed();
+            auto mc = sub_count(j);
+            for (auto c = count_t{}; c < mc; ++c, ++k) {
+                n->inner() [k] = m->inner() [c]->inc();
+                r->sizes[k] = sb + (mr ? mr->sizes[c]
+                                    : std::min(size_t{c + 1u} << ss,
+                                               sizes[j]));
+            }
+            sb += sizes[j];
+        }
+        r->count = k;
+        return n;
+    }
+
+    void release(count_t i)
+    {
+        if (fresh[i]) {
+            if (shift == BL)
+                dec_leaf(nodes[i], sizes[i]);
+            else
+                dec_relaxed(nodes[i], shift - B);
+        }
+    }
+
+    void release()
+    {
+        for (auto i = count_t{}; i < count; ++i)
+            release(i);
+    }
+
+    // Builds the new relaxed node, or two of them when the children do
+    // not fit in one.
+    result_t finish()
+    {
+        return finish_([] (count_t n) { return node_t::make_inner_r_n(n); });
+    }
+
+    // Like the above, but the new nodes are owned by `e`.
+    template <typename Edit>
+    result_t finish(Edit e)
+    {
+        return finish_([e] (count_t) { return node_t::make_inner_r_e(e); });
+    }
+
+    template <typename Make>
+    result_t finish_(Make make)
+    {
+        auto n = count <= branches<B> ? count : (count + 1) / 2;
+        auto l = make(n);
+        auto r = (node_t*){};
+        if (n < count) {
+            try {
+                r = make(count - n);
+            } catch (...) {
+                node_t::delete_inner_r(l);
+                throw;
+            }
+        }
+        auto ls = fill(l, 0, n);
+        auto rs = r ? fill(r, n, count) : size_t{};
+        return { l, ls, r, rs };
+    }
+
+    size_t fill(node_t* p, count_t first, count_t last)
+    {
+        auto r  = p->relaxed();
+        auto sb = size_t{};
+        for (auto i = first; i < last; ++i) {
+            p->inner() [i - first] = fresh[i] ? nodes[i] : nodes[i]->inc();
+            r->sizes[i - first] = sb += sizes[i];
+        }
+        r->count = last - first;
+        return sb;
+    }
+};
+
+// Inserts an element before the `idx`-th one of the subtree, copying
+// the path to the leaf that contains it.  The nodes in the path become
+// relaxed, and when they overflow they are split in two.
+template <typename NodeT>
+struct insert_visitor
+{
+    using node_t   = NodeT;
+    using this_t   = insert_visitor;
+    using result_t = splice_result<NodeT>;
+
+    static constexpr auto BL = NodeT::bits_leaf;
+
+    template <typename PosT, typename U>
+    friend result_t visit_inner(this_t, PosT&& pos, size_t idx, U& value)
+    {
+        auto offset = pos.index(idx);
+        auto sb     = pos.size_before(offset);
+        auto sub    = pos.nth_sub(offset, this_t{}, idx - sb, value);
+        auto b      = splice_builder<node_t>{ pos.shift() };
+        b.copy(pos, 0, offset);
+        b.add(sub);
+        b.copy(pos, offset + 1, pos.count());
+        try {
+            return b.finish();
+        } catch (...) {
+            b.release();
+            throw;
+        }
+    }
+
+    template <typename PosT, typename U>
+    friend result_t visit_leaf(this_t, PosT&& pos, size_t idx, U& value)
+    {
+        auto node   = pos.node();
+        auto count  = pos.count();
+        auto offset = pos.index(idx);
+        if (count < branches<BL>) {
+            auto l = node_t::copy_leaf_insert(node, count, offset,
+                                              std::move(value));
+            return { l, count + 1u, nullptr, 0 };
+        } else {
+            auto ls = (count + 1) / 2;
+            auto rs = count + 1 - ls;
+            if (offset < ls) {
+                auto l = node_t::copy_leaf_insert(node, 0, ls - 1, offset,
+                                                  std::move(value));
+                try {
+                    auto r = node_t::copy_leaf(node, ls - 1, count);
+                    return { l, ls, r, rs };
+                } catch (...) {
+                    node_t::delete_leaf(l, ls);
+                    throw;
+                }
+            } else {
+                auto l = node_t::copy_leaf(node, ls);
+                try {
+                    auto r = node_t::copy_leaf_insert(node, ls, count, offset,
+                                                      std::move(value));
+                    return { l, ls, r, rs };
+                } catch (...) {
+                    node_t::delete_leaf(l, ls);
+                    throw;
+                }
+            }
+        }
+    }
+};
+
+// Erases the elements in `[first, last)` of the subtree, that must not
+// cover it all, copying the paths to the leaves at both ends of the
+// range.  The children in between are dropped, and the new children
+// are merged with their neighbours when possible.
+template <typename NodeT>
+struct erase_visitor
+{
+    using node_t   = NodeT;
+    using this_t   = erase_visitor;
+    using result_t = splice_result<NodeT>;
+
+    template <typename PosT>
+    friend result_t visit_inner(this_t, PosT&& pos, size_t first, size_t last)
+    {
+        auto count = pos.count();
+        auto of    = pos.index(first);
+        auto ol    = pos.index(last - 1);
+        auto b     = splice_builder<node_t>{ pos.shift() };
+        b.copy(pos, 0, of);
+        try {
+            for (auto o = of; o <= ol; o = o == ol ? ol + 1 : ol) {
+                auto sb = pos.size_before(o);
+                auto s  = pos.size_sbh(o, sb);
+                auto f  = std::max(first, sb) - sb;
+                auto l  = std::min(last, sb + s) - sb;
+                if (f > 0 || l < s)
+                    b.add(pos.nth_sub(o, this_t{}, f, l));
+            }
+            b.copy(pos, ol + 1, count);
+            b.merge();
+            return b.finish();
+        } catch (...) {
+            b.release();
+            throw;
+        }
+    }
+
+    template <typename PosT>
+    friend result_t visit_leaf(this_t, PosT&& pos, size_t first, size_t last)
+    {
+        auto count = pos.count();
+        auto n = node_t::copy_leaf_erase(pos.node(), count, first, last);
+        return { n, count - (last - first), nullptr, 0 };
+    }
+};
+
+// Like `insert_visitor`, but for transients.  Relaxed nodes that can
+// be mutated and have room for one more child are changed in place,
+// after the child, so nothing can fail once the tree is changed.  The
+// others are copied into nodes owned by `e`, so the following
+// operations find them mutable.  When `Mutating`, the reference to the
+// visited node is given up, and it is released when it is replaced.
+template <typename NodeT, bool Mutating = true>
+struct insert_mut_visitor
+{
+    using node_t        = NodeT;
+    using this_t        = insert_mut_visitor;
+    using this_no_mut_t = insert_mut_visitor<NodeT, false>;
+    using edit_t        = typename NodeT::edit_t;
+    using result_t      = splice_result<NodeT>;
+
+    static constexpr auto B  = NodeT::bits;
+    static constexpr auto BL = NodeT::bits_leaf;
+
+    static bool in_place(node_t* node, edit_t e)
+    {
+        auto r = node->relaxed();
+        return Mutating && r && r->count < branches<B> && node->can_grow(e);
+    }
+
+    template <typename PosT, typename U>
+    friend result_t visit_inner(this_t, PosT&& pos, edit_t e,
+                                size_t idx, U& value)
+    {
+        auto node   = pos.node();
+        auto count  = pos.count();
+        auto offset = pos.index(idx);
+        auto sb     = pos.size_before(offset);
+        if (in_place(node, e)) {
+            auto size = pos.size();
+            auto r    = node->ensure_mutable_relaxed_n(e, count);
+            auto sub  = pos.nth_sub(offset, this_t{}, e, idx - sb, value);
+            auto nodes = node->inner();
+            auto first = offset;
+            node->forget_digest();
+            nodes[offset] = sub.left;
+            if (sub.right) {
+                std::copy_backward(nodes + offset + 1, nodes + count,
+                                   nodes + count + 1);
+                std::copy_backward(r->sizes + offset + 1, r->sizes + count,
+                                   r->sizes + count + 1);
+                nodes[offset + 1]    = sub.right;
+                r->sizes[offset + 1] = r->sizes[offset];
+                r->sizes[offset]     = sb + sub.left_size;
+                r->count = ++count;
+                ++first;
+            }
+            for (auto i = first; i < count; ++i)
+                ++r->sizes[i];
+            return { node, size + 1, nullptr, 0 };
+        } else {
+            auto sub = pos.nth_sub(offset, this_no_mut_t{}, e, idx - sb, value);
+            auto b   = splice_builder<node_t>{ pos.shift() };
+            b.copy(pos, 0, offset);
+            b.add(sub);
+            b.copy(pos, offset + 1, count);
+            try {
+                auto res = b.finish(e);
+                if (Mutating) pos.visit(dec_visitor{});
+                return res;
+            } catch (...) {
+                b.release();
+                throw;
+            }
+        }
+    }
+
+    template <typename PosT, typename U>
+    friend result_t visit_leaf(this_t, PosT&& pos, edit_t e,
+                               size_t idx, U& value)
+    {
+        auto node   = pos.node();
+        auto count  = pos.count();
+        auto offset = pos.index(idx);
+        auto res    = result_t{};
+        if (Mutating && count < branches<BL> && node->can_grow(e)) {
+            auto data = node->leaf();
+            new (data + count) typename node_t::value_t{std::move(value)};
+            std::rotate(data + offset, data + count, data + count + 1);
+            return { node, count + 1u, nullptr, 0 };
+        } else if (count < branches<BL>) {
+            auto l = node_t::copy_leaf_insert_e(e, node, 0, count, offset,
+                                                std::move(value));
+            res = { l, count + 1u, nullptr, 0 };
+        } else {
+            auto ls = (count + 1) / 2;
+            auto rs = count + 1 - ls;
+            auto l  = offset < ls
+                ? node_t::copy_leaf_insert_e(e, node, 0, ls - 1, offset,
+                                             std::move(value))
+                : node_t::copy_leaf_e(e, node, 0, ls);
+            try {
+                auto r = offset < ls
+                    ? node_t::copy_leaf_e(e, node, ls - 1, count)
+                    : node_t::copy_leaf_insert_e(e, node, ls, count, offset,
+                                                 std::move(value));
+                res = { l, ls, r, rs };
+            } catch (...) {
+                node_t::delete_leaf(l, ls);
+                throw;
+            }
+        }
+        if (Mutating) pos.visit(dec_visitor{});
+        return res;
+    }
+};
+
+// Like `erase_visitor`, but for transients, in the same way as
+// `insert_mut_visitor`.  Nodes are only changed in place when the
+// erased range falls within one of their children, and the children
+// that are changed in place are not merged with their neighbours.
+template <typename NodeT, bool Mutating = true>
+struct erase_mut_visitor
+{
+    using node_t        = NodeT;
+    using this_t        = erase_mut_visitor;
+    using this_no_mut_t = erase_mut_visitor<NodeT, false>;
+    using edit_t        = typename NodeT::edit_t;
+    using result_t      = splice_result<NodeT>;
+
+    template <typename PosT>
+    friend result_t visit_inner(this_t, PosT&& pos, edit_t e,
+                                size_t first, size_t last)
+    {
+        auto node  = pos.node();
+        auto count = pos.count();
+        auto of    = pos.index(first);
+        auto ol    = pos.index(last - 1);
+        if (Mutating && of == ol && node->relaxed() && node->can_mutate(e)) {
+            auto size  = pos.size();
+            auto sb    = pos.size_before(of);
+            auto s     = pos.size_sbh(of, sb);
+            auto n     = last - first;
+            auto r     = node->ensure_mutable_relaxed_n(e, count);
+            auto nodes = node->inner();
+            if (first > sb || last < sb + s) {
+                auto sub = pos.nth_sub(of, this_t{}, e, first - sb, last - sb);
+                assert(!sub.right);
+                node->forget_digest();
+                nodes[of] = sub.left;
+                for (auto i = of; i < count; ++i)
+                    r->sizes[i] -= n;
+            } else {
+                pos.nth_sub(of, dec_visitor{});
+                node->forget_digest();
+                for (auto i = of; i + 1 < count; ++i) {
+                    nodes[i]    = nodes[i + 1];
+                    r->sizes[i] = r->sizes[i + 1] - n;
+                }
+                r->count = count - 1;
+            }
+            return { node, size - n, nullptr, 0 };
+        } else {
+            auto b = splice_builder<node_t>{ pos.shift() };
+            b.copy(pos, 0, of);
+            try {
+                for (auto o = of; o <= ol; o = o == ol ? ol + 1 : ol) {
+                    auto sb = pos.size_before(o);
+                    auto s  = pos.size_sbh(o, sb);
+                    auto f  = std::max(first, sb) - sb;
+                    auto l  = std::min(last, sb + s) - sb;
+                    if (f > 0 || l < s)
+                        b.add(pos.nth_sub(o, this_no_mut_t{}, e, f, l));
+                }
+                b.copy(pos, ol + 1, count);
+                b.merge();
+                auto res = b.finish(e);
+                if (Mutating) pos.visit(dec_visitor{});
+                return res;
+            } catch (...) {
+                b.release();
+                throw;
+            }
+        }
+    }
+
+    template <typename PosT>
+    friend result_t visit_leaf(this_t, PosT&& pos, edit_t e,
+                               size_t first, size_t last)
+    {
+        auto node  = pos.node();
+        auto count = pos.count();
+        auto n     = last - first;
+        if (Mutating && node->can_mutate(e)) {
+            auto data = node->leaf();
+            std::move(data + last, data + count, data + first);
+            destroy_n(data + count - n, n);
+            return { node, count - n, nullptr, 0 };
+        } else {
+            auto l = node_t::copy_leaf_erase_e(e, node, count, first, last);
+            if (Mutating) pos.visit(dec_visitor{});
+            return { l, count - n, nullptr, 0 };
+        }
+    }
+};
+
 template <typename Node>
 struct concat_center_pos
 {
@@ -1480,6 +2557,103 @@ concat_trees(Node* ltail, count_t ltcount,
         .realize();
 }
 
+/*!
+ * Builds a regular tree with the elements in `[first, last)`.  Leaves
+ * are filled directly from the input and inner nodes are assembled
+ * bottom-up, keeping only the rightmost node of every level under
+ * construction.  Returns the size, shift, root and tail of the tree,
+ * where the root is null when all elements fit in the tail.
+ */
+template <typename Node, typename Iter>
+std::tuple<size_t, shift_t, Node*, Node*>
+build_regular_tree(Iter first, Iter last)
+{
+    using node_t = Node;
+    constexpr auto B  = node_t::bits;
+    constexpr auto BL = node_t::bits_leaf;
+    constexpr auto max_levels = (sizeof(size_t) * 8 + B - 1) / B + 1;
+
+    node_t* nodes[max_levels]  = {};
+    count_t counts[max_levels] = {};
+    node_t* tail   = nullptr;
+    count_t tail_n = 0;
+    size_t  size   = 0;
+
+    auto level_shift = [] (std::size_t l) -> shift_t { return BL + l * B; };
+
+    auto release = [&] (node_t* child, std::size_t l, size_t child_size) {
+        if (l == 0)
+            node_t::delete_leaf(child, branches<BL>);
+        else
+            dec_regular(child, level_shift(l - 1), child_size);
+    };
+
+    // Adds `child` as the last child of the node under construction at
+    // level `l`.  Full nodes are only moved up when they overflow, so
+    // the tree ends up with minimal height.
+    auto push = [&] (node_t* child, std::size_t l, size_t child_size) {
+        for (;; ++l) {
+            assert(l < max_levels);
+            if (nodes[l] && counts[l] < branches<B>) {
+                nodes[l]->inner()[counts[l]++] = child;
+                return;
+            }
+            auto node = (node_t*) nullptr;
+            try {
+                node = node_t::make_inner_n(branches<B>);
+            } catch (...) {
+                release(child, l, child_size);
+                throw;
+            }
+            node->inner()[0] = child;
+            child      = nodes[l];
+            child_size = size_t{counts[l]} << level_shift(l);
+            nodes[l]   = node;
+            counts[l]  = 1;
+            if (!child)
+                return;
+        }
+    };
+
+    try {
+        while (first != last) {
+            if (tail) {
+                auto full = tail;
+                tail = nullptr;
+                push(full, 0, branches<BL>);
+            }
+            tail   = node_t::make_leaf_n(branches<BL>);
+            tail_n = 0;
+            tail_n = static_cast<count_t>(
+                uninitialized_copy_upto(first, last, tail->leaf(),
+                                        branches<BL>));
+            size  += tail_n;
+        }
+        for (auto l = std::size_t{}; l < max_levels; ++l) {
+            if (nodes[l]) {
+                auto higher = std::any_of(nodes + l + 1, nodes + max_levels,
+                                          [] (auto p) { return p != nullptr; });
+                if (!higher)
+                    return std::make_tuple(size, level_shift(l), nodes[l], tail);
+                auto child      = nodes[l];
+                auto child_size = size_t{counts[l]} << level_shift(l);
+                nodes[l]  = nullptr;
+                counts[l] = 0;
+                push(child, l + 1, child_size);
+            }
+        }
+        return std::make_tuple(size, shift_t{BL}, (node_t*) nullptr, tail);
+    } catch (...) {
+        for (auto l = std::size_t{}; l < max_levels; ++l)
+            if (nodes[l])
+                dec_regular(nodes[l], level_shift(l),
+                            size_t{counts[l]} << level_shift(l));
+        if (tail)
+            node_t::delete_leaf(tail, tail_n);
+        throw;
+    }
+}
+
 } // namespace rbts
 } // namespace detail
 } // namespace immer
@@ -40,6 +40,16 @@ constexpr auto bits_leaf = std::decay_t<Pos>::node_t::bits_leaf;
 template <typename Pos>
 using node_type = typename std::decay<Pos>::type::node_t;
 
+// positions that track the size of the whole tree tell the size of
+// their own subtree with `this_size()`
+template <typename Pos>
+auto subtree_size(const Pos& p, int) -> decltype(p.this_size())
+{ return p.this_size(); }
+
+template <typename Pos>
+size_t subtree_size(const Pos& p, long)
+{ return p.size(); }
+
 template <typename NodeT>
 struct empty_regular_pos
 {
@@ -656,6 +666,23 @@ struct regular_sub_pos
             : make_leaf_sub_pos(child, size_).visit(v, args...);
     }
 
+    template <typename Visitor, typename... Args>
+    decltype(auto) nth_sub(count_t offset, Visitor v, Args&&... args)
+    {
+        assert(offset < count());
+        auto is_leaf = shift_ == BL;
+        auto child   = node_->inner() [offset];
+        auto lsize   = size_ - (offset << shift_);
+        auto is_full = lsize >= (size_t{1} << shift_);
+        return is_full
+            ? (is_leaf
+               ? make_full_leaf_pos(child).visit(v, args...)
+               : make_full_pos(child, shift_ - B).visit(v, args...))
+            : (is_leaf
+               ? make_leaf_sub_pos(child, lsize).visit(v, args...)
+               : make_regular_sub_pos(child, shift_ - B, lsize).visit(v, args...));
+    }
+
     template <typename Visitor, typename ...Args>
     decltype(auto) visit(Visitor v, Args&& ...args)
     {
@@ -896,6 +923,17 @@ struct full_pos
         return make_full_leaf_pos(child).visit(v, args...);
     }
 
+    template <typename Visitor, typename... Args>
+    decltype(auto) nth_sub(count_t offset, Visitor v, Args&&... args)
+    {
+        assert(offset < count());
+        auto is_leaf = shift_ == BL;
+        auto child   = node_->inner() [offset];
+        return is_leaf
+            ? make_full_leaf_pos(child).visit(v, args...)
+            : make_full_pos(child, shift_ - B).visit(v, args...);
+    }
+
     template <typename Visitor, typename ...Args>
     decltype(auto) visit(Visitor v, Args&& ...args)
     {
@@ -1125,6 +1163,18 @@ struct relaxed_pos
         return make_leaf_sub_pos(child, child_size).visit(v, args...);
     }
 
+    template <typename Visitor, typename... Args>
+    decltype(auto) nth_sub(count_t offset, Visitor v, Args&&... args)
+    {
+        assert(offset < count());
+        auto child      = node_->inner() [offset];
+        auto child_size = size(offset);
+        auto is_leaf    = shift_ == BL;
+        return is_leaf
+            ? make_leaf_sub_pos(child, child_size).visit(v, args...)
+            : visit_maybe_relaxed_sub(child, shift_ - B, child_size, v, args...);
+    }
+
     template <typename Visitor, typename ...Args>
     decltype(auto) visit(Visitor v, Args&& ...args)
     {
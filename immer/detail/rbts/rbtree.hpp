@@ -32,6 +32,12 @@ namespace immer {
 namespace detail {
 namespace rbts {
 
+template <typename T,
+          typename MemoryPolicy,
+          bits_t B,
+          bits_t BL>
+struct rbtree_iterator;
+
 template <typename T,
           typename MemoryPolicy,
           bits_t B,
@@ -54,6 +60,19 @@ struct rbtree
         assert(check_tree());
     }
 
+    template <typename Iter>
+    static rbtree from_range(Iter first, Iter last)
+    {
+        using std::get;
+        auto r = build_regular_tree<node_t>(first, last);
+        if (!get<3>(r))
+            return empty;
+        else if (!get<2>(r))
+            return { get<0>(r), get<1>(r), empty.root->inc(), get<3>(r) };
+        else
+            return { get<0>(r), get<1>(r), get<2>(r), get<3>(r) };
+    }
+
     rbtree(const rbtree& other)
         : rbtree{other.size, other.shift, other.root, other.tail}
     {
@@ -141,6 +160,105 @@ struct rbtree
         traverse(for_each_chunk_visitor{}, std::forward<Fn>(fn));
     }
 
+    template <typename Hash>
+    std::size_t hash() const
+    {
+        auto digest = hash_chunk_fn<Hash>{}.digest;
+        traverse(hash_visitor<Hash>{}, digest);
+        return digest;
+    }
+
+    // Calls `fn` on the chunks of the elements in `[first, last)`,
+    // touching only the leaves that overlap the range.
+    template <typename Fn>
+    void for_each_chunk(size_t first, size_t last, Fn&& fn) const
+    {
+        assert(first <= last);
+        assert(last <= size);
+        auto tail_off = tail_offset();
+        if (first < std::min(last, tail_off))
+            make_regular_sub_pos(root, shift, tail_off)
+                .visit(for_each_chunk_i_visitor{},
+                       first, std::min(last, tail_off), fn);
+        if (last > std::max(first, tail_off)) {
+            auto data = tail->leaf();
+            fn(data + (std::max(first, tail_off) - tail_off),
+               data + (last - tail_off));
+        }
+    }
+
+    // Like `for_each_chunk`, but stops as soon as `fn` returns false.
+    // Returns whether all the chunks were visited.
+    template <typename Fn>
+    bool for_each_chunk_p(Fn&& fn) const
+    {
+        return for_each_chunk_p(0, size, std::forward<Fn>(fn));
+    }
+
+    template <typename Fn>
+    bool for_each_chunk_p(size_t first, size_t last, Fn&& fn) const
+    {
+        assert(first <= last);
+        assert(last <= size);
+        auto tail_off = tail_offset();
+        if (first < std::min(last, tail_off) &&
+            !make_regular_sub_pos(root, shift, tail_off)
+                .visit(for_each_chunk_p_i_visitor{},
+                       first, std::min(last, tail_off), fn))
+            return false;
+        if (last > std::max(first, tail_off)) {
+            auto data = tail->leaf();
+            return fn(data + (std::max(first, tail_off) - tail_off),
+                      data + (last - tail_off));
+        }
+        return true;
+    }
+
+    // Calls `fn(pos)`, in order, for a sequence of positions that
+    // together cover the whole tree.  Inner positions cover at most
+    // `grain` elements, but leaves are never split.
+    template <typename Fn>
+    void for_each_subtree(size_t grain, Fn&& fn) const
+    {
+        auto v        = for_each_subtree_visitor{};
+        auto tail_off = tail_offset();
+        auto tail_n   = size - tail_off;
+        if (tail_off)
+            make_regular_sub_pos(root, shift, tail_off)
+                .visit(v, grain, fn);
+        if (tail_n)
+            make_leaf_sub_pos(tail, tail_n).visit(v, grain, fn);
+    }
+
+    bool equals(const rbtree& other) const
+    {
+        using iter_t = rbtree_iterator<T, MemoryPolicy, B, BL>;
+        if (size != other.size)
+            return false;
+        else if (root == other.root && tail == other.tail)
+            return true;
+        else if (shift != other.shift) {
+            auto fn = make_equals_chunk_fn(iter_t{other});
+            for_each_chunk(fn);
+            return fn.result;
+        } else {
+            auto tail_off = tail_offset();
+            auto v = equals_visitor{};
+            return (tail_off == 0
+                    || make_regular_sub_pos(root, shift, tail_off)
+                           .visit(v, other.root, iter_t{other}, size_t{}))
+                && make_leaf_sub_pos(tail, size - tail_off)
+                       .visit(v, other.tail, iter_t{other}, tail_off);
+        }
+    }
+
+    template <typename InsertFn, typename EraseFn, typename ChangeFn>
+    void diff(const rbtree& other, InsertFn&& on_insert,
+              EraseFn&& on_erase, ChangeFn&& on_change) const
+    {
+        rbts::diff(*this, other, on_insert, on_erase, on_change);
+    }
+
     void ensure_mutable_tail(edit_t e, count_t n)
     {
         if (!tail->can_mutate(e)) {
@@ -150,12 +268,21 @@ struct rbtree
         }
     }
 
+    void ensure_growable_tail(edit_t e, count_t n)
+    {
+        if (!tail->can_grow(e)) {
+            auto new_tail = node_t::copy_leaf_e(e, tail, n);
+            dec_leaf(tail, n);
+            tail = new_tail;
+        }
+    }
+
     void push_back_mut(edit_t e, T value)
     {
         auto tail_off = tail_offset();
         auto ts = size - tail_off;
         if (ts < branches<BL>) {
-            ensure_mutable_tail(e, ts);
+            ensure_growable_tail(e, ts);
             new (&tail->leaf()[ts]) T{std::move(value)};
         } else {
             auto new_tail = node_t::make_leaf_e(e, std::move(value));
@@ -401,8 +528,8 @@ template <typename T, typename MP, bits_t B, bits_t BL>
 const rbtree<T, MP, B, BL> rbtree<T, MP, B, BL>::empty = {
     0,
     BL,
-    node_t::make_inner_n(0),
-    node_t::make_leaf_n(0)
+    node_t::make_empty_inner(),
+    node_t::make_empty_leaf()
 };
 
 } // namespace rbts
@@ -37,6 +37,7 @@ struct rbtree_iterator : boost::iterator_facade<
     const T&>
 {
     using tree_t = rbtree<T, MP, B, BL>;
+    using node_t = typename tree_t::node_t;
 
     struct end_t {};
 
@@ -46,25 +47,74 @@ struct rbtree_iterator : boost::iterator_facade<
         : v_    { &v }
         , i_    { 0 }
         , base_ { 0 }
-        , curr_ { v.array_for(0) }
     {
+        init_path();
+        curr_ = leaf_for(0);
     }
 
     rbtree_iterator(const tree_t& v, end_t)
         : v_    { &v }
         , i_    { v.size }
         , base_ { i_ - (i_ & mask<BL>) }
-        , curr_ { v.array_for(i_ - 1) + (i_ - base_) }
-    {}
+    {
+        init_path();
+        curr_ = leaf_for(i_ - 1) + (i_ - base_);
+    }
 
 private:
     friend class boost::iterator_core_access;
 
+    // Only the lowest inner levels are cached.  A traversal leaves
+    // them once every `branches<B>^cached_levels` leaves, where
+    // descending from the root again is cheap in comparison.
+    static constexpr count_t cached_levels = 3;
+
     const tree_t* v_;
     size_t    i_;
     size_t    base_;
     const T*  curr_;
 
+    // Inner nodes in the path from the root to the last leaf that we
+    // looked up, where `path_[k]` has shift `BL + k * B`.  Nodes
+    // below `low_`, and the root at `top_`, are not kept there.
+    node_t*   path_[cached_levels] = {};
+    count_t   top_;
+    count_t   low_;
+    size_t    path_idx_;
+
+    void init_path()
+    {
+        top_       = (v_->shift - BL) / B;
+        low_       = top_;
+        path_idx_  = 0;
+    }
+
+    // Returns the leaf containing `idx`, reusing the lowest cached
+    // ancestor, so that stepping to a neighbour leaf does not need
+    // to descend from the root.
+    const T* leaf_for(size_t idx)
+    {
+        if (idx >= v_->tail_offset())
+            return v_->tail->leaf();
+        auto k = low_;
+        while (k < top_ && k < cached_levels &&
+               ((idx ^ path_idx_) >> (BL + (k + 1) * B)) != 0)
+            ++k;
+        auto n = v_->root;
+        if (k < top_ && k < cached_levels)
+            n = path_[k];
+        else
+            k = top_;
+        for (; k > 0; --k) {
+            n = n->inner() [(idx >> (BL + k * B)) & mask<B>];
+            if (k - 1 < cached_levels)
+                path_[k - 1] = n;
+        }
+        low_      = 0;
+        path_idx_ = idx;
+        return n->inner() [(idx >> BL) & mask<B>]->leaf();
+    }
+
     void increment()
     {
         assert(i_ < v_->size);
@@ -73,7 +123,7 @@ private:
             ++curr_;
         } else {
             base_ += branches<BL>;
-            curr_ = v_->array_for(i_);
+            curr_ = leaf_for(i_);
         }
     }
 
@@ -85,7 +135,7 @@ private:
             --curr_;
         } else {
             base_ -= branches<BL>;
-            curr_ = v_->array_for(i_) + (branches<BL> - 1);
+            curr_ = leaf_for(i_) + (branches<BL> - 1);
         }
     }
 
@@ -99,7 +149,7 @@ private:
             curr_ += n;
         } else {
             base_ = i_ - (i_ & mask<BL>);
-            curr_ = v_->array_for(i_) + (i_ - base_);
+            curr_ = leaf_for(i_) + (i_ - base_);
         }
     }
 
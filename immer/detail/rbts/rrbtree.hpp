@@ -25,6 +25,7 @@
 #include <immer/detail/rbts/position.hpp>
 #include <immer/detail/rbts/operations.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <memory>
 #include <numeric>
@@ -33,6 +34,12 @@ namespace immer {
 namespace detail {
 namespace rbts {
 
+template <typename T,
+          typename MemoryPolicy,
+          bits_t   B,
+          bits_t   BL>
+struct rrbtree_iterator;
+
 template <typename T,
           typename MemoryPolicy,
           bits_t   B,
@@ -55,6 +62,19 @@ struct rrbtree
         assert(check_tree());
     }
 
+    template <typename Iter>
+    static rrbtree from_range(Iter first, Iter last)
+    {
+        using std::get;
+        auto r = build_regular_tree<node_t>(first, last);
+        if (!get<3>(r))
+            return empty;
+        else if (!get<2>(r))
+            return { get<0>(r), get<1>(r), empty.root->inc(), get<3>(r) };
+        else
+            return { get<0>(r), get<1>(r), get<2>(r), get<3>(r) };
+    }
+
     rrbtree(const rrbtree& other)
         : rrbtree{other.size, other.shift, other.root, other.tail}
     {
@@ -148,6 +168,107 @@ struct rrbtree
         traverse(for_each_chunk_visitor{}, std::forward<Fn>(fn));
     }
 
+    template <typename Hash>
+    std::size_t hash() const
+    {
+        auto digest = hash_chunk_fn<Hash>{}.digest;
+        traverse(hash_visitor<Hash>{}, digest);
+        return digest;
+    }
+
+    // Calls `fn` on the chunks of the elements in `[first, last)`,
+    // touching only the leaves that overlap the range.
+    template <typename Fn>
+    void for_each_chunk(size_t first, size_t last, Fn&& fn) const
+    {
+        assert(first <= last);
+        assert(last <= size);
+        auto tail_off = tail_offset();
+        if (first < std::min(last, tail_off))
+            visit_maybe_relaxed_sub(root, shift, tail_off,
+                                    for_each_chunk_i_visitor{},
+                                    first, std::min(last, tail_off), fn);
+        if (last > std::max(first, tail_off)) {
+            auto data = tail->leaf();
+            fn(data + (std::max(first, tail_off) - tail_off),
+               data + (last - tail_off));
+        }
+    }
+
+    // Like `for_each_chunk`, but stops as soon as `fn` returns false.
+    // Returns whether all the chunks were visited.
+    template <typename Fn>
+    bool for_each_chunk_p(Fn&& fn) const
+    {
+        return for_each_chunk_p(0, size, std::forward<Fn>(fn));
+    }
+
+    template <typename Fn>
+    bool for_each_chunk_p(size_t first, size_t last, Fn&& fn) const
+    {
+        assert(first <= last);
+        assert(last <= size);
+        auto tail_off = tail_offset();
+        if (first < std::min(last, tail_off) &&
+            !visit_maybe_relaxed_sub(root, shift, tail_off,
+                                         for_each_chunk_p_i_visitor{},
+                                         first, std::min(last, tail_off), fn))
+            return false;
+        if (last > std::max(first, tail_off)) {
+            auto data = tail->leaf();
+            return fn(data + (std::max(first, tail_off) - tail_off),
+                      data + (last - tail_off));
+        }
+        return true;
+    }
+
+    // Calls `fn(pos)`, in order, for a sequence of positions that
+    // together cover the whole tree.  Inner positions cover at most
+    // `grain` elements, but leaves are never split.
+    template <typename Fn>
+    void for_each_subtree(size_t grain, Fn&& fn) const
+    {
+        auto v        = for_each_subtree_visitor{};
+        auto tail_off = tail_offset();
+        auto tail_n   = size - tail_off;
+        if (tail_off)
+            visit_maybe_relaxed_sub(root, shift, tail_off, v, grain, fn);
+        if (tail_n)
+            make_leaf_sub_pos(tail, tail_n).visit(v, grain, fn);
+    }
+
+    bool equals(const rrbtree& other) const
+    {
+        using iter_t = rrbtree_iterator<T, MemoryPolicy, B, BL>;
+        if (size != other.size)
+            return false;
+        else if (root == other.root && tail == other.tail)
+            return true;
+        auto tail_off = tail_offset();
+        if (shift != other.shift || tail_off != other.tail_offset()) {
+            // the trees are not aligned, we can still skip leaves
+            // that are shared in the same position
+            auto fn = make_equals_chunk_fn(iter_t{other});
+            for_each_chunk(fn);
+            return fn.result;
+        } else {
+            auto v = equals_visitor{};
+            return (tail_off == 0
+                    || visit_maybe_relaxed_sub(root, shift, tail_off,
+                                               v, other.root,
+                                               iter_t{other}, size_t{}))
+                && make_leaf_sub_pos(tail, size - tail_off)
+                       .visit(v, other.tail, iter_t{other}, tail_off);
+        }
+    }
+
+    template <typename InsertFn, typename EraseFn, typename ChangeFn>
+    void diff(const rrbtree& other, InsertFn&& on_insert,
+              EraseFn&& on_erase, ChangeFn&& on_change) const
+    {
+        rbts::diff(*this, other, on_insert, on_erase, on_change);
+    }
+
     std::tuple<shift_t, node_t*>
     push_tail(node_t* root, shift_t shift, size_t size,
               node_t* tail, count_t tail_size) const
@@ -248,11 +369,20 @@ struct rrbtree
         }
     }
 
+    void ensure_growable_tail(edit_t e, count_t n)
+    {
+        if (!tail->can_grow(e)) {
+            auto new_tail = node_t::copy_leaf_e(e, tail, n);
+            dec_leaf(tail, n);
+            tail = new_tail;
+        }
+    }
+
     void push_back_mut(edit_t e, T value)
     {
         auto ts = tail_size();
         if (ts < branches<BL>) {
-            ensure_mutable_tail(e, ts);
+            ensure_growable_tail(e, ts);
             new (&tail->leaf()[ts]) T{std::move(value)};
         } else {
             using std::get;
@@ -560,6 +690,242 @@ struct rrbtree
         }
     }
 
+    void insert_mut(edit_t e, size_t idx, T value)
+    {
+        auto tail_off = tail_offset();
+        auto ts       = size - tail_off;
+        if (idx >= size) {
+            push_back_mut(e, std::move(value));
+        } else if (idx >= tail_off && ts < branches<BL>) {
+            ensure_growable_tail(e, ts);
+            auto data = tail->leaf();
+            new (data + ts) T{std::move(value)};
+            ++size;
+            std::rotate(data + (idx - tail_off), data + ts, data + ts + 1);
+        } else if (idx >= tail_off) {
+            // the tail is full, all but its last element go to the tree
+            auto leaf = node_t::copy_leaf_insert_e(e, tail, 0, ts - 1,
+                                                   idx - tail_off,
+                                                   std::move(value));
+            try {
+                auto new_tail = node_t::copy_leaf_e(e, tail, ts - 1, ts);
+                try {
+                    push_tail_mut(e, tail_off, leaf, branches<BL>);
+                } catch (...) {
+                    node_t::delete_leaf(new_tail, 1);
+                    throw;
+                }
+                dec_leaf(tail, ts);
+                tail = new_tail;
+            } catch (...) {
+                node_t::delete_leaf(leaf, branches<BL>);
+                throw;
+            }
+            ++size;
+        } else {
+            using visitor_t = insert_mut_visitor<node_t>;
+            // a root that is not changed in place may be split, and
+            // then there must be a new one to hold both halves
+            auto new_root = visitor_t::in_place(root, e)
+                ? (node_t*){}
+                : node_t::make_inner_r_e(e);
+            auto r = splice_result<node_t>{};
+            try {
+                r = visit_maybe_relaxed_sub(root, shift, tail_off,
+                                            visitor_t{}, e, idx, value);
+            } catch (...) {
+                if (new_root)
+                    node_t::delete_inner_r(new_root);
+                throw;
+            }
+            if (!r.right) {
+                root = r.left;
+                if (new_root)
+                    node_t::delete_inner_r(new_root);
+            } else {
+                auto nr = new_root->relaxed();
+                new_root->inner() [0] = r.left;
+                new_root->inner() [1] = r.right;
+                nr->sizes[0] = r.left_size;
+                nr->sizes[1] = r.left_size + r.right_size;
+                nr->count    = 2;
+                root   = new_root;
+                shift += B;
+            }
+            ++size;
+        }
+    }
+
+    rrbtree insert(size_t idx, T value) const
+    {
+        auto tail_off = tail_offset();
+        auto ts       = size - tail_off;
+        if (idx >= size) {
+            return push_back(std::move(value));
+        } else if (idx >= tail_off && ts < branches<BL>) {
+            auto new_tail = node_t::copy_leaf_insert(tail, ts, idx - tail_off,
+                                                     std::move(value));
+            return { size + 1, shift, root->inc(), new_tail };
+        } else if (idx >= tail_off) {
+            // the tail is full, all but its last element go to the tree
+            using std::get;
+            auto leaf = node_t::copy_leaf_insert(tail, 0, ts - 1,
+                                                 idx - tail_off,
+                                                 std::move(value));
+            try {
+                auto new_tail = node_t::copy_leaf(tail, ts - 1, ts);
+                try {
+                    auto new_root = push_tail(root, shift, tail_off,
+                                              leaf, branches<BL>);
+                    return { size + 1, get<0>(new_root), get<1>(new_root),
+                             new_tail };
+                } catch (...) {
+                    node_t::delete_leaf(new_tail, 1);
+                    throw;
+                }
+            } catch (...) {
+                node_t::delete_leaf(leaf, branches<BL>);
+                throw;
+            }
+        } else {
+            auto r = visit_maybe_relaxed_sub(root, shift, tail_off,
+                                             insert_visitor<node_t>{},
+                                             idx, value);
+            if (!r.right)
+                return { size + 1, shift, r.left, tail->inc() };
+            try {
+                auto new_root = node_t::make_inner_r_n(
+                    2, r.left, r.left_size, r.right, r.right_size);
+                return { size + 1, shift + B, new_root, tail->inc() };
+            } catch (...) {
+                dec_relaxed(r.left, shift);
+                dec_relaxed(r.right, shift);
+                throw;
+            }
+        }
+    }
+
+    void insert_mut(edit_t e, size_t idx, const rrbtree& v)
+    {
+        if (idx >= size) {
+            *this = concat(v);
+        } else if (idx == 0) {
+            *this = v.concat(*this);
+        } else if (v.size <= branches<BL> && &v != this) {
+            // few elements are cheaper to splice one by one, in place,
+            // than cutting and concatenating the trees
+            auto i = idx;
+            v.for_each_chunk([&] (auto f, auto l) {
+                for (; f != l; ++f)
+                    insert_mut(e, i++, *f);
+            });
+        } else {
+            *this = insert(idx, v);
+        }
+    }
+
+    rrbtree insert(size_t idx, const rrbtree& v) const
+    {
+        if (idx >= size)
+            return concat(v);
+        else if (idx == 0)
+            return v.concat(*this);
+        else
+            return take(idx).concat(v).concat(drop(idx));
+    }
+
+    void erase_mut(edit_t e, size_t first, size_t last)
+    {
+        last = std::min(last, size);
+        auto tail_off = tail_offset();
+        if (first >= last) {
+            return;
+        } else if (last == size) {
+            take_mut(e, first);
+        } else if (first == 0) {
+            drop_mut(e, last);
+        } else if (first >= tail_off) {
+            auto ts = size - tail_off;
+            auto n  = last - first;
+            ensure_mutable_tail(e, ts);
+            auto data = tail->leaf();
+            std::move(data + (last - tail_off), data + ts,
+                      data + (first - tail_off));
+            destroy_n(data + ts - n, n);
+            size -= n;
+        } else {
+            auto ts = size - tail_off;
+            if (last > tail_off)
+                ensure_mutable_tail(e, ts);
+            auto r  = visit_maybe_relaxed_sub(root, shift, tail_off,
+                                              erase_mut_visitor<node_t>{}, e,
+                                              first, std::min(last, tail_off));
+            root = r.left;
+            if (last > tail_off) {
+                auto n    = last - tail_off;
+                auto data = tail->leaf();
+                std::move(data + n, data + ts, data);
+                destroy_n(data + ts - n, n);
+            }
+            // drop the roots that were left with a single child
+            while (shift > BL) {
+                auto nr = root->relaxed();
+                if (!nr || nr->count > 1)
+                    break;
+                auto child = root->inner() [0]->inc();
+                dec_relaxed(root, shift);
+                root   = child;
+                shift -= B;
+            }
+            size -= last - first;
+        }
+    }
+
+    rrbtree erase(size_t first, size_t last) const
+    {
+        last = std::min(last, size);
+        auto tail_off = tail_offset();
+        if (first >= last) {
+            return *this;
+        } else if (last == size) {
+            return take(first);
+        } else if (first == 0) {
+            return drop(last);
+        } else if (first >= tail_off) {
+            auto new_tail = node_t::copy_leaf_erase(tail, size - tail_off,
+                                                    first - tail_off,
+                                                    last - tail_off);
+            return { size - (last - first), shift, root->inc(), new_tail };
+        } else {
+            auto ts = size - tail_off;
+            auto r  = visit_maybe_relaxed_sub(root, shift, tail_off,
+                                              erase_visitor<node_t>{},
+                                              first, std::min(last, tail_off));
+            auto new_root  = r.left;
+            auto new_shift = shift;
+            auto new_tail  = (node_t*){};
+            try {
+                new_tail = last > tail_off
+                    ? node_t::copy_leaf_erase(tail, ts, 0, last - tail_off)
+                    : tail->inc();
+            } catch (...) {
+                dec_relaxed(new_root, new_shift);
+                throw;
+            }
+            // drop the roots that were left with a single child
+            while (new_shift > BL) {
+                auto nr = new_root->relaxed();
+                if (!nr || nr->count > 1)
+                    break;
+                auto child = new_root->inner() [0]->inc();
+                dec_relaxed(new_root, new_shift);
+                new_root   = child;
+                new_shift -= B;
+            }
+            return { size - (last - first), new_shift, new_root, new_tail };
+        }
+    }
+
     bool check_tree() const
     {
 #if IMMER_DEBUG_DEEP_CHECK
@@ -665,8 +1031,8 @@ template <typename T, typename MP, bits_t B, bits_t BL>
 const rrbtree<T, MP, B, BL> rrbtree<T, MP, B, BL>::empty = {
     0,
     BL,
-    node_t::make_inner_n(0u),
-    node_t::make_leaf_n(0u)
+    node_t::make_empty_inner(),
+    node_t::make_empty_leaf()
 };
 
 } // namespace rbts
@@ -37,6 +37,7 @@ struct rrbtree_iterator : boost::iterator_facade<
     const T&>
 {
     using tree_t   = rrbtree<T, MP, B, BL>;
+    using node_t   = typename tree_t::node_t;
     using region_t = std::tuple<const T*, size_t, size_t>;
 
     struct end_t {};
@@ -46,23 +47,97 @@ struct rrbtree_iterator : boost::iterator_facade<
     rrbtree_iterator(const tree_t& v)
         : v_    { &v }
         , i_    { 0 }
-        , curr_ { v.region_for(0) }
     {
+        init_path();
+        curr_ = region_for(0);
     }
 
     rrbtree_iterator(const tree_t& v, end_t)
         : v_    { &v }
         , i_    { v.size }
-        , curr_ { v.region_for(v.size) }
-    {}
+    {
+        init_path();
+        curr_ = region_for(v.size);
+    }
 
 private:
     friend class boost::iterator_core_access;
 
+    // Only the lowest inner levels are cached.  A traversal leaves
+    // them once every `branches<B>^cached_levels` leaves, where
+    // searching from the root again is cheap in comparison.
+    static constexpr count_t cached_levels = 3;
+
+    struct level_t
+    {
+        node_t* node;
+        size_t  first;
+        size_t  last;
+    };
+
     const tree_t* v_;
     size_t   i_;
     region_t curr_;
 
+    // Inner nodes in the path from the root to the last leaf that we
+    // looked up, together with the range of elements that they
+    // contain, where `path_[k]` has shift `BL + k * B`.  Levels below
+    // `low_`, and the root at `top_`, are not kept there.
+    level_t  path_[cached_levels] = {};
+    size_t   tail_off_;
+    count_t  top_;
+    count_t  low_;
+
+    void init_path()
+    {
+        top_      = (v_->shift - BL) / B;
+        low_      = top_;
+        tail_off_ = v_->tail_offset();
+    }
+
+    // Returns the region containing `idx`, like `tree_t::region_for`,
+    // but starting the search at the lowest cached ancestor, so that
+    // stepping to a neighbour leaf does not need to descend from the
+    // root and scan the size tables of every relaxed node in the way.
+    region_t region_for(size_t idx)
+    {
+        if (idx >= tail_off_)
+            return { v_->tail->leaf() + (idx - tail_off_), tail_off_, v_->size };
+        auto k = low_;
+        while (k < top_ && k < cached_levels &&
+               (idx < path_[k].first || idx >= path_[k].last))
+            ++k;
+        auto p = level_t{ v_->root, 0, tail_off_ };
+        if (k < top_ && k < cached_levels)
+            p = path_[k];
+        else
+            k = top_;
+        for (;;) {
+            auto  shift = BL + k * B;
+            auto  local = idx - p.first;
+            auto  count = count_t(local >> shift);
+            auto  first = size_t{};
+            auto  last  = size_t{};
+            if (auto r = p.node->relaxed()) {
+                while (r->sizes[count] <= local)
+                    ++count;
+                first = p.first + (count ? r->sizes[count - 1] : 0);
+                last  = p.first + r->sizes[count];
+            } else {
+                first = p.first + (size_t{count} << shift);
+                last  = first + std::min(p.last - first, size_t{1} << shift);
+            }
+            auto child = p.node->inner() [count];
+            if (k == 0) {
+                low_ = 0;
+                return { child->leaf() + (idx - first), first, last };
+            }
+            p = { child, first, last };
+            if (--k < cached_levels)
+                path_[k] = p;
+        }
+    }
+
     void increment()
     {
         using std::get;
@@ -71,7 +146,7 @@ private:
         if (i_ < get<2>(curr_))
             ++get<0>(curr_);
         else
-            curr_ = v_->region_for(i_);
+            curr_ = region_for(i_);
     }
 
     void decrement()
@@ -82,7 +157,7 @@ private:
         if (i_ >= get<1>(curr_))
             --get<0>(curr_);
         else
-            curr_ = v_->region_for(i_);
+            curr_ = region_for(i_);
     }
 
     void advance(std::ptrdiff_t n)
@@ -94,7 +169,7 @@ private:
         if (i_ >= get<1>(curr_) && i_ < get<2>(curr_))
             get<0>(curr_) += n;
         else
-            curr_ = v_->region_for(i_);
+            curr_ = region_for(i_);
     }
 
     bool equal(const rrbtree_iterator& other) const
@@ -0,0 +1,178 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace immer {
+namespace detail {
+
+// A fixed set of worker threads running tasks from a shared queue.
+// Tasks posted from one of the workers are run inline, so that
+// nested parallel algorithms can not exhaust the pool.
+class thread_pool
+{
+public:
+    using task_t = std::function<void()>;
+
+    explicit thread_pool(std::size_t n)
+    {
+        workers_.reserve(n);
+        for (auto i = std::size_t{}; i < n; ++i)
+            workers_.emplace_back([this] { work(); });
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    ~thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            done_ = true;
+        }
+        ready_.notify_all();
+        for (auto& t : workers_)
+            t.join();
+    }
+
+    static thread_pool& instance()
+    {
+        static thread_pool pool{
+            std::max(std::thread::hardware_concurrency(), 1u)};
+        return pool;
+    }
+
+    std::size_t size() const { return workers_.size(); }
+
+    void post(task_t task)
+    {
+        if (current() == this) {
+            task();
+        } else {
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                tasks_.push_back(std::move(task));
+            }
+            ready_.notify_one();
+        }
+    }
+
+private:
+    static thread_pool*& current()
+    {
+        static thread_local thread_pool* pool = nullptr;
+        return pool;
+    }
+
+    void work()
+    {
+        current() = this;
+        for (;;) {
+            auto task = task_t{};
+            {
+                std::unique_lock<std::mutex> lock{mutex_};
+                ready_.wait(lock, [&] { return done_ || !tasks_.empty(); });
+                if (tasks_.empty())
+                    return;
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<task_t> tasks_;
+    bool done_ = false;
+    std::vector<std::thread> workers_;
+};
+
+// Keeps track of a set of tasks submitted to an executor, so that
+// their completion can be awaited.  The first exception thrown by any
+// of the tasks is rethrown from `wait()`.
+class task_group
+{
+public:
+    template <typename Executor, typename Fn>
+    void run(Executor& exec, Fn fn)
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            ++pending_;
+        }
+        try {
+            exec([this, fn] () mutable {
+                try {
+                    fn();
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock{mutex_};
+                    if (!error_)
+                        error_ = std::current_exception();
+                }
+                finish();
+            });
+        } catch (...) {
+            finish();
+            throw;
+        }
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock{mutex_};
+        done_.wait(lock, [&] { return pending_ == 0; });
+        if (error_)
+            std::rethrow_exception(error_);
+    }
+
+    ~task_group()
+    {
+        std::unique_lock<std::mutex> lock{mutex_};
+        done_.wait(lock, [&] { return pending_ == 0; });
+    }
+
+private:
+    void finish()
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (--pending_ == 0)
+            done_.notify_all();
+    }
+
+    std::mutex mutex_;
+    std::condition_variable done_;
+    std::size_t pending_ = 0;
+    std::exception_ptr error_;
+};
+
+} // namespace detail
+} // namespace immer
@@ -0,0 +1,102 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <immer/detail/util.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace immer {
+namespace detail {
+
+// Whether `Iter` is known to point to elements stored contiguously,
+// such that `&*first + n == &*(first + n)`.  Without C++20 concepts,
+// only pointers and the iterators of `std::vector` and `std::string`
+// are recognized.
+template <typename Iter,
+          typename T = typename std::iterator_traits<Iter>::value_type>
+struct is_contiguous_iterator : std::integral_constant<
+    bool,
+    std::is_pointer<Iter>::value
+    || (!std::is_same<T, bool>::value &&
+        (std::is_same<Iter, typename std::vector<T>::iterator>::value ||
+         std::is_same<Iter, typename std::vector<T>::const_iterator>::value))
+    || std::is_same<Iter, std::string::iterator>::value
+    || std::is_same<Iter, std::string::const_iterator>::value>
+{};
+
+template <typename Iter, typename T>
+std::size_t uninitialized_copy_upto(Iter& first, Iter last,
+                                    T* dst, std::size_t n,
+                                    std::false_type)
+{
+    auto i = std::size_t{};
+    try {
+        for (; i < n && first != last; ++first, ++i)
+            new (dst + i) T(*first);
+    } catch (...) {
+        destroy_n(dst, i);
+        throw;
+    }
+    return i;
+}
+
+template <typename Iter, typename T>
+std::size_t uninitialized_copy_upto(Iter& first, Iter last,
+                                    T* dst, std::size_t n,
+                                    std::true_type)
+{
+    n = std::min(n, static_cast<std::size_t>(last - first));
+    if (n)
+        std::memcpy(dst, std::addressof(*first), n * sizeof(T));
+    first += n;
+    return n;
+}
+
+/*!
+ * Copy constructs at most `n` elements from `[first, last)` into the
+ * uninitialized storage at `dst`, advancing `first` past the copied
+ * elements.  Returns the number of elements copied.  Contiguous ranges
+ * of trivially copyable elements are copied with `memcpy`.
+ */
+template <typename Iter, typename T>
+std::size_t uninitialized_copy_upto(Iter& first, Iter last,
+                                    T* dst, std::size_t n)
+{
+    using value_t = typename std::iterator_traits<Iter>::value_type;
+    using memcpy_t = std::integral_constant<
+        bool,
+        is_contiguous_iterator<Iter>::value &&
+        std::is_same<std::remove_cv_t<value_t>, T>::value &&
+        std::is_trivially_copyable<T>::value>;
+    return uninitialized_copy_upto(first, last, dst, n, memcpy_t{});
+}
+
+} // namespace detail
+} // namespace immer
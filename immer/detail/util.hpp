@@ -23,6 +23,7 @@
 #include <immer/config.hpp>
 
 #include <cstddef>
+#include <iterator>
 #include <new>
 #include <type_traits>
 
@@ -37,6 +38,49 @@ void destroy_n(T* p, Size n)
         p->~T();
 }
 
+// Combines the hashes of the elements of a sequence, fed chunk by
+// chunk, into the polynomial `seed * P^n + sum(hash(x_i) * P^(n-1-i))`.
+// The result only depends on the elements and their order, not on how
+// the sequence is split in chunks.
+template <typename Hash>
+struct hash_chunk_fn
+{
+    static constexpr std::size_t factor =
+        static_cast<std::size_t>(1099511628211ull);
+
+    std::size_t digest = static_cast<std::size_t>(14695981039346656037ull);
+
+    template <typename T>
+    void operator() (const T* first, const T* last)
+    {
+        for (; first != last; ++first)
+            digest = digest * factor + Hash{}(*first);
+    }
+
+    // `P^n`, to append the digest of `n` elements computed separately
+    static std::size_t power(std::size_t n)
+    {
+        auto r = std::size_t{1};
+        for (auto x = factor; n; n >>= 1, x *= x)
+            if (n & 1) r *= x;
+        return r;
+    }
+};
+
+template <typename... Ts>
+struct make_void { using type = void; };
+
+template <typename... Ts>
+using void_t = typename make_void<Ts...>::type;
+
+template <typename T, typename = void>
+struct is_iterator : std::false_type {};
+
+template <typename T>
+struct is_iterator<
+    T, void_t<typename std::iterator_traits<T>::iterator_category>>
+    : std::true_type {};
+
 inline void* check_alloc(void* p)
 {
     if (IMMER_UNLIKELY(!p))
@@ -44,6 +88,23 @@ inline void* check_alloc(void* p)
     return p;
 }
 
+// Allocates memory that is never deallocated, like the nodes shared by
+// all the empty containers of a type, which are created during static
+// initialization.  Heaps that can not allocate at that time provide an
+// `allocate_immortal()` for it.
+template <typename Heap>
+auto allocate_immortal_(std::size_t size, int)
+    -> decltype(Heap::allocate_immortal(size))
+{ return Heap::allocate_immortal(size); }
+
+template <typename Heap>
+void* allocate_immortal_(std::size_t size, long)
+{ return Heap::allocate(size); }
+
+template <typename Heap>
+void* allocate_immortal(std::size_t size)
+{ return allocate_immortal_<Heap>(size, 0); }
+
 struct not_supported_t {};
 struct empty_t {};
 
@@ -0,0 +1,190 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace immer {
+namespace detail {
+
+// Per thread reader state.  `epoch` is zero while the thread is not
+// reading, otherwise it is the global epoch when it started to.
+// Records are never freed, but reused once their thread finishes.
+struct epoch_record
+{
+    std::atomic<std::uint64_t> epoch {0};
+    std::atomic<bool> in_use {true};
+    unsigned depth = 0;
+    epoch_record* next = nullptr;
+};
+
+// An object waiting for all the readers that might see it to leave.
+struct epoch_retired
+{
+    std::uint64_t epoch;
+    void* object;
+    void (*destroy)(void*);
+};
+
+template <typename Dummy=void>
+struct epoch_domain
+{
+    // retired objects are reclaimed automatically every so many
+    static constexpr std::size_t reclaim_batch = 64;
+
+    static std::atomic<std::uint64_t> global;
+    static std::atomic<epoch_record*> records;
+    static std::mutex mutex;
+    static std::vector<epoch_retired> retired;
+
+    static epoch_record* acquire_record()
+    {
+        for (auto r = records.load(); r; r = r->next) {
+            auto free = false;
+            if (!r->in_use.load(std::memory_order_relaxed) &&
+                r->in_use.compare_exchange_strong(free, true))
+                return r;
+        }
+        auto r = new epoch_record;
+        r->next = records.load();
+        while (!records.compare_exchange_weak(r->next, r));
+        return r;
+    }
+
+    static epoch_record& local()
+    {
+        thread_local struct holder
+        {
+            epoch_record* record = acquire_record();
+            ~holder() { record->in_use.store(false); }
+        } h;
+        return *h.record;
+    }
+
+    static void enter()
+    {
+        auto& r = local();
+        if (r.depth++ == 0)
+            r.epoch.store(global.load());
+    }
+
+    static void leave()
+    {
+        auto& r = local();
+        if (--r.depth == 0)
+            r.epoch.store(0, std::memory_order_release);
+    }
+
+    static void retire(void* object, void (*destroy)(void*))
+    {
+        // The object must have been unpublished already, so readers
+        // that enter after the epoch moves on can not reach it.
+        auto e = global.fetch_add(1);
+        auto size = std::size_t{};
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            retired.push_back({ e, object, destroy });
+            size = retired.size();
+        }
+        if (size % reclaim_batch == 0)
+            reclaim();
+    }
+
+    static std::size_t reclaim()
+    {
+        // Objects retired after this point may have been reachable by
+        // readers that enter while we look at the records.
+        auto oldest = global.load();
+        for (auto r = records.load(); r; r = r->next) {
+            auto e = r->epoch.load();
+            if (e)
+                oldest = std::min(oldest, e);
+        }
+        auto done = std::vector<epoch_retired>{};
+        auto pending = std::size_t{};
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            auto it = std::partition(
+                retired.begin(), retired.end(),
+                [&] (auto& x) { return x.epoch >= oldest; });
+            done.assign(it, retired.end());
+            retired.erase(it, retired.end());
+            pending = retired.size();
+        }
+        // destroying may take a while, and may retire other objects
+        for (auto& x : done)
+            x.destroy(x.object);
+        return pending;
+    }
+};
+
+template <typename D>
+std::atomic<std::uint64_t> epoch_domain<D>::global {1};
+template <typename D>
+std::atomic<epoch_record*> epoch_domain<D>::records {nullptr};
+template <typename D>
+std::mutex epoch_domain<D>::mutex;
+template <typename D>
+std::vector<epoch_retired> epoch_domain<D>::retired;
+
+} // namespace detail
+
+/*!
+ * Marks the current thread as reading shared data for as long as it
+ * lives.  Objects retired by other threads in the meantime, like the
+ * values replaced in an @ref epoch_atom, are not destroyed until it
+ * is gone.  Entering and leaving touch only memory owned by the
+ * current thread, so many readers do not contend with each other.
+ * Guards can be nested.
+ *
+ * A thread that keeps a guard for a long time prevents reclaiming
+ * anything retired after it started, so guards should be short
+ * lived.
+ */
+class epoch_guard
+{
+public:
+    epoch_guard() { detail::epoch_domain<>::enter(); }
+    ~epoch_guard() { detail::epoch_domain<>::leave(); }
+
+    epoch_guard(const epoch_guard&) = delete;
+    epoch_guard& operator=(const epoch_guard&) = delete;
+};
+
+/*!
+ * Destroys the retired objects that no reader can see anymore, and
+ * returns the number of those that are still pending.  This is done
+ * automatically every now and then when objects are retired, but it
+ * can also be called, for example, from a background thread or after
+ * writers are done.
+ */
+inline std::size_t epoch_reclaim()
+{
+    return detail::epoch_domain<>::reclaim();
+}
+
+} // namespace immer
@@ -0,0 +1,224 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <immer/detail/util.hpp>
+#include <immer/epoch.hpp>
+#include <immer/memory_policy.hpp>
+
+#include <atomic>
+#include <utility>
+
+namespace immer {
+
+/*!
+ * Stores a value that may be read and replaced from many threads,
+ * like @ref atom, but where readers do not take a reference to it.
+ * Instead, they use it directly while holding an @ref epoch_guard,
+ * and the values replaced by writers are destroyed only once all the
+ * readers that could see them are gone.
+ *
+ * This is meant for data that is read much more often than it is
+ * updated.  Reading a `vector` in an `atom` copies it, which
+ * increments and later decrements the reference counts of its root
+ * and tail.  When many threads do that at the same time, they fight
+ * for the cache lines of those counts.  With an `epoch_atom` they
+ * only write to memory of their own, and traverse the nodes without
+ * touching any reference count.
+ *
+ * @rst
+ *
+ * .. code-block:: c++
+ *
+ *    immer::epoch_atom<immer::vector<int>> shared{...};
+ *
+ *    // readers
+ *    auto sum = shared.read([] (const immer::vector<int>& v) {
+ *        return immer::accumulate(v, 0);
+ *    });
+ *
+ *    // writers
+ *    shared.update([] (auto v) { return v.push_back(42); });
+ *
+ * @endrst
+ *
+ * @tparam T The type of the stored values.
+ * @tparam MemoryPolicy Memory management policy used to allocate the
+ *         boxes holding the values.  Any heap can be used, like the
+ *         one in @ref free_list_heap_policy.
+ */
+template <typename T,
+          typename MemoryPolicy = default_memory_policy>
+class epoch_atom
+{
+    struct box_t
+    {
+        T value;
+    };
+
+    using heap = typename MemoryPolicy::heap::template apply<
+        sizeof(box_t)>::type;
+
+public:
+    using value_type = T;
+    using memory_policy = MemoryPolicy;
+
+    /*!
+     * Constructs an atom holding a default constructed `T`.
+     */
+    epoch_atom() : box_{make(T{})} {}
+
+    /*!
+     * Constructs an atom holding `value`.
+     */
+    epoch_atom(T value) : box_{make(std::move(value))} {}
+
+    epoch_atom(const epoch_atom&) = delete;
+    epoch_atom(epoch_atom&&) = delete;
+    epoch_atom& operator=(const epoch_atom&) = delete;
+    epoch_atom& operator=(epoch_atom&&) = delete;
+
+    /*!
+     * Destroys the current value right away.  No thread may be
+     * reading it anymore.
+     */
+    ~epoch_atom() { destroy(box_.load()); }
+
+    /*!
+     * Returns a reference to the current value, that remains valid as
+     * long as the guard `g` lives, even if the atom is updated in the
+     * meantime.
+     */
+    const T& get(const epoch_guard& g) const
+    {
+        (void) g;
+        return box_.load()->value;
+    }
+
+    /*!
+     * Returns the result of calling `fn` with a reference to the
+     * current value.  The reference must not escape `fn`.
+     */
+    template <typename Fn>
+    decltype(auto) read(Fn&& fn) const
+    {
+        epoch_guard g;
+        return std::forward<Fn>(fn)(get(g));
+    }
+
+    /*!
+     * Returns a copy of the current value.
+     */
+    T load() const
+    {
+        epoch_guard g;
+        return get(g);
+    }
+
+    /*!
+     * Same as `load()`.
+     */
+    operator T() const { return load(); }
+
+    /*!
+     * Replaces the current value with `value`.  The previous value is
+     * destroyed once no thread can be reading it.
+     */
+    void store(T value)
+    {
+        retire(box_.exchange(make(std::move(value))));
+    }
+
+    /*!
+     * Same as `store(value)`.
+     */
+    epoch_atom& operator=(T value)
+    {
+        store(std::move(value));
+        return *this;
+    }
+
+    /*!
+     * Replaces the current value with `value` and returns the value
+     * it had before, atomically.
+     */
+    T exchange(T value)
+    {
+        auto old = box_.exchange(make(std::move(value)));
+        auto result = old->value;
+        retire(old);
+        return result;
+    }
+
+    /*!
+     * Replaces the current value `x` with `fn(x)` and returns the new
+     * value.  Like in @ref atom::update, `fn` may be invoked more than
+     * once when other threads write concurrently, so it should not
+     * have side effects.
+     */
+    template <typename Fn>
+    T update(Fn&& fn)
+    {
+        epoch_guard g;
+        auto old = box_.load();
+        while (true) {
+            auto next = make(fn(old->value));
+            // `old` can not be reused for another box while we hold
+            // the guard, so comparing pointers detects any write.
+            if (box_.compare_exchange_weak(old, next)) {
+                auto result = next->value;
+                retire(old);
+                return result;
+            }
+            destroy(next);
+        }
+    }
+
+private:
+    std::atomic<box_t*> box_;
+
+    static box_t* make(T v)
+    {
+        auto m = detail::check_alloc(heap::allocate(sizeof(box_t)));
+        try {
+            return new (m) box_t{std::move(v)};
+        } catch (...) {
+            heap::deallocate(m);
+            throw;
+        }
+    }
+
+    static void destroy(box_t* b)
+    {
+        b->~box_t();
+        heap::deallocate(b);
+    }
+
+    static void retire(box_t* b)
+    {
+        detail::epoch_domain<>::retire(b, [] (void* p) {
+            destroy(static_cast<box_t*>(p));
+        });
+    }
+};
+
+} // namespace immer
@@ -24,6 +24,8 @@
 #include <immer/detail/rbts/rrbtree_iterator.hpp>
 #include <immer/memory_policy.hpp>
 
+#include <functional>
+
 namespace immer {
 
 template <typename T,
@@ -38,6 +40,19 @@ template <typename T,
           detail::rbts::bits_t BL>
 class flex_vector_transient;
 
+template <typename T,
+          typename MP,
+          detail::rbts::bits_t B,
+          detail::rbts::bits_t BL>
+class flex_vector_view;
+
+namespace detail {
+namespace rbts {
+template <typename Container>
+struct archive_loader;
+} // namespace rbts
+} // namespace detail
+
 /*!
  * Immutable sequential container supporting both random access,
  * structural sharing and efficient concatenation and slicing.
@@ -100,6 +115,31 @@ public:
      */
     flex_vector() = default;
 
+    /*!
+     * Constructs a flex_vector containing the elements in the range
+     * `[first, last)`.  Leaves are filled directly from the input and the inner
+     * nodes are built bottom-up, which is significantly faster than
+     * repeated calls to `push_back`.  It may allocate memory and its
+     * complexity is @f$ O(size) @f$.
+     */
+    template <typename Iter,
+              typename = std::enable_if_t<detail::is_iterator<Iter>::value>>
+    flex_vector(Iter first, Iter last)
+        : impl_{ impl_t::from_range(first, last) }
+    {}
+
+    /*!
+     * Returns a flex_vector containing the elements of the range `r`,
+     * as in `flex_vector(std::begin(r), std::end(r))`.
+     */
+    template <typename Range>
+    static flex_vector from_range(const Range& r)
+    {
+        using std::begin;
+        using std::end;
+        return impl_t::from_range(begin(r), end(r));
+    }
+
     /*!
      * Default constructor.  It creates a flex_vector with the same
      * contents as `v`.  It does not allocate memory and is
@@ -224,6 +264,63 @@ public:
     decltype(auto) drop(size_type elems) &&
     { return drop_move(move_t{}, elems); }
 
+    /*!
+     * Returns a flex_vector with `value` inserted at position `pos`,
+     * shifting the following elements one position to the right.
+     * Undefined for `pos > size()`.  It may allocate memory and its
+     * complexity is @f$ O(log(size)) @f$.
+     */
+    flex_vector insert(size_type pos, value_type value) const&
+    { return impl_.insert(pos, std::move(value)); }
+
+    decltype(auto) insert(size_type pos, value_type value) &&
+    { return insert_move(move_t{}, pos, std::move(value)); }
+
+    /*!
+     * Returns a flex_vector with the contents of `xs` inserted at
+     * position `pos`.  Undefined for `pos > size()`.  It may allocate
+     * memory and its complexity is
+     * @f$ O(log(max(size_xs, size))) @f$.
+     *
+     * @rst
+     *
+     * .. note:: In the general case the vector is cut at `pos` and
+     *    the three pieces are concatenated, which copies the nodes
+     *    along the cut and the concatenation seams, even when the
+     *    vector is an r-value.  When it is an r-value and `xs` fits
+     *    in a leaf, the elements are instead inserted one by one, in
+     *    place where possible.
+     *
+     * @endrst
+     */
+    flex_vector insert(size_type pos, const flex_vector& xs) const&
+    { return impl_.insert(pos, xs.impl_); }
+
+    decltype(auto) insert(size_type pos, const flex_vector& xs) &&
+    { return insert_move(move_t{}, pos, xs); }
+
+    /*!
+     * Returns a flex_vector without the element at position `pos`.
+     * Undefined for `pos >= size()`.  It may allocate memory and its
+     * complexity is @f$ O(log(size)) @f$.
+     */
+    flex_vector erase(size_type pos) const&
+    { return impl_.erase(pos, pos + 1); }
+
+    decltype(auto) erase(size_type pos) &&
+    { return erase_move(move_t{}, pos, pos + 1); }
+
+    /*!
+     * Returns a flex_vector without the elements in the range `[first,
+     * last)`.  Undefined for `first > last`.  It may allocate memory
+     * and its complexity is @f$ O(log(size)) @f$.
+     */
+    flex_vector erase(size_type first, size_type last) const&
+    { return impl_.erase(first, last); }
+
+    decltype(auto) erase(size_type first, size_type last) &&
+    { return erase_move(move_t{}, first, last); }
+
     /*!
      * Apply operation `fn` for every *chunk* of data in the vector
      * sequentially.  Each time, `Fn` is passed two `value_type`
@@ -242,6 +339,36 @@ public:
     void for_each_chunk(Fn&& fn) const
     { impl_.for_each_chunk(std::forward<Fn>(fn)); }
 
+    /*!
+     * Apply operation `fn` for every *chunk* of data containing the
+     * elements in the range `[first, last)`, as in
+     * `for_each_chunk(fn)`.  Only the leaves overlapping the range
+     * are visited and no memory is allocated, so this is much cheaper
+     * than slicing the vector first.  Undefined for `first > last` or
+     * `last > size()`.
+     */
+    template <typename Fn>
+    void for_each_chunk(size_type first, size_type last, Fn&& fn) const
+    { impl_.for_each_chunk(first, last, std::forward<Fn>(fn)); }
+
+    /*!
+     * Like `for_each_chunk(fn)`, but the traversal stops as soon as
+     * `fn` returns `false`.  Returns `true` when all the chunks were
+     * visited.
+     */
+    template <typename Fn>
+    bool for_each_chunk_p(Fn&& fn) const
+    { return impl_.for_each_chunk_p(std::forward<Fn>(fn)); }
+
+    /*!
+     * Like `for_each_chunk(first, last, fn)`, but the traversal stops
+     * as soon as `fn` returns `false`.  Returns `true` when all the
+     * chunks in the range were visited.
+     */
+    template <typename Fn>
+    bool for_each_chunk_p(size_type first, size_type last, Fn&& fn) const
+    { return impl_.for_each_chunk_p(first, last, std::forward<Fn>(fn)); }
+
     /*!
      * Concatenation operator. Returns a flex_vector with the contents
      * of `l` followed by those of `r`.  It may allocate memory
@@ -250,6 +377,18 @@ public:
     friend flex_vector operator+ (const flex_vector& l, const flex_vector& r)
     { return l.impl_.concat(r.impl_); }
 
+    /*!
+     * Returns whether the vectors are equal.  Subtrees that are
+     * shared between both vectors are not traversed, so comparing a
+     * vector with a modified version of itself is proportional to
+     * the size of the modification.  It does not allocate memory and
+     * its complexity is @f$ O(size) @f$ in the worst case.
+     */
+    bool operator==(const flex_vector& other) const
+    { return impl_.equals(other.impl_); }
+    bool operator!=(const flex_vector& other) const
+    { return !(*this == other); }
+
     /*!
      * Returns an @a transient form of this container, an
      * `immer::flex_vector_transient`.
@@ -264,8 +403,16 @@ public:
     { impl_.debug_print(); }
 #endif
 
+    // Semi-private
+    const impl_t& impl() const { return impl_; }
+
 private:
     friend transient_type;
+    template <typename C>
+    friend struct detail::rbts::archive_loader;
+    template <typename T_, typename MP_,
+              detail::rbts::bits_t B_, detail::rbts::bits_t BL_>
+    friend class flex_vector_view;
 
     flex_vector(impl_t impl)
         : impl_(std::move(impl))
@@ -277,7 +424,6 @@ private:
 #endif
     }
 
-
     flex_vector&& push_back_move(std::true_type, value_type value)
     { impl_.push_back_mut({}, std::move(value)); return std::move(*this); }
     flex_vector push_back_move(std::false_type, value_type value)
@@ -305,7 +451,54 @@ private:
     flex_vector drop_move(std::false_type, size_type elems)
     { return impl_.drop(elems); }
 
+    flex_vector&& insert_move(std::true_type, size_type pos, value_type value)
+    { impl_.insert_mut({}, pos, std::move(value)); return std::move(*this); }
+    flex_vector insert_move(std::false_type, size_type pos, value_type value)
+    { return impl_.insert(pos, std::move(value)); }
+
+    flex_vector&& insert_move(std::true_type, size_type pos, const flex_vector& xs)
+    { impl_.insert_mut({}, pos, xs.impl_); return std::move(*this); }
+    flex_vector insert_move(std::false_type, size_type pos, const flex_vector& xs)
+    { return impl_.insert(pos, xs.impl_); }
+
+    flex_vector&& erase_move(std::true_type, size_type first, size_type last)
+    { impl_.erase_mut({}, first, last); return std::move(*this); }
+    flex_vector erase_move(std::false_type, size_type first, size_type last)
+    { return impl_.erase(first, last); }
+
     impl_t impl_ = impl_t::empty;
 };
 
+/*!
+ * Returns a hash of the contents of `v`, combining the `std::hash` of
+ * its elements in order.  Equal vectors have the same hash, no matter
+ * how they were built.  It does not allocate memory.  Its complexity
+ * is @f$ O(size) @f$.  When the memory policy enables `cache_digests`,
+ * the digests of inner nodes are cached, so hashing a vector that
+ * shares most of its nodes with one hashed before only visits the
+ * nodes that are not shared.
+ */
+template <typename T,
+          typename MemoryPolicy,
+          detail::rbts::bits_t B,
+          detail::rbts::bits_t BL>
+std::size_t hash_value(const flex_vector<T, MemoryPolicy, B, BL>& v)
+{
+    return v.impl().template hash<std::hash<T>>();
+}
+
 } // namespace immer
+
+namespace std {
+
+template <typename T,
+          typename MemoryPolicy,
+          immer::detail::rbts::bits_t B,
+          immer::detail::rbts::bits_t BL>
+struct hash<immer::flex_vector<T, MemoryPolicy, B, BL>>
+{
+    std::size_t operator() (const immer::flex_vector<T, MemoryPolicy, B, BL>& v) const
+    { return immer::hash_value(v); }
+};
+
+} // namespace std
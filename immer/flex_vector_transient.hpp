@@ -182,6 +182,42 @@ public:
     void drop(size_type elems)
     { impl_.drop_mut(*this, elems); }
 
+    /*!
+     * Inserts `value` at position `pos`, shifting the following
+     * elements one position to the right.  Undefined for `pos >
+     * size()`.  It may allocate memory and its complexity is
+     * @f$ O(log(size)) @f$.
+     */
+    void insert(size_type pos, value_type value)
+    { impl_.insert_mut(*this, pos, std::move(value)); }
+
+    /*!
+     * Inserts the contents of `xs` at position `pos`.  Undefined for
+     * `pos > size()`.  It may allocate memory and its complexity is
+     * @f$ O(log(max(size_xs, size))) @f$.  When `xs` fits in a leaf
+     * its elements are inserted one by one, in place where possible;
+     * otherwise the nodes along the cut at `pos` are copied, as in
+     * `flex_vector::insert`.
+     */
+    void insert(size_type pos, const persistent_type& xs)
+    { impl_.insert_mut(*this, pos, xs.impl_); }
+
+    /*!
+     * Removes the element at position `pos`.  Undefined for `pos >=
+     * size()`.  It may allocate memory and its complexity is
+     * @f$ O(log(size)) @f$.
+     */
+    void erase(size_type pos)
+    { impl_.erase_mut(*this, pos, pos + 1); }
+
+    /*!
+     * Removes the elements in the range `[first, last)`.  Undefined
+     * for `first > last`.  It may allocate memory and its complexity
+     * is @f$ O(log(size)) @f$.
+     */
+    void erase(size_type first, size_type last)
+    { impl_.erase_mut(*this, first, last); }
+
     /*!
      * Returns an @a immutable form of this container, an
      * `immer::flex_vector`.
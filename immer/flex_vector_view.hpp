@@ -0,0 +1,148 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <immer/detail/rbts/borrowed_tree.hpp>
+#include <immer/flex_vector.hpp>
+
+namespace immer {
+
+/*!
+ * Non-owning, read-only view of an `immer::flex_vector`, that can be
+ * passed around without touching any reference count.  Like a @ref
+ * vector_view, it borrows the nodes of the flex_vector it was created
+ * from, so some flex_vector holding the same value must outlive it.
+ */
+template <typename T,
+          typename MemoryPolicy   = default_memory_policy,
+          detail::rbts::bits_t B  = default_bits,
+          detail::rbts::bits_t BL = detail::rbts::derive_bits_leaf<T, MemoryPolicy, B>>
+class flex_vector_view
+{
+public:
+    using flex_vector_type = flex_vector<T, MemoryPolicy, B, BL>;
+
+    using value_type = T;
+    using reference = const T&;
+    using size_type = detail::rbts::size_t;
+    using difference_type = std::ptrdiff_t;
+    using const_reference = const T&;
+
+    using iterator         = typename flex_vector_type::iterator;
+    using const_iterator   = iterator;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+
+    /*!
+     * Views the flex_vector `v`.  It does not allocate memory and its
+     * complexity is @f$ O(1) @f$.
+     */
+    flex_vector_view(const flex_vector_type& v)
+        : impl_{ v.impl() }
+    {}
+
+    flex_vector_view(flex_vector_type&&) = delete;
+
+    /*!
+     * Returns an iterator pointing at the first element of the
+     * collection. It does not allocate memory and its complexity is
+     * @f$ O(1) @f$.
+     */
+    iterator begin() const { return {impl()}; }
+
+    /*!
+     * Returns an iterator pointing just after the last element of the
+     * collection. It does not allocate and its complexity is @f$ O(1) @f$.
+     */
+    iterator end()   const { return {impl(), typename iterator::end_t{}}; }
+
+    /*!
+     * Returns an iterator that traverses the collection backwards,
+     * pointing at the first element of the reversed collection. It
+     * does not allocate memory and its complexity is @f$ O(1) @f$.
+     */
+    reverse_iterator rbegin() const { return reverse_iterator{end()}; }
+
+    /*!
+     * Returns an iterator that traverses the collection backwards,
+     * pointing after the last element of the reversed collection. It
+     * does not allocate memory and its complexity is @f$ O(1) @f$.
+     */
+    reverse_iterator rend()   const { return reverse_iterator{begin()}; }
+
+    /*!
+     * Returns the number of elements in the container.  It does
+     * not allocate memory and its complexity is @f$ O(1) @f$.
+     */
+    size_type size() const { return impl().size; }
+
+    /*!
+     * Returns `true` if there are no elements in the container.  It
+     * does not allocate memory and its complexity is @f$ O(1) @f$.
+     */
+    bool empty() const { return impl().size == 0; }
+
+    /*!
+     * Returns a `const` reference to the element at position `index`.
+     * It does not allocate memory and its complexity is *effectively*
+     * @f$ O(1) @f$.
+     */
+    reference operator[] (size_type index) const
+    { return impl().get(index); }
+
+    /*!
+     * Apply operation `fn` for every *chunk* of data in the
+     * flex_vector, as in `flex_vector::for_each_chunk`.
+     */
+    template <typename Fn>
+    void for_each_chunk(Fn&& fn) const
+    { impl().for_each_chunk(std::forward<Fn>(fn)); }
+
+    template <typename Fn>
+    void for_each_chunk(size_type first, size_type last, Fn&& fn) const
+    { impl().for_each_chunk(first, last, std::forward<Fn>(fn)); }
+
+    template <typename Fn>
+    bool for_each_chunk_p(Fn&& fn) const
+    { return impl().for_each_chunk_p(std::forward<Fn>(fn)); }
+
+    template <typename Fn>
+    bool for_each_chunk_p(size_type first, size_type last, Fn&& fn) const
+    { return impl().for_each_chunk_p(first, last, std::forward<Fn>(fn)); }
+
+    /*!
+     * Returns an owning flex_vector with the viewed value, that can
+     * outlive the view.  It does not allocate memory and its complexity is
+     * @f$ O(1) @f$.
+     */
+    flex_vector_type get() const { return impl(); }
+    operator flex_vector_type() const { return get(); }
+
+    // Semi-private
+    decltype(auto) impl() const { return impl_.get(); }
+
+private:
+    using impl_t = std::decay_t<decltype(std::declval<flex_vector_type>().impl())>;
+
+    detail::rbts::borrowed_tree<impl_t> impl_;
+};
+
+} // namespace immer
@@ -0,0 +1,216 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <immer/heap/malloc_heap.hpp>
+#include <immer/config.hpp>
+
+#include <cassert>
+#include <cstddef>
+
+namespace immer {
+
+namespace detail {
+
+constexpr std::size_t arena_align(std::size_t size)
+{
+    constexpr auto a = alignof(std::max_align_t);
+    return (size + a - 1) / a * a;
+}
+
+} // namespace detail
+
+/*!
+ * A region of memory where objects are allocated by bumping a
+ * pointer and that is released all at once when the arena is
+ * destroyed.  Constructing an arena makes it the *current arena* of
+ * the calling thread, from which the @ref arena_heap allocates,
+ * until it is destroyed.  Arenas can be nested, but they must be
+ * destroyed in the reverse order of construction, which is naturally
+ * the case when they are used as local variables.
+ *
+ * A container allocates its new nodes in the arena that is current
+ * when it is updated, not in the one where it was created.  Thus,
+ * the result of updating a container while a nested arena is current
+ * can only be used until that nested arena is destroyed, even when
+ * the original container lives in an outer arena.
+ *
+ * @rst
+ *
+ * .. caution:: All objects allocated in the arena, including the
+ *    containers that use the :cpp:type:`immer::arena_memory_policy`,
+ *    must not be used after the arena is destroyed.  Copy the results
+ *    that should survive into a container with another memory policy
+ *    before that.
+ *
+ * @endrst
+ */
+class arena
+{
+public:
+    static constexpr std::size_t default_chunk_size = 1 << 16;
+
+    /*!
+     * Makes this the current arena of the calling thread.  Memory is
+     * requested from the `malloc_heap` in chunks of `chunk_size`
+     * bytes.
+     */
+    explicit arena(std::size_t chunk_size = default_chunk_size)
+        : chunk_size_{chunk_size}
+        , previous_{current_()}
+    {
+        current_() = this;
+    }
+
+    /*!
+     * Releases all the memory allocated in the arena and restores the
+     * previous current arena.
+     */
+    ~arena()
+    {
+        assert(current_() == this);
+        current_() = previous_;
+        while (chunks_) {
+            auto next = chunks_->next;
+            malloc_heap::deallocate(chunks_);
+            chunks_ = next;
+        }
+    }
+
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    /*!
+     * Returns a pointer to a memory region of size `size` that lives
+     * until the arena is destroyed, or `nullptr` if the allocation was
+     * not successful.
+     */
+    void* allocate(std::size_t size)
+    {
+        size = detail::arena_align(size);
+        if (IMMER_UNLIKELY(size > std::size_t(end_ - pos_))) {
+            // big objects get their own chunk, so the space left in
+            // the current one is not wasted
+            if (size > chunk_size_ / 2)
+                return add_chunk(size, false);
+            auto payload = chunk_size_ > header_size + size
+                ? chunk_size_ - header_size
+                : size;
+            if (!add_chunk(payload, true))
+                return nullptr;
+        }
+        auto p = pos_;
+        pos_ += size;
+        return p;
+    }
+
+    /*!
+     * Returns the current arena of the calling thread, or `nullptr`
+     * if there is none.
+     */
+    static arena* current() { return current_(); }
+
+private:
+    struct chunk
+    {
+        chunk* next;
+    };
+
+    static constexpr auto header_size = detail::arena_align(sizeof(chunk));
+
+    void* add_chunk(std::size_t size, bool bump)
+    {
+        auto c = static_cast<chunk*>(malloc_heap::allocate(header_size + size));
+        if (!c)
+            return nullptr;
+        auto data = reinterpret_cast<char*>(c) + header_size;
+        if (bump) {
+            c->next = chunks_;
+            chunks_ = c;
+            pos_ = data;
+            end_ = data + size;
+        } else if (chunks_) {
+            c->next = chunks_->next;
+            chunks_->next = c;
+        } else {
+            c->next = nullptr;
+            chunks_ = c;
+        }
+        return data;
+    }
+
+    static arena*& current_()
+    {
+        thread_local arena* current = nullptr;
+        return current;
+    }
+
+    std::size_t chunk_size_;
+    arena* previous_;
+    chunk* chunks_ = nullptr;
+    char* pos_     = nullptr;
+    char* end_     = nullptr;
+};
+
+/*!
+ * A heap that allocates memory in the current @ref arena of the
+ * calling thread.  Deallocation does nothing, since the memory is
+ * released when the arena is destroyed.
+ *
+ * Allocating when there is no current arena fails, so updating a
+ * container that uses this heap outside of an arena throws
+ * `std::bad_alloc` instead of leaking memory.  The only exception is
+ * the memory requested with `allocate_immortal()`.
+ *
+ * @rst
+ *
+ * .. caution:: Objects allocated in an arena are never destroyed
+ *    individually, so containers using this heap should not hold
+ *    objects that own other resources.
+ *
+ * @endrst
+ */
+struct arena_heap
+{
+    template <typename... Tags>
+    static void* allocate(std::size_t size, Tags...)
+    {
+        auto a = arena::current();
+        return IMMER_LIKELY(a) ? a->allocate(size) : nullptr;
+    }
+
+    /*!
+     * Returns memory from the @ref malloc_heap that is never released.
+     * It is used for the nodes of the empty containers, which are
+     * shared by all containers of the same type and created during
+     * static initialization, when there is no current arena.
+     */
+    static void* allocate_immortal(std::size_t size)
+    {
+        return malloc_heap::allocate(size);
+    }
+
+    template <typename... Tags>
+    static void deallocate(void*, Tags...)
+    {}
+};
+
+} // namespace immer
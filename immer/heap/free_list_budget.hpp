@@ -0,0 +1,160 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <immer/config.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <initializer_list>
+
+namespace immer {
+namespace detail {
+
+/*!
+ * Entry in the list of free lists that can be emptied by
+ * `trim_free_lists()`.  Every free list heap instantiation registers
+ * one the first time it parks some memory.  Entries are never
+ * removed, since they live in static storage.
+ */
+struct free_list_registration
+{
+    enum level_t { local, global };
+
+    using clear_t = void (*)();
+
+    free_list_registration(level_t level, clear_t clear);
+
+    level_t level;
+    clear_t clear;
+    free_list_registration* next;
+};
+
+template <typename Dummy=void>
+struct free_list_globals
+{
+    static std::atomic<std::size_t> budget;
+    static std::atomic<std::size_t> parked;
+    static std::atomic<std::size_t> epoch;
+    static std::atomic<free_list_registration*> registry;
+};
+
+template <typename D>
+std::atomic<std::size_t> free_list_globals<D>::budget {default_free_list_budget};
+template <typename D>
+std::atomic<std::size_t> free_list_globals<D>::parked {0};
+template <typename D>
+std::atomic<std::size_t> free_list_globals<D>::epoch {0};
+template <typename D>
+std::atomic<free_list_registration*> free_list_globals<D>::registry {nullptr};
+
+inline free_list_registration::free_list_registration(level_t l, clear_t c)
+    : level{l}
+    , clear{c}
+    , next{free_list_globals<>::registry.load(std::memory_order_relaxed)}
+{
+    while (!free_list_globals<>::registry.compare_exchange_weak(
+               next, this,
+               std::memory_order_release,
+               std::memory_order_relaxed));
+}
+
+/*!
+ * Reserves `size` bytes of the free list budget.  Returns whether
+ * the memory can be parked in a global free list.
+ */
+inline bool free_list_budget_acquire(std::size_t size)
+{
+    auto& g = free_list_globals<>::parked;
+    auto parked = g.fetch_add(size, std::memory_order_relaxed) + size;
+    if (parked > free_list_globals<>::budget.load(std::memory_order_relaxed)) {
+        g.fetch_sub(size, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+inline void free_list_budget_release(std::size_t size)
+{
+    free_list_globals<>::parked.fetch_sub(size, std::memory_order_relaxed);
+}
+
+inline std::size_t free_list_epoch()
+{
+    return free_list_globals<>::epoch.load(std::memory_order_relaxed);
+}
+
+} // namespace detail
+
+/*!
+ * Returns the maximum number of bytes that may be kept, all
+ * together, in the global free lists of every @ref free_list_heap
+ * and @ref unsafe_free_list_heap.
+ */
+inline std::size_t free_list_budget()
+{
+    return detail::free_list_globals<>::budget.load(std::memory_order_relaxed);
+}
+
+/*!
+ * Sets the maximum number of bytes that may be kept in the global
+ * free lists.  Lowering the budget does not release the memory that
+ * is already parked; call @ref trim_free_lists for that.
+ */
+inline void set_free_list_budget(std::size_t bytes)
+{
+    detail::free_list_globals<>::budget.store(bytes, std::memory_order_relaxed);
+}
+
+/*!
+ * Returns the number of bytes currently kept in the global free
+ * lists, including the budget that @ref unsafe_free_list_heap
+ * reserves ahead of time.  The memory held by `thread_local` free
+ * lists is not accounted for.
+ */
+inline std::size_t free_list_parked_bytes()
+{
+    return detail::free_list_globals<>::parked.load(std::memory_order_relaxed);
+}
+
+/*!
+ * Returns the memory held by the free lists to their parent heaps.
+ * The `thread_local` free lists of the calling thread and all the
+ * global free lists are emptied.  The `thread_local` free lists of
+ * other threads are emptied too if they release idle lists (see @ref
+ * thread_local_free_list_heap): their idle magazine right away, and
+ * the one in use the next time these threads use them.
+ */
+inline void trim_free_lists()
+{
+    using detail::free_list_registration;
+    auto& g = detail::free_list_globals<>::registry;
+    detail::free_list_globals<>::epoch.fetch_add(1, std::memory_order_relaxed);
+    // local lists are emptied first, since they may return their
+    // memory to some global list
+    for (auto level : { free_list_registration::local,
+                        free_list_registration::global })
+        for (auto r = g.load(std::memory_order_acquire); r; r = r->next)
+            if (r->level == level)
+                r->clear();
+}
+
+} // namespace immer
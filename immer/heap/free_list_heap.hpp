@@ -20,11 +20,21 @@
 
 #pragma once
 
+#include <immer/config.hpp>
 #include <immer/heap/with_data.hpp>
+#include <immer/heap/free_list_budget.hpp>
 #include <immer/heap/free_list_node.hpp>
 
+#if IMMER_HEAP_STATS
+#include <immer/heap/heap_stats.hpp>
+#else
+#include <immer/detail/heap_stats_recorder.hpp>
+#endif
+
+#include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <new>
 
 namespace immer {
 
@@ -33,8 +43,22 @@ namespace immer {
  * instead it keeps the memory in a thread-safe global free list. Must
  * be preceded by a `with_data<free_list_node, ...>` heap adaptor.
  *
- * @tparam Size Maximum size of the objects to be allocated.
- * @tparam Base Type of the parent heap.
+ * The free list is a *depot* of batches of objects.  Besides the
+ * usual `allocate` and `deallocate` of single objects, whole batches
+ * can be exchanged with `allocate_batch` and `deallocate_batch`, as
+ * the @ref thread_local_free_list_heap does.  Every batch is a chain
+ * of `free_list_node` that is owned by a single slot of the depot.
+ * Batches are taken out by atomically exchanging the slot with null,
+ * so the nodes in it are never traversed concurrently and the depot
+ * is not exposed to the *ABA* problem.
+ *
+ * The memory kept in all global free lists together is bounded by
+ * @ref free_list_budget, and it can be released with @ref
+ * trim_free_lists.
+ *
+ * @tparam Size  Maximum size of the objects to be allocated.
+ * @tparam Limit Maximum number of elements to keep in the free list.
+ * @tparam Base  Type of the parent heap.
  */
 template <std::size_t Size, std::size_t Limit, typename Base>
 struct free_list_heap : Base
@@ -47,45 +71,211 @@ struct free_list_heap : Base
         assert(size <= sizeof(free_list_node) + Size);
         assert(size >= sizeof(free_list_node));
 
-        free_list_node* n;
-        do {
-            n = head_.data;
-            if (!n) {
-                auto p = base_t::allocate(Size + sizeof(free_list_node));
-                return static_cast<free_list_node*>(p);
-            }
-        } while (!head_.data.compare_exchange_weak(n, n->next));
-        head_.count.fetch_sub(1u, std::memory_order_relaxed);
-        return n;
+        auto n = pop();
+        stats::allocate(size, n != nullptr);
+        return n ? n : base_t::allocate(block_size);
     }
 
     template <typename... Tags>
     static void deallocate(void* data, Tags...)
+    {
+        stats::deallocate();
+        push(static_cast<free_list_node*>(data));
+    }
+
+    /*!
+     * Takes a whole batch of objects out of the free list, returning
+     * the first `free_list_node` of the chain and storing its length
+     * in `count`, or returning null when the free list is empty.
+     */
+    static free_list_node* allocate_batch(std::size_t& count)
+    {
+        auto n = take(count);
+        if (n)
+            stats::allocate(Size, true, count);
+        return n;
+    }
+
+    /*!
+     * Puts the null terminated chain of `count` objects starting at
+     * `n` in the free list, or returns them to the parent heap when
+     * the free list or the @ref free_list_budget are exhausted.
+     */
+    static void deallocate_batch(free_list_node* n, std::size_t count)
+    {
+        assert(n && count);
+        stats::deallocate(count);
+        give(n, count);
+    }
+
+    static void clear()
+    {
+        auto count = std::size_t{};
+        while (auto n = take(count))
+            release(n);
+    }
+
+private:
+    static constexpr auto block_size =
+        sizeof(free_list_node) + std::max(Size, sizeof(std::size_t));
+    static constexpr auto slot_count =
+        std::max<std::size_t>(1, std::min<std::size_t>(Limit, 32));
+
+    // Single objects are gathered in the batch of the first slot until
+    // it has this many, so that they do not take a whole slot each.
+    static constexpr auto batch_limit =
+        std::max<std::size_t>(1, (Limit + slot_count - 1) / slot_count);
+
+    // The length of a batch is stored right after the header of its
+    // first node, in memory that is unused while it is parked.
+    static std::size_t& batch_size(free_list_node* n)
+    { return *reinterpret_cast<std::size_t*>(n + 1); }
+
+    using stats = detail::heap_stats_recorder<
+        free_list_heap, detail::heap_kind::free_list, Size>;
+
+    static free_list_node* take(std::size_t& count)
+    {
+        for (auto& slot : slots_) {
+            if (slot.load(std::memory_order_relaxed)) {
+                auto n = slot.exchange(nullptr, std::memory_order_acquire);
+                if (n) {
+                    count = batch_size(n);
+                    unreserve(count);
+                    stats::park(-std::ptrdiff_t(count));
+                    return n;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    // Takes one object out of the first batch found and puts the rest
+    // of it back where it was, which is most likely still empty.
+    static free_list_node* pop()
+    {
+        for (auto& slot : slots_) {
+            if (slot.load(std::memory_order_relaxed)) {
+                auto n = slot.exchange(nullptr, std::memory_order_acquire);
+                if (n) {
+                    auto count = batch_size(n);
+                    unreserve(1);
+                    stats::park(-1);
+                    if (count > 1 && !put(slot, n->next, count - 1) &&
+                        !put_any(n->next, count - 1)) {
+                        unreserve(count - 1);
+                        stats::park(-std::ptrdiff_t(count - 1));
+                        release(n->next);
+                    }
+                    return n;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    // Adds one object to the batch in the first slot, or moves that
+    // batch to another slot once it is full.
+    static void push(free_list_node* n)
+    {
+        if (!reserve(1)) {
+            base_t::deallocate(n);
+            return;
+        }
+        stats::park(1);
+        auto b = slots_[0].exchange(nullptr, std::memory_order_acquire);
+        auto count = b ? batch_size(b) + 1 : 1;
+        n->next = b;
+        if (put_any(n, count, count < batch_limit ? 0 : 1))
+            return;
+        unreserve(count);
+        stats::park(-std::ptrdiff_t(count));
+        release(n);
+    }
+
+    static void give(free_list_node* n, std::size_t count)
+    {
+        if (reserve(count)) {
+            if (put_any(n, count, 1)) {
+                stats::park(count);
+                return;
+            }
+            unreserve(count);
+        }
+        release(n);
+    }
+
+    static void release(free_list_node* n)
+    {
+        while (n) {
+            auto next = n->next;
+            base_t::deallocate(n);
+            n = next;
+        }
+    }
+
+    static bool reserve(std::size_t count)
     {
         // we use relaxed, because we are fine with temporarily having
         // a few more/less buffers in free list
-        if (head_.count.load(std::memory_order_relaxed) >= Limit) {
-            base_t::deallocate(data);
-        } else {
-            auto n = static_cast<free_list_node*>(data);
-            do {
-                n->next = head_.data;
-            } while (!head_.data.compare_exchange_weak(n->next, n));
-            head_.count.fetch_add(1u, std::memory_order_relaxed);
+        auto parked = count_.fetch_add(count, std::memory_order_relaxed);
+        if (parked + count > Limit) {
+            count_.fetch_sub(count, std::memory_order_relaxed);
+            return false;
+        }
+        if (!detail::free_list_budget_acquire(count * block_size)) {
+            count_.fetch_sub(count, std::memory_order_relaxed);
+            return false;
         }
+        if (IMMER_UNLIKELY(!parked))
+            register_clear();
+        return true;
     }
 
-private:
-    struct head_t
+    // Called when the first batch is parked in an empty depot, so
+    // the guard of the static is not checked on every push.
+    static void register_clear()
+    {
+        static detail::free_list_registration registration {
+            detail::free_list_registration::global, &clear };
+    }
+
+    static void unreserve(std::size_t count)
     {
-        std::atomic<free_list_node*> data;
-        std::atomic<std::size_t> count;
-    };
+        count_.fetch_sub(count, std::memory_order_relaxed);
+        detail::free_list_budget_release(count * block_size);
+    }
 
-    static head_t head_;
+    static bool put(std::atomic<free_list_node*>& slot,
+                    free_list_node* n, std::size_t count)
+    {
+        auto empty = static_cast<free_list_node*>(nullptr);
+        batch_size(n) = count;
+        return !slot.load(std::memory_order_relaxed) &&
+            slot.compare_exchange_strong(empty, n,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed);
+    }
+
+    // Whole batches are put starting at the second slot, to leave the
+    // first one for the batch that single objects are added to.
+    static bool put_any(free_list_node* n, std::size_t count,
+                        std::size_t first = 1)
+    {
+        for (auto i = std::size_t{}; i < slot_count; ++i)
+            if (put(slots_[(first + i) % slot_count], n, count))
+                return true;
+        return false;
+    }
+
+    static std::atomic<free_list_node*> slots_[slot_count];
+    static std::atomic<std::size_t> count_;
 };
 
 template <std::size_t S, std::size_t L, typename B>
-typename free_list_heap<S,L,B>::head_t  free_list_heap<S,L,B>::head_ {{nullptr}, {0}};
+std::atomic<free_list_node*> free_list_heap<S,L,B>::slots_[free_list_heap<S,L,B>::slot_count] {};
+
+template <std::size_t S, std::size_t L, typename B>
+std::atomic<std::size_t> free_list_heap<S,L,B>::count_ {0};
 
 } // namespace immer
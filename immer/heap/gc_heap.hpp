@@ -20,8 +20,15 @@
 
 #pragma once
 
+#include <immer/config.hpp>
 #include <immer/heap/tags.hpp>
 
+#if IMMER_HEAP_STATS
+#include <immer/heap/heap_stats.hpp>
+#else
+#include <immer/detail/heap_stats_recorder.hpp>
+#endif
+
 #if IMMER_HAS_LIBGC
 #include <gc/gc.h>
 #else
@@ -111,24 +118,32 @@ public:
     static void* allocate(std::size_t n)
     {
         IMMER_GC_INIT_GUARD_;
+        stats::allocate(n);
         return GC_malloc(n);
     }
 
     static void* allocate(std::size_t n, norefs_tag)
     {
         IMMER_GC_INIT_GUARD_;
+        stats::allocate(n);
         return GC_malloc_atomic(n);
     }
 
     static void deallocate(void* data)
     {
+        stats::deallocate();
         GC_free(data);
     }
 
     static void deallocate(void* data, norefs_tag)
     {
+        stats::deallocate();
         GC_free(data);
     }
+
+private:
+    using stats = detail::heap_stats_recorder<
+        gc_heap, detail::heap_kind::gc>;
 };
 
 } // namespace immer
@@ -22,6 +22,7 @@
 
 #include <immer/heap/free_list_heap.hpp>
 #include <immer/heap/malloc_heap.hpp>
+#include <immer/heap/size_class_heap.hpp>
 #include <immer/heap/thread_local_free_list_heap.hpp>
 #include <immer/config.hpp>
 
@@ -89,7 +90,10 @@ struct enable_heap_policy
  *
  * - A global free list using lock-free access via atomics.
  *
- * @tparam Heap Heap to be used when the free list is empty.
+ * @tparam Heap        Heap to be used when the free list is empty.
+ * @tparam Limit       Maximum number of objects in each free list.
+ * @tparam ReleaseIdle Empty the ``thread_local`` free lists after
+ *         @ref trim_free_lists.
  *
  * @rst
  *
@@ -106,19 +110,21 @@ struct enable_heap_policy
  *    return a node that was just accessed.  When batches of immutable
  *    updates are made, this can make a significant difference.
  *
- * .. admonition:: Todo
- *
- *    It might be a bad idea to use this allocator when immutable data
- *    structures are seldom used, specially if, when used, very big
- *    structures requiring a lot of memory are created.  If no
- *    immutable data is created later, this memory is wasted. We
- *    should add *bound* the maximum amount of memory that is allowed
- *    to be parked in the free list.
+ * .. note:: It might be a bad idea to keep memory around when
+ *    immutable data structures are seldom used, specially if, when
+ *    used, very big structures requiring a lot of memory are
+ *    created.  The memory parked in all the global free lists is thus
+ *    bounded by :cpp:func:`immer::free_list_budget`, and it can be
+ *    given back with :cpp:func:`immer::trim_free_lists`.  When
+ *    `ReleaseIdle` is true, the ``thread_local`` free lists of other
+ *    threads are also emptied: half of them by the trim itself and
+ *    the rest the next time their thread allocates or deallocates.
  *
  * @endrst
  */
 template <typename Heap,
-          std::size_t Limit = default_free_list_size>
+          std::size_t Limit = default_free_list_size,
+          bool ReleaseIdle = false>
 struct free_list_heap_policy
 {
     template <std::size_t... Sizes>
@@ -130,7 +136,8 @@ struct free_list_heap_policy
             thread_local_free_list_heap<
                 max_size,
                 Limit,
-                free_list_heap<max_size, Limit, Heap>>>;
+                free_list_heap<max_size, Limit, Heap>,
+                ReleaseIdle>>;
     };
 };
 
@@ -153,4 +160,61 @@ struct unsafe_free_list_heap_policy
     };
 };
 
+/*!
+ * Heap policy similar to @ref free_list_heap_policy, but instead of
+ * rounding every object up to `max(Sizes...)`, it keeps a separate
+ * pair of `thread_local` and global free lists for each of the
+ * `Sizes` and serves every allocation from the smallest one that
+ * fits, using a @ref size_class_heap.
+ *
+ * @rst
+ *
+ * .. tip:: The nodes of a container may have very different sizes.
+ *    For example, the leaves of a ``vector<std::uint32_t>`` are less
+ *    than half the size of its relaxed inner nodes.  Because leaves
+ *    make up most of the nodes of a big container, this policy can
+ *    reduce the memory used by the free list heaps by a similar
+ *    factor, at the cost of selecting the size class on every
+ *    allocation.
+ *
+ * @endrst
+ */
+template <typename Heap,
+          std::size_t Limit = default_free_list_size,
+          bool ReleaseIdle = false>
+struct size_class_free_list_heap_policy
+{
+    template <std::size_t Size>
+    using class_heap = thread_local_free_list_heap<
+        Size,
+        Limit,
+        free_list_heap<Size, Limit, Heap>,
+        ReleaseIdle>;
+
+    template <std::size_t... Sizes>
+    struct apply
+    {
+        using type = size_class_heap<class_heap, Sizes...>;
+    };
+};
+
+/**
+ * Similar to @ref size_class_free_list_heap_policy, but it assumes no
+ * multi-threading, so a single global free list per size class with
+ * no concurrency checks is used.
+ */
+template <typename Heap,
+          std::size_t Limit = default_free_list_size>
+struct unsafe_size_class_free_list_heap_policy
+{
+    template <std::size_t Size>
+    using class_heap = unsafe_free_list_heap<Size, Limit, Heap>;
+
+    template <std::size_t... Sizes>
+    struct apply
+    {
+        using type = size_class_heap<class_heap, Sizes...>;
+    };
+};
+
 } // namespace immer
@@ -0,0 +1,318 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <immer/config.hpp>
+#include <immer/detail/heap_stats_recorder.hpp>
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#if IMMER_HEAP_STATS
+#include <atomic>
+#include <mutex>
+#endif
+
+namespace immer {
+
+/*!
+ * Counters of the activity of one heap layer in one thread, as
+ * returned by @ref heap_stats_snapshot.
+ */
+struct heap_stats
+{
+    //! Name of the heap layer, like `"free_list_heap"`.
+    const char* heap;
+    //! Size of the objects of the heap, or zero when it varies.
+    std::size_t size;
+    //! Thread doing the work, or a default constructed id for the
+    //! accumulated work of threads that have finished.
+    std::thread::id thread;
+
+    std::size_t allocations;
+    std::size_t deallocations;
+    //! Allocations served from a free list.
+    std::size_t hits;
+    //! Allocations that had to be forwarded to the parent heap.
+    std::size_t misses;
+    //! Sum of the sizes requested to the heap.
+    std::size_t bytes_allocated;
+    //! Objects put in the free list minus the ones taken out of it.
+    //! It can be negative for a thread that allocates memory that
+    //! another thread parked.
+    std::ptrdiff_t parked;
+    //! Sum of the sizes of the objects returned to a heap of varying
+    //! `size`.
+    std::size_t bytes_deallocated;
+    //! Whether `bytes_in_use()` is available.  It is not for the
+    //! `gc_heap`, because the collector releases memory without going
+    //! through the heap.
+    bool tracks_bytes;
+
+    //! Memory handed out by the heap and not yet returned to it, or
+    //! zero when `tracks_bytes` is false.  It can be negative for a
+    //! thread that frees memory that another thread allocated.
+    std::ptrdiff_t bytes_in_use() const
+    {
+        if (!tracks_bytes)
+            return 0;
+        else if (size)
+            return (std::ptrdiff_t(allocations) - std::ptrdiff_t(deallocations))
+                * std::ptrdiff_t(size);
+        else
+            return std::ptrdiff_t(bytes_allocated)
+                - std::ptrdiff_t(bytes_deallocated);
+    }
+
+    //! Memory kept in the free list of a heap of fixed `size`.
+    std::ptrdiff_t bytes_parked() const
+    { return parked * std::ptrdiff_t(size); }
+};
+
+#if IMMER_HEAP_STATS
+
+namespace detail {
+
+inline const char* heap_kind_name(heap_kind k)
+{
+    switch (k) {
+    case heap_kind::malloc:                 return "malloc_heap";
+    case heap_kind::gc:                     return "gc_heap";
+    case heap_kind::free_list:              return "free_list_heap";
+    case heap_kind::thread_local_free_list: return "thread_local_free_list_heap";
+    case heap_kind::unsafe_free_list:       return "unsafe_free_list_heap";
+    }
+    IMMER_UNREACHABLE;
+}
+
+// Counters are only written by their own thread, but they may be
+// read concurrently by `heap_stats_snapshot()`, so they are atomics
+// that are updated without read-modify-write operations.  The
+// `shared` block of finished threads is the exception: it is written
+// by every thread that uses a heap after its own block was retired,
+// so it is updated with `fetch_add`.
+struct heap_stats_block
+{
+    heap_kind kind;
+    std::size_t size;
+    std::thread::id thread;
+
+    std::atomic<std::size_t> allocations     {0};
+    std::atomic<std::size_t> deallocations   {0};
+    std::atomic<std::size_t> hits            {0};
+    std::atomic<std::size_t> misses          {0};
+    std::atomic<std::size_t> bytes_allocated {0};
+    std::atomic<std::size_t> parked          {0};
+    std::atomic<std::size_t> bytes_deallocated {0};
+
+    bool shared;
+    heap_stats_block* prev = nullptr;
+    heap_stats_block* next = nullptr;
+
+    heap_stats_block(heap_kind k, std::size_t s, std::thread::id t,
+                     bool sh = false)
+        : kind{k}, size{s}, thread{t}, shared{sh}
+    {}
+
+    void add(std::atomic<std::size_t>& c, std::size_t n)
+    {
+        if (IMMER_UNLIKELY(shared))
+            c.fetch_add(n, std::memory_order_relaxed);
+        else
+            c.store(c.load(std::memory_order_relaxed) + n,
+                    std::memory_order_relaxed);
+    }
+
+    void add_to(heap_stats_block& other) const
+    {
+        other.add(other.allocations, allocations.load(std::memory_order_relaxed));
+        other.add(other.deallocations, deallocations.load(std::memory_order_relaxed));
+        other.add(other.hits, hits.load(std::memory_order_relaxed));
+        other.add(other.misses, misses.load(std::memory_order_relaxed));
+        other.add(other.bytes_allocated, bytes_allocated.load(std::memory_order_relaxed));
+        other.add(other.parked, parked.load(std::memory_order_relaxed));
+        other.add(other.bytes_deallocated,
+                  bytes_deallocated.load(std::memory_order_relaxed));
+    }
+
+    heap_stats get() const
+    {
+        return {
+            heap_kind_name(kind),
+            size,
+            thread,
+            allocations.load(std::memory_order_relaxed),
+            deallocations.load(std::memory_order_relaxed),
+            hits.load(std::memory_order_relaxed),
+            misses.load(std::memory_order_relaxed),
+            bytes_allocated.load(std::memory_order_relaxed),
+            std::ptrdiff_t(parked.load(std::memory_order_relaxed)),
+            bytes_deallocated.load(std::memory_order_relaxed),
+            kind != heap_kind::gc,
+        };
+    }
+};
+
+template <typename Dummy=void>
+struct heap_stats_registry
+{
+    static std::mutex mutex;
+    static heap_stats_block* blocks;
+
+    // must be called with the mutex locked
+    static void link(heap_stats_block* b)
+    {
+        b->next = blocks;
+        if (blocks)
+            blocks->prev = b;
+        blocks = b;
+    }
+
+    static void unlink(heap_stats_block* b)
+    {
+        if (b->prev)
+            b->prev->next = b->next;
+        else
+            blocks = b->next;
+        if (b->next)
+            b->next->prev = b->prev;
+    }
+};
+
+template <typename D>
+std::mutex heap_stats_registry<D>::mutex;
+template <typename D>
+heap_stats_block* heap_stats_registry<D>::blocks = nullptr;
+
+/*!
+ * Records the activity of the heap `Heap`.  Every thread gets its
+ * own block of counters, which is folded into a shared one when the
+ * thread finishes.
+ */
+template <typename Heap, heap_kind Kind, std::size_t Size>
+struct heap_stats_recorder
+{
+    static void allocate(std::size_t size, bool hit, std::size_t n = 1)
+    {
+        auto& b = local();
+        b.add(b.allocations, n);
+        b.add(hit ? b.hits : b.misses, n);
+        b.add(b.bytes_allocated, size * n);
+    }
+
+    static void allocate(std::size_t size)
+    {
+        auto& b = local();
+        b.add(b.allocations, 1);
+        b.add(b.bytes_allocated, size);
+    }
+
+    static void deallocate(std::size_t n = 1)
+    {
+        auto& b = local();
+        b.add(b.deallocations, n);
+    }
+
+    static void deallocate_bytes(std::size_t size)
+    {
+        auto& b = local();
+        b.add(b.deallocations, 1);
+        b.add(b.bytes_deallocated, size);
+    }
+
+    static void park(std::ptrdiff_t n)
+    {
+        auto& b = local();
+        b.add(b.parked, std::size_t(n));
+    }
+
+private:
+    using reg = heap_stats_registry<>;
+
+    // The block of a thread is retired by the destructor of a
+    // `thread_local` object.  Other `thread_local` destructors, like
+    // the ones of free lists, may still use the heap afterwards, so
+    // the block pointer itself is trivially destructible and it is
+    // redirected to the shared block of finished threads.
+    struct retirer
+    {
+        heap_stats_block** block;
+
+        ~retirer()
+        {
+            std::lock_guard<std::mutex> lock{reg::mutex};
+            reg::unlink(*block);
+            (*block)->add_to(finished());
+            delete *block;
+            *block = &finished();
+        }
+    };
+
+    static heap_stats_block& finished()
+    {
+        // leaked on purpose, it must outlive every thread
+        static auto b = [] {
+            auto b = new heap_stats_block{Kind, Size, {}, true};
+            reg::link(b);
+            return b;
+        }();
+        return *b;
+    }
+
+    static heap_stats_block& local()
+    {
+        thread_local heap_stats_block* b = nullptr;
+        if (IMMER_UNLIKELY(!b)) {
+            b = new heap_stats_block{Kind, Size, std::this_thread::get_id()};
+            {
+                std::lock_guard<std::mutex> lock{reg::mutex};
+                reg::link(b);
+            }
+            thread_local retirer r{&b};
+        }
+        return *b;
+    }
+};
+
+} // namespace detail
+
+#endif // IMMER_HEAP_STATS
+
+/*!
+ * Returns the counters of every heap layer that has been used by
+ * every thread so far.  The counters of the threads that have
+ * finished are accumulated in one entry per heap layer.  Returns an
+ * empty vector unless `IMMER_HEAP_STATS` is defined to `1`.
+ */
+inline std::vector<heap_stats> heap_stats_snapshot()
+{
+    auto result = std::vector<heap_stats>{};
+#if IMMER_HEAP_STATS
+    using reg = detail::heap_stats_registry<>;
+    std::lock_guard<std::mutex> lock{reg::mutex};
+    for (auto b = reg::blocks; b; b = b->next)
+        result.push_back(b->get());
+#endif
+    return result;
+}
+
+} // namespace immer
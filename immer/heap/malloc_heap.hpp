@@ -20,6 +20,13 @@
 
 #pragma once
 
+#include <immer/config.hpp>
+
+#if IMMER_HEAP_STATS
+#include <immer/heap/heap_stats.hpp>
+#endif
+
+#include <cstddef>
 #include <cstdlib>
 
 namespace immer {
@@ -36,7 +43,16 @@ struct malloc_heap
     template <typename... Tags>
     static void* allocate(std::size_t size, Tags...)
     {
+#if IMMER_HEAP_STATS
+        auto p = static_cast<char*>(std::malloc(size + stats_header));
+        if (!p)
+            return nullptr;
+        stats::allocate(size);
+        *reinterpret_cast<std::size_t*>(p) = size;
+        return p + stats_header;
+#else
         return std::malloc(size);
+#endif
     }
 
     /*!
@@ -46,8 +62,26 @@ struct malloc_heap
      */
     static void deallocate(void* data)
     {
+#if IMMER_HEAP_STATS
+        if (!data)
+            return;
+        auto p = static_cast<char*>(data) - stats_header;
+        stats::deallocate_bytes(*reinterpret_cast<std::size_t*>(p));
+        std::free(p);
+#else
         std::free(data);
+#endif
     }
+
+#if IMMER_HEAP_STATS
+private:
+    using stats = detail::heap_stats_recorder<
+        malloc_heap, detail::heap_kind::malloc>;
+
+    // with statistics enabled the size of every object is stored in
+    // front of it, so the bytes in use can be known
+    static constexpr std::size_t stats_header = alignof(std::max_align_t);
+#endif
 };
 
 } // namespace immer
@@ -0,0 +1,138 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <immer/heap/free_list_node.hpp>
+
+#include <cassert>
+#include <cstddef>
+
+namespace immer {
+
+namespace detail {
+
+// The free lists below us only use the header word while a block is
+// sitting in one of them, so live blocks reuse it to remember which
+// class they were allocated from.
+union size_class_header
+{
+    free_list_node node;
+    std::size_t size_class;
+};
+
+template <template <std::size_t> class ClassHeap, std::size_t... Sizes>
+struct size_class_dispatch;
+
+template <template <std::size_t> class ClassHeap>
+struct size_class_dispatch<ClassHeap>
+{
+    static void* allocate(std::size_t, std::size_t)
+    {
+        assert(!"size class out of range");
+        return nullptr;
+    }
+
+    static void deallocate(std::size_t, void*)
+    {
+        assert(!"size class out of range");
+    }
+};
+
+template <template <std::size_t> class ClassHeap,
+          std::size_t Size, std::size_t... Sizes>
+struct size_class_dispatch<ClassHeap, Size, Sizes...>
+{
+    using next_t = size_class_dispatch<ClassHeap, Sizes...>;
+
+    static void* allocate(std::size_t cls, std::size_t size)
+    {
+        return cls == 0
+            ? ClassHeap<Size>::allocate(size)
+            : next_t::allocate(cls - 1, size);
+    }
+
+    static void deallocate(std::size_t cls, void* data)
+    {
+        if (cls == 0)
+            ClassHeap<Size>::deallocate(data);
+        else
+            next_t::deallocate(cls - 1, data);
+    }
+};
+
+} // namespace detail
+
+/*!
+ * Heap that serves every allocation from the smallest of `Sizes`
+ * that fits it, using a different `ClassHeap<Size>` for each of
+ * them.  The size class is remembered in a header in front of the
+ * returned region, which the class heaps can use as a
+ * `free_list_node` once the object has been deallocated.
+ *
+ * @tparam ClassHeap Template of the heap for objects of a given
+ *         maximum size, like a @ref thread_local_free_list_heap.
+ * @tparam Sizes Maximum sizes of the objects to be allocated.
+ *         Requesting an object bigger than all of them triggers
+ *         *undefined behavior*.
+ */
+template <template <std::size_t> class ClassHeap, std::size_t... Sizes>
+struct size_class_heap
+{
+    using header_t = detail::size_class_header;
+    using dispatch_t = detail::size_class_dispatch<ClassHeap, Sizes...>;
+
+    template <typename... Tags>
+    static void* allocate(std::size_t size, Tags...)
+    {
+        auto cls = size_class(size);
+        auto p = static_cast<header_t*>(
+            dispatch_t::allocate(cls, size + sizeof(header_t)));
+        if (!p)
+            return nullptr;
+        p->size_class = cls;
+        return p + 1;
+    }
+
+    template <typename... Tags>
+    static void deallocate(void* data, Tags...)
+    {
+        auto p = static_cast<header_t*>(data) - 1;
+        dispatch_t::deallocate(p->size_class, p);
+    }
+
+    /*!
+     * Returns the index in `Sizes` of the smallest class that can
+     * hold an object of `size` bytes.
+     */
+    static constexpr std::size_t size_class(std::size_t size)
+    {
+        constexpr std::size_t sizes[] = { Sizes... };
+        auto best = sizeof...(Sizes);
+        for (auto i = std::size_t{}; i < sizeof...(Sizes); ++i)
+            if (sizes[i] >= size &&
+                (best == sizeof...(Sizes) || sizes[i] < sizes[best]))
+                best = i;
+        assert(best < sizeof...(Sizes));
+        return best;
+    }
+};
+
+} // namespace immer
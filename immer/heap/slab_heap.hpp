@@ -0,0 +1,297 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <immer/heap/free_list_node.hpp>
+#include <immer/config.hpp>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#else
+#error "The slab heap requires mmap"
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+
+namespace immer {
+
+/*!
+ * A heap that carves blocks of the same size out of big *slabs* of
+ * memory obtained directly with `mmap`, as an alternative to the @ref
+ * malloc_heap.  Slabs are aligned to their size and, on systems that
+ * support it, they are marked with `MADV_HUGEPAGE`, so that they can
+ * be backed by huge pages.  This way the nodes of a big container
+ * are packed together and accessing them randomly requires fewer TLB
+ * entries.
+ *
+ * Every slab serves only objects of one size.  Objects bigger than
+ * an eighth of a slab get a region of their own.  Slabs that become
+ * empty are returned to the system, except for the last one of each
+ * size.  Every size has its own lock, so threads allocating nodes of
+ * different types do not contend, but threads allocating nodes of
+ * the same size do.  This heap is thus best used as the base of a
+ * free list heap, for example, with a
+ * `free_list_heap_policy<slab_heap<>>`.
+ *
+ * @tparam SlabSize Size of each slab, it must be a power of two and
+ *         a multiple of the page size.  By default it is 2 MiB, the
+ *         size of a huge page on x86-64.
+ */
+template <std::size_t SlabSize = std::size_t{1} << 21>
+struct slab_heap
+{
+    static_assert((SlabSize & (SlabSize - 1)) == 0,
+                  "the slab size must be a power of two");
+
+    template <typename... Tags>
+    static void* allocate(std::size_t size, Tags...)
+    {
+        size = round_up(size, alignof(std::max_align_t));
+        if (size > max_block_size)
+            return allocate_large(size);
+        auto c = size_class(size);
+        if (!c)
+            return nullptr;
+        std::lock_guard<std::mutex> lock{c->mutex};
+        auto s = c->partial;
+        if (!s && !(s = make_slab(c)))
+            return nullptr;
+        void* p;
+        if (s->free) {
+            p = s->free;
+            s->free = s->free->next;
+        } else {
+            p = s->bump;
+            s->bump += size;
+        }
+        ++s->live;
+        if (!s->free && std::size_t(s->end - s->bump) < size)
+            unlink(s);
+        return p;
+    }
+
+    static void deallocate(void* data)
+    {
+        auto s = header(data);
+        if (!s->size_class) {
+            release(s);
+            return;
+        }
+        std::lock_guard<std::mutex> lock{s->size_class->mutex};
+        auto n = static_cast<free_list_node*>(data);
+        n->next = s->free;
+        s->free = n;
+        --s->live;
+        if (!s->listed)
+            link(s);
+        else if (!s->live && (s->next || s->prev)) {
+            unlink(s);
+            release(s);
+        }
+    }
+
+    /*!
+     * Returns the number of slabs currently held by the heap,
+     * including the regions of big objects.
+     */
+    static std::size_t slab_count()
+    {
+        return state_.slabs.load(std::memory_order_relaxed);
+    }
+
+    /*!
+     * Returns the number of bytes currently mapped by the heap.
+     */
+    static std::size_t mapped_bytes()
+    {
+        return state_.bytes.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct slab_t;
+
+    // Size classes are created on demand and never freed, they form
+    // a list that is only ever pushed to, so they can be looked up
+    // without taking any lock.
+    struct class_t
+    {
+        std::size_t block_size;
+        class_t* next;
+        std::mutex mutex;
+        slab_t* partial;
+    };
+
+    // Lives at the beginning of every slab.  Slabs that still have
+    // room are kept in a list per size class.
+    struct slab_t
+    {
+        class_t* size_class;
+        std::size_t mapped_size;
+        slab_t* next;
+        slab_t* prev;
+        bool listed;
+        free_list_node* free;
+        char* bump;
+        char* end;
+        std::size_t live;
+    };
+
+    struct state_t
+    {
+        std::mutex mutex;
+        std::atomic<class_t*> classes;
+        std::atomic<std::size_t> slabs;
+        std::atomic<std::size_t> bytes;
+    };
+
+    static constexpr std::size_t round_up(std::size_t n, std::size_t a)
+    { return (n + a - 1) / a * a; }
+
+    static constexpr auto header_size =
+        round_up(sizeof(slab_t), alignof(std::max_align_t));
+    static constexpr auto max_block_size = SlabSize / 8;
+
+    static slab_t* header(void* data)
+    {
+        return reinterpret_cast<slab_t*>(
+            reinterpret_cast<std::uintptr_t>(data) & ~(SlabSize - 1));
+    }
+
+    static class_t* find_class(class_t* c, std::size_t size)
+    {
+        for (; c; c = c->next)
+            if (c->block_size == size)
+                return c;
+        return nullptr;
+    }
+
+    static class_t* size_class(std::size_t size)
+    {
+        auto head = state_.classes.load(std::memory_order_acquire);
+        if (auto c = find_class(head, size))
+            return c;
+        std::lock_guard<std::mutex> lock{state_.mutex};
+        head = state_.classes.load(std::memory_order_acquire);
+        if (auto c = find_class(head, size))
+            return c;
+        auto mem = std::malloc(sizeof(class_t));
+        if (!mem)
+            return nullptr;
+        auto c = new (mem) class_t;
+        c->block_size = size;
+        c->next = head;
+        c->partial = nullptr;
+        state_.classes.store(c, std::memory_order_release);
+        return c;
+    }
+
+    // Maps `size` bytes aligned to `SlabSize`, by mapping a bit more
+    // and unmapping the excess at both ends.
+    static slab_t* map(std::size_t size)
+    {
+        auto total = size + SlabSize;
+        auto p = ::mmap(nullptr, total, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            return nullptr;
+        auto base = reinterpret_cast<std::uintptr_t>(p);
+        auto aligned = round_up(base, SlabSize);
+        if (aligned > base)
+            ::munmap(p, aligned - base);
+        if (aligned + size < base + total)
+            ::munmap(reinterpret_cast<void*>(aligned + size),
+                     base + total - aligned - size);
+#ifdef MADV_HUGEPAGE
+        ::madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE);
+#endif
+        auto s = reinterpret_cast<slab_t*>(aligned);
+        s->mapped_size = size;
+        state_.slabs.fetch_add(1, std::memory_order_relaxed);
+        state_.bytes.fetch_add(size, std::memory_order_relaxed);
+        return s;
+    }
+
+    static void release(slab_t* s)
+    {
+        state_.slabs.fetch_sub(1, std::memory_order_relaxed);
+        state_.bytes.fetch_sub(s->mapped_size, std::memory_order_relaxed);
+        ::munmap(s, s->mapped_size);
+    }
+
+    static slab_t* make_slab(class_t* c)
+    {
+        auto s = map(SlabSize);
+        if (!s)
+            return nullptr;
+        auto data = reinterpret_cast<char*>(s) + header_size;
+        s->size_class = c;
+        s->listed = false;
+        s->free   = nullptr;
+        s->bump   = data;
+        s->end    = reinterpret_cast<char*>(s) + SlabSize;
+        s->live   = 0;
+        link(s);
+        return s;
+    }
+
+    static void* allocate_large(std::size_t size)
+    {
+        auto s = map(round_up(header_size + size, SlabSize));
+        if (!s)
+            return nullptr;
+        s->size_class = nullptr;
+        return reinterpret_cast<char*>(s) + header_size;
+    }
+
+    static void link(slab_t* s)
+    {
+        auto& head = s->size_class->partial;
+        s->prev = nullptr;
+        s->next = head;
+        if (head)
+            head->prev = s;
+        head = s;
+        s->listed = true;
+    }
+
+    static void unlink(slab_t* s)
+    {
+        if (s->prev)
+            s->prev->next = s->next;
+        else
+            s->size_class->partial = s->next;
+        if (s->next)
+            s->next->prev = s->prev;
+        s->listed = false;
+    }
+
+    static state_t state_;
+};
+
+template <std::size_t S>
+typename slab_heap<S>::state_t slab_heap<S>::state_ {};
+
+} // namespace immer
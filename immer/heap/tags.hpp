@@ -20,8 +20,30 @@
 
 #pragma once
 
+#include <type_traits>
+
 namespace immer {
 
+/*!
+ * Tag passed to the heap when allocating memory that never contains
+ * pointers to other allocated objects, so a tracing garbage collector
+ * does not need to scan it.
+ */
 struct norefs_tag {};
 
+/*!
+ * Metafunction that returns whether values of type `T` contain no
+ * pointers to heap allocated memory.  Containers allocate the chunks
+ * that only hold such values with a @ref norefs_tag, so a @ref
+ * gc_heap does not scan them.  By default only arithmetic and
+ * enumeration types are pointer free, but it can be specialized for
+ * user defined types, like a `struct` with a few `double` members.
+ */
+template <typename T>
+struct is_pointer_free
+    : std::integral_constant<bool,
+                             std::is_arithmetic<T>::value ||
+                             std::is_enum<T>::value>
+{};
+
 } // namespace immer
@@ -21,12 +21,60 @@
 #pragma once
 
 #include <immer/config.hpp>
+#include <immer/detail/util.hpp>
+#include <immer/heap/free_list_budget.hpp>
 #include <immer/heap/free_list_node.hpp>
+
+#if IMMER_HEAP_STATS
+#include <immer/heap/heap_stats.hpp>
+#else
+#include <immer/detail/heap_stats_recorder.hpp>
+#endif
+
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <initializer_list>
+#include <utility>
 
 namespace immer {
 namespace detail {
 
+/*!
+ * Exchanges batches of objects with a heap that supports it, like
+ * the @ref free_list_heap, or one object at a time with any other
+ * heap.
+ */
+template <typename Heap, typename Enable=void>
+struct free_list_batches
+{
+    static free_list_node* allocate(std::size_t& count)
+    {
+        count = 0;
+        return nullptr;
+    }
+
+    static void deallocate(free_list_node* n, std::size_t)
+    {
+        while (n) {
+            auto next = n->next;
+            Heap::deallocate(n);
+            n = next;
+        }
+    }
+};
+
+template <typename Heap>
+struct free_list_batches<
+    Heap, void_t<decltype(Heap::deallocate_batch(nullptr, 0))>>
+{
+    static free_list_node* allocate(std::size_t& count)
+    { return Heap::allocate_batch(count); }
+
+    static void deallocate(free_list_node* n, std::size_t count)
+    { Heap::deallocate_batch(n, count); }
+};
+
 template <typename Heap>
 struct unsafe_free_list_storage
 {
@@ -34,6 +82,7 @@ struct unsafe_free_list_storage
     {
         free_list_node* data;
         std::size_t count;
+        std::size_t reserved;
     };
 
     static head_t head;
@@ -41,33 +90,190 @@ struct unsafe_free_list_storage
 
 template <typename Heap>
 typename unsafe_free_list_storage<Heap>::head_t
-unsafe_free_list_storage<Heap>::head {nullptr, 0};
+unsafe_free_list_storage<Heap>::head {nullptr, 0, 0};
+
+template <template<class>class Storage,
+          std::size_t Size,
+          std::size_t Limit,
+          typename Base>
+class unsafe_free_list_heap_impl : Base
+{
+    using storage = Storage<unsafe_free_list_heap_impl>;
+    using stats = heap_stats_recorder<
+        unsafe_free_list_heap_impl, heap_kind::unsafe_free_list, Size>;
+
+    static constexpr auto block_size = Size + sizeof(free_list_node);
+
+    // The budget is reserved for this many nodes at a time, so the
+    // global counter is only touched once every so many calls.
+    static constexpr std::size_t reserve_batch = Limit < 32 ? Limit : 32;
+
+public:
+    using base_t = Base;
+
+    template <typename... Tags>
+    static void* allocate(std::size_t size, Tags...)
+    {
+        assert(size <= sizeof(free_list_node) + Size);
+        assert(size >= sizeof(free_list_node));
+
+        auto& h = storage::head;
+        auto n = h.data;
+        stats::allocate(size, n != nullptr);
+        if (!n) {
+            auto p = base_t::allocate(block_size);
+            return static_cast<free_list_node*>(p);
+        }
+        --h.count;
+        h.data = n->next;
+        if (IMMER_UNLIKELY(h.reserved - h.count >= 2 * reserve_batch))
+            unreserve(reserve_batch);
+        stats::park(-1);
+        return n;
+    }
+
+    template <typename... Tags>
+    static void deallocate(void* data, Tags...)
+    {
+        stats::deallocate();
+        auto& h = storage::head;
+        if (h.count >= Limit || (h.count == h.reserved && !reserve()))
+            base_t::deallocate(data);
+        else {
+            auto n = static_cast<free_list_node*>(data);
+            n->next = h.data;
+            h.data = n;
+            ++h.count;
+            stats::park(1);
+        }
+    }
+
+    static void clear()
+    {
+        auto& h = storage::head;
+        while (h.data) {
+            auto n = h.data->next;
+            base_t::deallocate(h.data);
+            h.data = n;
+            --h.count;
+            stats::park(-1);
+        }
+        unreserve(h.reserved);
+    }
+
+private:
+    // Charges the global budget for some more nodes, a whole batch
+    // when it fits or a single node otherwise.
+    static bool reserve()
+    {
+        static free_list_registration registration {
+            free_list_registration::global, &clear };
+        auto& h = storage::head;
+        auto n = std::min(reserve_batch, Limit - h.reserved);
+        if (!free_list_budget_acquire(n * block_size)) {
+            if (n == 1 || !free_list_budget_acquire(block_size))
+                return false;
+            n = 1;
+        }
+        h.reserved += n;
+        return true;
+    }
+
+    static void unreserve(std::size_t n)
+    {
+        if (n) {
+            storage::head.reserved -= n;
+            free_list_budget_release(n * block_size);
+        }
+    }
+};
+
+template <template<class>class St, std::size_t S, std::size_t L, typename B>
+constexpr std::size_t unsafe_free_list_heap_impl<St, S, L, B>::reserve_batch;
+
+/*!
+ * Slot where a thread keeps a magazine that other threads may take
+ * away from it, with an atomic exchange.  Slots are never freed: when
+ * its thread finishes, a slot is left for another thread to reuse.
+ */
+struct free_list_handoff
+{
+    std::atomic<free_list_node*> data;
+    std::atomic<bool> busy;
+    free_list_handoff* next;
+
+    free_list_handoff(free_list_handoff* n)
+        : data{nullptr}, busy{true}, next{n}
+    {}
+};
 
 template <typename Heap>
 struct thread_local_free_list_storage
 {
-    struct head_t
+    struct magazine_t
     {
         free_list_node* data;
         std::size_t count;
+    };
+
+    struct head_t
+    {
+        magazine_t loaded;
+        magazine_t previous;
+        std::size_t epoch;
+        free_list_handoff* handoff;
 
-        ~head_t() { Heap::clear(); }
+        ~head_t()
+        {
+            Heap::clear();
+            if (handoff)
+                handoff->busy.store(false, std::memory_order_release);
+        }
     };
 
     thread_local static head_t head;
+    static std::atomic<free_list_handoff*> handoffs;
 };
 
 template <typename Heap>
 thread_local typename thread_local_free_list_storage<Heap>::head_t
-thread_local_free_list_storage<Heap>::head {nullptr, 0};
+thread_local_free_list_storage<Heap>::head {{nullptr, 0}, {nullptr, 0}, 0, nullptr};
 
-template <template<class>class Storage,
-          std::size_t Size,
+template <typename Heap>
+std::atomic<free_list_handoff*>
+thread_local_free_list_storage<Heap>::handoffs {nullptr};
+
+/*!
+ * Per thread cache of objects organized as two *magazines*, as
+ * described in Bonwick and Adams' paper `Magazines and Vmem`.  Objects
+ * are taken from and returned to the `loaded` magazine.  When it is
+ * full or empty, it is swapped with the `previous` one, and only when
+ * that does not help a whole magazine is exchanged with the parent
+ * heap.  This hysteresis avoids going to the parent heap repeatedly
+ * when the number of live objects oscillates around a magazine
+ * boundary.
+ *
+ * When `ReleaseIdle` is true, the `previous` magazine is kept in a
+ * @ref free_list_handoff, so that @ref trim_free_lists can empty it
+ * from any thread.  The `loaded` magazine is only emptied by its own
+ * thread, the next time it uses the heap.
+ */
+template <std::size_t Size,
           std::size_t Limit,
+          bool ReleaseIdle,
           typename Base>
-class unsafe_free_list_heap_impl : Base
+class thread_local_free_list_heap_impl : Base
 {
-    using storage = Storage<unsafe_free_list_heap_impl>;
+    using storage = thread_local_free_list_storage<
+        thread_local_free_list_heap_impl>;
+    using batches = free_list_batches<Base>;
+    using stats = heap_stats_recorder<
+        thread_local_free_list_heap_impl,
+        heap_kind::thread_local_free_list,
+        Size>;
+
+    static constexpr auto block_size = Size + sizeof(free_list_node);
+    static constexpr auto magazine_size = Limit > 1 ? Limit / 2 : 1;
 
 public:
     using base_t = Base;
@@ -78,36 +284,155 @@ public:
         assert(size <= sizeof(free_list_node) + Size);
         assert(size >= sizeof(free_list_node));
 
-        auto n = storage::head.data;
-        if (!n) {
-            auto p = base_t::allocate(Size + sizeof(free_list_node));
-            return static_cast<free_list_node*>(p);
+        release_if_idle();
+        auto& h = storage::head;
+        if (!h.loaded.count) {
+            load_previous(h);
+            if (h.previous.count) {
+                std::swap(h.loaded, h.previous);
+            } else {
+                auto n = batches::allocate(h.loaded.count);
+                if (!n) {
+                    stats::allocate(size, false);
+                    return base_t::allocate(block_size);
+                }
+                h.loaded.data = n;
+                stats::park(h.loaded.count);
+                register_trim();
+            }
         }
-        --storage::head.count;
-        storage::head.data = n->next;
+        stats::allocate(size, true);
+        stats::park(-1);
+        auto n = h.loaded.data;
+        h.loaded.data = n->next;
+        --h.loaded.count;
         return n;
     }
 
     template <typename... Tags>
     static void deallocate(void* data, Tags...)
     {
-        if (storage::head.count >= Limit)
-            base_t::deallocate(data);
-        else {
-            auto n = static_cast<free_list_node*>(data);
-            n->next = storage::head.data;
-            storage::head.data = n;
-            ++storage::head.count;
+        release_if_idle();
+        stats::deallocate();
+        stats::park(1);
+        auto& h = storage::head;
+        if (IMMER_UNLIKELY(!h.loaded.count))
+            register_trim();
+        else if (h.loaded.count >= magazine_size) {
+            load_previous(h);
+            if (h.previous.count) {
+                stats::park(-std::ptrdiff_t(h.previous.count));
+                batches::deallocate(h.previous.data, h.previous.count);
+                h.previous = h.loaded;
+                h.loaded = {nullptr, 0};
+            } else {
+                std::swap(h.loaded, h.previous);
+            }
+            store_previous(h);
         }
+        auto n = static_cast<free_list_node*>(data);
+        n->next = h.loaded.data;
+        h.loaded.data = n;
+        ++h.loaded.count;
     }
 
     static void clear()
     {
-        while (storage::head.data) {
-            auto n = storage::head.data->next;
-            base_t::deallocate(storage::head.data);
-            storage::head.data = n;
-            --storage::head.count;
+        auto& h = storage::head;
+        load_previous(h);
+        for (auto m : { &h.loaded, &h.previous }) {
+            if (m->count) {
+                stats::park(-std::ptrdiff_t(m->count));
+                batches::deallocate(m->data, m->count);
+            }
+            *m = {nullptr, 0};
+        }
+    }
+
+    /*!
+     * Empties the magazines of the calling thread and the `previous`
+     * magazines of every other thread, when they release idle lists.
+     */
+    static void trim()
+    {
+        clear();
+        if (ReleaseIdle) {
+            auto& l = storage::handoffs;
+            for (auto r = l.load(std::memory_order_acquire); r; r = r->next) {
+                if (auto n = r->data.exchange(nullptr,
+                                              std::memory_order_acquire)) {
+                    auto count = std::size_t{};
+                    for (auto i = n; i; i = i->next)
+                        ++count;
+                    stats::park(-std::ptrdiff_t(count));
+                    batches::deallocate(n, count);
+                }
+            }
+        }
+    }
+
+private:
+    using head_t = typename storage::head_t;
+
+    // Memory only gets into the magazines of a thread through an
+    // empty `loaded` magazine, so registering there is enough for
+    // @ref trim_free_lists to find it, and keeps the guard of the
+    // static out of the common path.
+    static void register_trim()
+    {
+        static free_list_registration registration {
+            free_list_registration::local, &trim };
+    }
+
+    // Takes the previous magazine back from the hand-off slot, where
+    // it may have been emptied by another thread in the meantime.
+    static void load_previous(head_t& h)
+    {
+        if (ReleaseIdle && h.previous.count) {
+            h.previous.data = h.handoff->data.exchange(
+                nullptr, std::memory_order_acquire);
+            if (!h.previous.data)
+                h.previous.count = 0;
+        }
+    }
+
+    static void store_previous(head_t& h)
+    {
+        if (ReleaseIdle && h.previous.count) {
+            if (!h.handoff)
+                h.handoff = acquire_handoff();
+            h.handoff->data.store(h.previous.data, std::memory_order_release);
+            h.previous.data = nullptr;
+        }
+    }
+
+    static free_list_handoff* acquire_handoff()
+    {
+        auto& l = storage::handoffs;
+        for (auto r = l.load(std::memory_order_acquire); r; r = r->next) {
+            auto busy = false;
+            if (!r->busy.load(std::memory_order_relaxed) &&
+                r->busy.compare_exchange_strong(busy, true,
+                                                std::memory_order_acquire,
+                                                std::memory_order_relaxed))
+                return r;
+        }
+        // never deleted, it is reused when this thread finishes
+        auto r = new free_list_handoff{l.load(std::memory_order_relaxed)};
+        while (!l.compare_exchange_weak(r->next, r,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed));
+        return r;
+    }
+
+    static void release_if_idle()
+    {
+        if (ReleaseIdle) {
+            auto epoch = free_list_epoch();
+            if (IMMER_UNLIKELY(storage::head.epoch != epoch)) {
+                clear();
+                storage::head.epoch = epoch;
+            }
         }
     }
 };
@@ -121,15 +446,27 @@ public:
  * adaptor.  When the current thread finishes, the memory is returned
  * to the parent heap.
  *
- * @tparam Size  Maximum size of the objects to be allocated.
- * @tparam Limit Maximum number of elements to keep in the free list.
- * @tparam Base  Type of the parent heap.
+ * The objects are kept in two *magazines* of `Limit / 2` objects.
+ * When the parent heap is a @ref free_list_heap, full magazines are
+ * exchanged with it as a whole, so memory can flow between threads
+ * that allocate and threads that deallocate with one atomic
+ * operation per magazine.
+ *
+ * @tparam Size        Maximum size of the objects to be allocated.
+ * @tparam Limit       Maximum number of elements to keep in the free list.
+ * @tparam Base        Type of the parent heap.
+ * @tparam ReleaseIdle When true, @ref trim_free_lists returns half of
+ *         the free list of every thread to the parent heap, and the
+ *         rest the first time the thread uses it after the trim.
  */
-template <std::size_t Size, std::size_t Limit, typename Base>
-struct thread_local_free_list_heap : detail::unsafe_free_list_heap_impl<
-    detail::thread_local_free_list_storage,
+template <std::size_t Size,
+          std::size_t Limit,
+          typename Base,
+          bool ReleaseIdle = false>
+struct thread_local_free_list_heap : detail::thread_local_free_list_heap_impl<
     Size,
     Limit,
+    ReleaseIdle,
     Base>
 {};
 
@@ -137,7 +474,8 @@ struct thread_local_free_list_heap : detail::unsafe_free_list_heap_impl<
  * Adaptor that does not release the memory to the parent heap but
  * instead it keeps the memory in a global free list that **is not
  * thread-safe**. Must be preceded by a `with_data<free_list_node,
- * ...>` heap adaptor.
+ * ...>` heap adaptor.  Its memory is accounted for in the @ref
+ * free_list_budget, which it reserves in batches of up to 32 objects.
  *
  * @tparam Size  Maximum size of the objects to be allocated.
  * @tparam Limit Maximum number of elements to keep in the free list.
@@ -0,0 +1,248 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <immer/detail/hamts/champ.hpp>
+#include <immer/detail/hamts/champ_iterator.hpp>
+#include <immer/memory_policy.hpp>
+
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
+namespace immer {
+
+/*!
+ * Immutable unordered mapping of values from type `K` to type `T`.
+ *
+ * @tparam K    The type of the keys.
+ * @tparam T    The type of the values to be stored in the container.
+ * @tparam Hash The type of a function object capable of hashing
+ *              values of type `K`.
+ * @tparam Equal The type of a function object capable of comparing
+ *              values of type `K`.
+ * @tparam MemoryPolicy Memory management policy. See @ref
+ *              memory_policy.
+ *
+ * @rst
+ *
+ * This container is implemented as a *hash array mapped trie*, using
+ * the CHAMP encoding: every inner node has up to :math:`2^B`
+ * branches, indexed by :math:`B` bits of the hash of the key, and
+ * stores its values apart from its subtrees.  Only the path to the
+ * modified key is copied on every update, so different versions of
+ * the map share most of their structure, and nodes are allocated
+ * from the same heap as the vectors using the same memory policy.
+ *
+ * The order of the elements when iterating over the map is
+ * unspecified, but it is the same for maps with the same contents
+ * that were built in the same way.
+ *
+ * @endrst
+ */
+template <typename K,
+          typename T,
+          typename Hash           = std::hash<K>,
+          typename Equal          = std::equal_to<K>,
+          typename MemoryPolicy   = default_memory_policy,
+          detail::hamts::bits_t B = default_bits>
+class map
+{
+    using value_t = std::pair<K, T>;
+
+    struct hash_key
+    {
+        auto operator() (const value_t& v) const
+        { return Hash{}(v.first); }
+
+        auto operator() (const K& v) const
+        { return Hash{}(v); }
+    };
+
+    struct equal_key
+    {
+        auto operator() (const value_t& a, const value_t& b) const
+        { return Equal{}(a.first, b.first); }
+
+        auto operator() (const value_t& a, const K& b) const
+        { return Equal{}(a.first, b); }
+    };
+
+    using impl_t = detail::hamts::champ<
+        value_t, hash_key, equal_key, MemoryPolicy, B>;
+
+public:
+    static constexpr auto bits = B;
+    using memory_policy = MemoryPolicy;
+
+    using key_type = K;
+    using mapped_type = T;
+    using value_type = std::pair<K, T>;
+    using size_type = detail::hamts::size_t;
+    using difference_type = std::ptrdiff_t;
+    using hasher = Hash;
+    using key_equal = Equal;
+    using reference = const value_type&;
+    using const_reference = const value_type&;
+
+    using iterator         = detail::hamts::champ_iterator<
+        value_t, hash_key, equal_key, MemoryPolicy, B>;
+    using const_iterator   = iterator;
+
+    /*!
+     * Default constructor.  It creates a map of `size() == 0`.  It
+     * does not allocate memory and its complexity is @f$ O(1) @f$.
+     */
+    map() = default;
+
+    /*!
+     * Returns an iterator pointing at the first element of the
+     * collection. It does not allocate memory and its complexity is
+     * @f$ O(1) @f$.
+     */
+    iterator begin() const { return {impl_}; }
+
+    /*!
+     * Returns an iterator pointing just after the last element of the
+     * collection. It does not allocate and its complexity is @f$ O(1) @f$.
+     */
+    iterator end()   const { return {impl_, typename iterator::end_t{}}; }
+
+    /*!
+     * Returns the number of elements in the container.  It does
+     * not allocate memory and its complexity is @f$ O(1) @f$.
+     */
+    size_type size() const { return impl_.size; }
+
+    /*!
+     * Returns `true` if there are no elements in the container.  It
+     * does not allocate memory and its complexity is @f$ O(1) @f$.
+     */
+    bool empty() const { return impl_.size == 0; }
+
+    /*!
+     * Returns `1` when the key `k` is contained in the map or `0`
+     * otherwise. It won't allocate memory and its complexity is
+     * *effectively* @f$ O(1) @f$.
+     */
+    size_type count(const K& k) const
+    { return impl_.get(k) ? 1 : 0; }
+
+    /*!
+     * Returns a pointer to the value associated with the key `k`, or
+     * `nullptr` when the key is not contained in the map.  It does
+     * not allocate memory and its complexity is *effectively*
+     * @f$ O(1) @f$.
+     */
+    const T* find(const K& k) const
+    {
+        auto p = impl_.get(k);
+        return p ? &p->second : nullptr;
+    }
+
+    /*!
+     * Returns a `const` reference to the value associated with the
+     * key `k`.  If the key is not contained in the map, it returns a
+     * default constructed value.  It does not allocate memory and its
+     * complexity is *effectively* @f$ O(1) @f$.
+     */
+    const T& operator[] (const K& k) const
+    {
+        if (auto p = find(k))
+            return *p;
+        static const auto default_value = T{};
+        return default_value;
+    }
+
+    /*!
+     * Returns a `const` reference to the value associated with the
+     * key `k`.  If the key is not contained in the map, throws an
+     * `std::out_of_range` error.  It does not allocate memory and its
+     * complexity is *effectively* @f$ O(1) @f$.
+     */
+    const T& at(const K& k) const
+    {
+        if (auto p = find(k))
+            return *p;
+        throw std::out_of_range{"key not found"};
+    }
+
+    /*!
+     * Returns a map containing the association `value`.  If the key
+     * is already in the map, its value is replaced.  It may allocate
+     * memory and its complexity is *effectively* @f$ O(1) @f$.
+     */
+    map insert(value_type value) const
+    { return impl_.add(std::move(value)); }
+
+    /*!
+     * Returns a map containing the association `(k, v)`.  If the key
+     * is already in the map, its value is replaced.  It may allocate
+     * memory and its complexity is *effectively* @f$ O(1) @f$.
+     */
+    map set(key_type k, mapped_type v) const
+    { return impl_.add({ std::move(k), std::move(v) }); }
+
+    /*!
+     * Returns a map replacing the association `(k, v)` by the
+     * association `(k, fn(v))`, where `v` is the currently associated
+     * value for `k` in the map or a default constructed value
+     * otherwise.  It may allocate memory and its complexity is
+     * *effectively* @f$ O(1) @f$.
+     */
+    template <typename Fn>
+    map update(key_type k, Fn&& fn) const
+    {
+        auto p = impl_.get(k);
+        auto v = std::forward<Fn>(fn)(p ? p->second : T{});
+        return impl_.add({ std::move(k), std::move(v) });
+    }
+
+    /*!
+     * Returns a map without the key `k`.  If the key is not
+     * associated in the map it returns the same map.  It may allocate
+     * memory and its complexity is *effectively* @f$ O(1) @f$.
+     */
+    map erase(const K& k) const
+    { return impl_.sub(k); }
+
+    /*!
+     * Apply operation `fn` for every *chunk* of data in the map
+     * sequentially.  Each time, `Fn` is passed two `value_type`
+     * pointers describing a range over a part of the map.  This
+     * allows iterating over the elements in the most efficient way.
+     */
+    template <typename Fn>
+    void for_each_chunk(Fn&& fn) const
+    { impl_.for_each_chunk(std::forward<Fn>(fn)); }
+
+    // Semi-private
+    const impl_t& impl() const { return impl_; }
+
+private:
+    map(impl_t impl)
+        : impl_(std::move(impl))
+    {}
+
+    impl_t impl_ = impl_t::empty;
+};
+
+} // namespace immer
@@ -0,0 +1,406 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <immer/vector.hpp>
+#include <immer/detail/rbts/position.hpp>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#error "The mapped vector requires mmap"
+#endif
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace immer {
+
+/*!
+ * Thrown when mapping a file that is malformed or that was not
+ * written for the same type of vector.
+ */
+struct mapped_error : std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
+
+namespace detail {
+namespace rbts {
+
+// A mapped file contains a header followed by the nodes, laid out
+// exactly as they are in memory, and a table with the offsets of the
+// child pointers of the inner nodes.  The pointers are written as
+// offsets from the start of the file and fixed up when it is mapped.
+// The nodes are written after their children, so the root comes last.
+constexpr char mapped_magic[8] = { 'i','m','m','e','r','m','a','p' };
+constexpr std::uint32_t mapped_format = 1;
+constexpr std::size_t mapped_align = 64;
+
+template <typename NodeT>
+struct mapped_header
+{
+    char          magic[8];
+    std::uint32_t format;
+    std::uint32_t value_size;
+    std::uint8_t  bits;
+    std::uint8_t  bits_leaf;
+    std::uint16_t node_align;
+    std::uint32_t leaf_header;
+    std::uint32_t inner_header;
+    std::uint32_t shift;
+    std::uint64_t size;
+    std::uint64_t root;
+    std::uint64_t tail;
+    std::uint64_t relocs;
+    std::uint64_t relocs_count;
+
+    static mapped_header make()
+    {
+        auto h = mapped_header{};
+        std::memcpy(h.magic, mapped_magic, sizeof(mapped_magic));
+        h.format       = mapped_format;
+        h.value_size   = sizeof(typename NodeT::value_t);
+        h.bits         = NodeT::bits;
+        h.bits_leaf    = NodeT::bits_leaf;
+        h.node_align   = alignof(NodeT);
+        h.leaf_header  = NodeT::sizeof_packed_leaf_n(0);
+        h.inner_header = NodeT::sizeof_packed_inner_n(0);
+        return h;
+    }
+
+    bool matches(const mapped_header& other) const
+    {
+        return std::memcmp(magic, other.magic, sizeof(magic)) == 0
+            && format == other.format
+            && value_size == other.value_size
+            && bits == other.bits
+            && bits_leaf == other.bits_leaf
+            && node_align == other.node_align
+            && leaf_header == other.leaf_header
+            && inner_header == other.inner_header;
+    }
+};
+
+struct mapped_save_visitor
+{
+    using this_t = mapped_save_visitor;
+
+    template <typename Pos, typename Saver>
+    friend void visit_regular(this_t, Pos&& p, Saver& s)
+    { s.save_inner(p); }
+
+    template <typename Pos, typename Saver>
+    friend void visit_leaf(this_t, Pos&& p, Saver& s)
+    { s.save_leaf(p); }
+};
+
+template <typename NodeT>
+struct mapped_saver
+{
+    using node_t = NodeT;
+    using value_t = typename node_t::value_t;
+
+    static_assert(alignof(node_t) <= mapped_align,
+                  "nodes are written at this alignment");
+
+    std::ostream& out;
+    std::uint64_t offset = 0;
+    std::vector<std::uint64_t> stack = {};
+    std::vector<std::uint64_t> relocs = {};
+
+    void write(const void* p, std::size_t n)
+    {
+        out.write(static_cast<const char*>(p), n);
+        offset += n;
+    }
+
+    void pad()
+    {
+        static const char zeros[mapped_align] = {};
+        write(zeros, (mapped_align - offset % mapped_align) % mapped_align);
+    }
+
+    // The nodes are built with the usual constructors and marked
+    // immortal, so once mapped they are never freed nor mutated in
+    // place, and then written without headroom.  Inner nodes are also
+    // frozen, since the mapping is read-only and they can not cache the
+    // digest of their elements.
+    std::uint64_t write_node(node_t* p, std::size_t n)
+    {
+        node_t::make_immortal(p);
+        pad();
+        auto at = offset;
+        write(p, n);
+        return at;
+    }
+
+    template <typename Pos>
+    void save_leaf(Pos& p)
+    {
+        auto n = p.count();
+        auto node = node_t::make_leaf_n(n);
+        std::memcpy(static_cast<void*>(node->leaf()), p.node()->leaf(),
+                    n * sizeof(value_t));
+        auto at = write_node(node, node_t::sizeof_packed_leaf_n(n));
+        node_t::delete_leaf(node, n);
+        stack.push_back(at);
+    }
+
+    template <typename Pos>
+    void save_inner(Pos& p)
+    {
+        auto first = stack.size();
+        p.each(mapped_save_visitor{}, *this);
+        auto n = static_cast<count_t>(stack.size() - first);
+        auto node = node_t::make_inner_n(n);
+        node->freeze_digest();
+        auto slots = node->inner();
+        for (auto i = count_t{}; i < n; ++i)
+            slots[i] = reinterpret_cast<node_t*>(
+                static_cast<std::uintptr_t>(stack[first + i]));
+        auto at = write_node(node, node_t::sizeof_packed_inner_n(n));
+        auto slot0 = reinterpret_cast<char*>(slots)
+            - reinterpret_cast<char*>(node);
+        for (auto i = count_t{}; i < n; ++i)
+            relocs.push_back(at + slot0 + i * sizeof(node_t*));
+        node_t::delete_inner(node);
+        stack.resize(first);
+        stack.push_back(at);
+    }
+
+    template <typename Tree>
+    void save(const Tree& t)
+    {
+        using header_t = mapped_header<node_t>;
+        auto start = out.tellp();
+        auto h = header_t::make();
+        write(&h, sizeof(h));
+
+        t.traverse(mapped_save_visitor{}, *this);
+        assert(stack.size() == 2);
+        h.root  = stack[0];
+        h.tail  = stack[1];
+        h.size  = t.size;
+        h.shift = t.shift;
+
+        pad();
+        h.relocs = offset;
+        h.relocs_count = relocs.size();
+        write(relocs.data(), relocs.size() * sizeof(std::uint64_t));
+
+        auto end = out.tellp();
+        out.seekp(start);
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        out.seekp(end);
+    }
+};
+
+} // namespace rbts
+} // namespace detail
+
+/*!
+ * Writes the vector `v` to the seekable stream `out` in a format that
+ * can be mapped into memory and used directly with a @ref
+ * mapped_vector, without reading nor copying the elements.  The
+ * values are written as raw bytes, so `T` must be trivially copyable.
+ * The file can only be mapped by a program built for the same
+ * platform and with the same type of vector.
+ */
+template <typename T,
+          typename MemoryPolicy,
+          detail::rbts::bits_t B,
+          detail::rbts::bits_t BL>
+void write_mapped(std::ostream& out,
+                  const vector<T, MemoryPolicy, B, BL>& v)
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "only vectors of trivially copyable values can be mapped");
+    using node_t = typename std::decay_t<decltype(v.impl())>::node_t;
+    detail::rbts::mapped_saver<node_t>{out}.save(v.impl());
+    if (!out)
+        throw mapped_error{"could not write mapped vector"};
+}
+
+/*!
+ * A read-only @ref vector backed by a file written with
+ * `write_mapped()`.  The file is mapped into memory and its nodes are
+ * used in place, so opening it takes time proportional to the number
+ * of inner nodes, which have their child pointers fixed up, and the
+ * leaves are only paged in when they are accessed.
+ *
+ * The vector returned by `get()` behaves like any other: it can be
+ * copied freely and updating it produces new vectors that allocate
+ * the changed paths on the usual heap, sharing the rest with the
+ * file.  The mapped nodes are never freed nor written to.  Thus,
+ * the mapped vector must outlive every vector derived from it.
+ *
+ * @rst
+ *
+ * .. warning:: The file is mapped privately, so writes to it after it
+ *    has been mapped may or may not be seen by the mapped vector.
+ *    It should not be modified while in use.
+ *
+ * @endrst
+ */
+template <typename T,
+          typename MemoryPolicy   = default_memory_policy,
+          detail::rbts::bits_t B  = default_bits,
+          detail::rbts::bits_t BL = detail::rbts::derive_bits_leaf<T, MemoryPolicy, B>>
+class mapped_vector
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "only vectors of trivially copyable values can be mapped");
+
+public:
+    using vector_type = vector<T, MemoryPolicy, B, BL>;
+
+private:
+    using impl_t   = std::decay_t<decltype(std::declval<vector_type>().impl())>;
+    using node_t   = typename impl_t::node_t;
+    using header_t = detail::rbts::mapped_header<node_t>;
+
+public:
+    /*!
+     * Maps the file at `path`.  It throws `std::system_error` when the
+     * file can not be opened, mapped or made read-only, and @ref
+     * mapped_error when it does not contain a vector of this type.
+     */
+    explicit mapped_vector(const std::string& path)
+    {
+        auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::system_error{errno, std::generic_category(), path};
+        struct stat st;
+        if (::fstat(fd, &st) < 0) {
+            auto err = errno;
+            ::close(fd);
+            throw std::system_error{err, std::generic_category(), path};
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        if (size_ < sizeof(header_t)) {
+            ::close(fd);
+            throw mapped_error{"not a mapped vector"};
+        }
+        // The mapping is private and writable so the child pointers can
+        // be fixed up, which only copies the pages with inner nodes.
+        data_ = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE, fd, 0);
+        auto err = errno;
+        ::close(fd);
+        if (data_ == MAP_FAILED)
+            throw std::system_error{err, std::generic_category(), path};
+        try {
+            v_ = vector_type{relocate()};
+        } catch (...) {
+            ::munmap(data_, size_);
+            throw;
+        }
+        if (::mprotect(data_, size_, PROT_READ) < 0) {
+            auto err = errno;
+            v_ = {};
+            ::munmap(data_, size_);
+            throw std::system_error{err, std::generic_category(), path};
+        }
+    }
+
+    mapped_vector(const mapped_vector&) = delete;
+    mapped_vector& operator=(const mapped_vector&) = delete;
+
+    ~mapped_vector()
+    {
+        v_ = {};
+        ::munmap(data_, size_);
+    }
+
+    /*!
+     * Returns the vector stored in the file.
+     */
+    const vector_type& get() const { return v_; }
+
+    operator const vector_type& () const { return v_; }
+
+private:
+    char* base() const { return static_cast<char*>(data_); }
+
+    // Only the structure of the file is checked, not the contents of
+    // the nodes, so files should come from a trusted source.
+    impl_t relocate()
+    {
+        auto h = header_t{};
+        std::memcpy(&h, data_, sizeof(h));
+        if (!h.matches(header_t::make()))
+            throw mapped_error{"mapped vector was written for another type"};
+
+        auto nodes_end = h.relocs;
+        auto is_node = [&] (std::uint64_t off) {
+            return off >= sizeof(header_t)
+                && off < nodes_end
+                && off % detail::rbts::mapped_align == 0;
+        };
+        if (nodes_end > size_
+            || h.relocs_count > (size_ - nodes_end) / sizeof(std::uint64_t)
+            || !is_node(h.root) || !is_node(h.tail)
+            || h.size > std::numeric_limits<detail::rbts::size_t>::max()
+            || h.shift > sizeof(detail::rbts::size_t) * 8)
+            throw mapped_error{"malformed mapped vector"};
+
+        auto relocs = base() + nodes_end;
+        for (auto i = std::uint64_t{}; i < h.relocs_count; ++i) {
+            auto at = std::uint64_t{};
+            std::memcpy(&at, relocs + i * sizeof(at), sizeof(at));
+            if (at < sizeof(header_t)
+                || at > nodes_end - sizeof(node_t*)
+                || at % alignof(node_t*) != 0)
+                throw mapped_error{"malformed mapped vector"};
+            auto slot = reinterpret_cast<std::uintptr_t*>(base() + at);
+            if (!is_node(*slot))
+                throw mapped_error{"malformed mapped vector"};
+            *slot += reinterpret_cast<std::uintptr_t>(base());
+        }
+
+        return {
+            static_cast<detail::rbts::size_t>(h.size),
+            static_cast<detail::rbts::shift_t>(h.shift),
+            reinterpret_cast<node_t*>(base() + h.root),
+            reinterpret_cast<node_t*>(base() + h.tail)
+        };
+    }
+
+    void* data_ = nullptr;
+    std::size_t size_ = 0;
+    vector_type v_ = {};
+};
+
+} // namespace immer
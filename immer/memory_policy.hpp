@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include <immer/heap/arena_heap.hpp>
 #include <immer/heap/heap_policy.hpp>
 #include <immer/refcount/refcount_policy.hpp>
 #include <immer/refcount/unsafe_refcount_policy.hpp>
@@ -93,12 +94,26 @@ constexpr auto get_use_transient_rvalues_v = get_use_transient_rvalues<T>::value
  * @tparam UseTransientRValues Boolean flag indicating whether
  *         immutable containers should try to modify contents in-place
  *         when manipulating an r-value reference.
+ * @tparam KeepHeadroom Boolean flag indicating whether, when reference
+ *         counting, nodes should always be allocated with room for
+ *         their maximum number of children, so they can grow in-place
+ *         when they become transient.  When `false`, nodes are packed
+ *         and they are only reallocated at full capacity the first
+ *         time a transient or r-value operation grows them.  This
+ *         saves memory for data that is mostly persistent.
+ * @tparam CacheDigests Boolean flag indicating whether the inner nodes
+ *         of vectors should remember the digest of their elements, so
+ *         hashing a vector does not traverse again the subtrees that
+ *         it shares with one that was hashed before.  This takes an
+ *         extra word in every inner node.
  */
 template <typename HeapPolicy,
           typename RefcountPolicy,
           typename TransiencePolicy     = get_transience_policy_t<RefcountPolicy>,
           bool PreferFewerBiggerObjects = get_prefer_fewer_bigger_objects_v<HeapPolicy>,
-          bool UseTransientRValues      = get_use_transient_rvalues_v<RefcountPolicy>>
+          bool UseTransientRValues      = get_use_transient_rvalues_v<RefcountPolicy>,
+          bool KeepHeadroom             = true,
+          bool CacheDigests             = false>
 struct memory_policy
 {
     using heap       = HeapPolicy;
@@ -111,6 +126,12 @@ struct memory_policy
     static constexpr bool use_transient_rvalues =
         UseTransientRValues;
 
+    static constexpr bool keep_headroom =
+        KeepHeadroom;
+
+    static constexpr bool cache_digests =
+        CacheDigests;
+
     using transience_t = typename transience::template apply<heap>::type;
 };
 
@@ -145,4 +166,14 @@ using default_memory_policy = memory_policy<
     default_heap_policy,
     default_refcount_policy>;
 
+/*!
+ * Memory policy for short lived containers that are allocated in the
+ * current @ref arena of the thread and released all at once with it.
+ * No reference counting is done, so destroying or updating these
+ * containers is cheaper than with the default memory policy.
+ */
+using arena_memory_policy = memory_policy<
+    heap_policy<arena_heap>,
+    no_refcount_policy>;
+
 } // namespace immer
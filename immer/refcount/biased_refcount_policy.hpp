@@ -0,0 +1,309 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <immer/config.hpp>
+#include <immer/refcount/no_refcount_policy.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace immer {
+
+namespace detail {
+
+// Fences for a Dekker style handshake where one side is much more
+// frequent than the other.  When the operating system can interrupt
+// every thread of the process to run a memory barrier, the frequent
+// side only needs to stop the compiler from reordering its accesses,
+// while the infrequent side pays for the whole process.  Otherwise,
+// both sides use a full fence.
+struct asymmetric_fence
+{
+#if defined(__linux__) && defined(__NR_membarrier)
+    static constexpr int cmd_private_expedited          = 1 << 3;
+    static constexpr int cmd_register_private_expedited = 1 << 4;
+
+    // Registering is done once per process and its outcome is the same
+    // for every thread, so whoever gets here first does it.
+    static bool expedited()
+    {
+        // constant initialized, so reading it needs no guard
+        static std::atomic<int> state {0};
+        auto s = state.load(std::memory_order_relaxed);
+        if (IMMER_UNLIKELY(!s)) {
+            s = 0 == syscall(__NR_membarrier,
+                             cmd_register_private_expedited, 0, 0) ? 1 : 2;
+            state.store(s, std::memory_order_relaxed);
+        }
+        return s == 1;
+    }
+
+    static void light()
+    {
+        if (IMMER_LIKELY(expedited()))
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        else
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    static void heavy()
+    {
+        if (IMMER_LIKELY(expedited()))
+            syscall(__NR_membarrier, cmd_private_expedited, 0, 0);
+        else
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+#else
+    static void light() { std::atomic_thread_fence(std::memory_order_seq_cst); }
+    static void heavy() { std::atomic_thread_fence(std::memory_order_seq_cst); }
+#endif
+};
+
+} // namespace detail
+
+/*!
+ * A reference counting policy that is biased towards objects that
+ * are only used by the thread that creates them.  It is
+ * **thread-safe**.
+ *
+ * The count is split in two.  The *owner*, the thread that created
+ * the object, keeps its references in a count that it updates with
+ * plain loads and stores.  Other threads use a shared atomic count,
+ * which goes below zero when they drop references that the owner
+ * counted, for example, after a container is copied into a new
+ * thread.  The object dies when both counts add up to zero.
+ *
+ * When the owner drops the last reference it counted, it gives up
+ * the bias: it marks the shared count as *merged*, and from then on
+ * everyone, the owner included, uses only the shared count.  Whoever
+ * brings a merged count to zero releases the object, just like with
+ * the @ref refcount_policy.  Before that, the owner count is
+ * positive, so dropping a reference from another thread can only
+ * release the object when it makes the shared count negative, that
+ * is, when it drops a reference that the owner counted.  Only then
+ * it looks at the owner count, after a fence that makes its latest
+ * value visible.  On Linux this uses `membarrier()`, so that the
+ * owner needs no fence at all.  The owner, in turn, reads the shared
+ * count after each release to notice the references that other
+ * threads have handed back.  When both sides may be dropping the last
+ * reference at the same time, an atomic flag decides which one
+ * releases the object, and it waits until the other is done looking
+ * at the counts.
+ *
+ * Objects that stay in one thread are never touched by an atomic
+ * read-modify-write operation until they are released, making this
+ * almost as cheap as the @ref unsafe_refcount_policy.  Copying and
+ * dropping objects created by other threads costs about the same as
+ * with the @ref refcount_policy, except for dropping references that
+ * were counted by the owner, which is more expensive.  Only the
+ * owner updates objects in place while it keeps the bias.
+ */
+struct biased_refcount_policy
+{
+    // Twice the references counted by the owner, plus one while the
+    // owner is checking whether it released the last one.  It stays
+    // at zero once the count is merged.
+    mutable std::atomic<int> biased;
+    const std::uint32_t owner;
+    // The references counted by the other threads in the upper half,
+    // and in the lower half the flags and the number of threads that
+    // are checking whether they released the last one.
+    mutable std::atomic<std::int64_t> shared;
+
+    biased_refcount_policy()
+        : biased{2}, owner{this_thread()}, shared{0} {}
+    biased_refcount_policy(disowned)
+        : biased{0}, owner{this_thread()}, shared{merged} {}
+
+    void inc()
+    {
+        if (owned()) {
+            auto b = biased.load(std::memory_order_relaxed);
+            if (IMMER_LIKELY(b > 0)) {
+                biased.store(b + 2, std::memory_order_relaxed);
+                return;
+            }
+        }
+        touch();
+        shared.fetch_add(unit, std::memory_order_relaxed);
+    }
+
+    bool dec()
+    {
+        if (owned()) {
+            auto b = biased.load(std::memory_order_relaxed);
+            if (b == 2)
+                return merge();
+            if (IMMER_LIKELY(b > 0)) {
+                biased.store(b - 1, std::memory_order_release);
+                detail::asymmetric_fence::light();
+                auto s = shared.load(std::memory_order_acquire);
+                if (b / 2 - 1 + count(s) > 0) {
+                    biased.store(b - 2, std::memory_order_release);
+                    return false;
+                }
+                // no other thread ever had a reference, so no one
+                // else can be looking at the counts
+                if (!(s & touched))
+                    return true;
+                auto released = claim();
+                biased.store(b - 2, std::memory_order_release);
+                if (released)
+                    wait_checking(false);
+                return released;
+            }
+        }
+        return dec_shared();
+    }
+
+    void dec_unsafe()
+    {
+        if (owned()) {
+            auto b = biased.load(std::memory_order_relaxed);
+            if (b > 2) {
+                biased.store(b - 2, std::memory_order_release);
+                return;
+            } else if (b == 2) {
+                biased.store(0, std::memory_order_relaxed);
+                shared.fetch_or(merged, std::memory_order_release);
+                return;
+            }
+        }
+        touch();
+        shared.fetch_sub(unit, std::memory_order_relaxed);
+    }
+
+    bool unique()
+    {
+        // before the count is merged the owner count can not be read
+        // reliably from other threads, but saying no there only
+        // means that the object is copied instead of updated in place
+        auto s = shared.load(std::memory_order_acquire);
+        if (s & merged)
+            return count(s) == 1;
+        return owned()
+            && biased.load(std::memory_order_relaxed) / 2 + count(s) == 1;
+    }
+
+private:
+    static constexpr std::int64_t touched = 1;
+    static constexpr std::int64_t dead    = 2;
+    static constexpr std::int64_t merged  = 4;
+    static constexpr std::int64_t checker = 8;
+    static constexpr std::int64_t unit    = std::int64_t{1} << 32;
+    static constexpr std::int64_t checkers_mask = unit - checker;
+
+    static std::uint32_t this_thread()
+    {
+        // constant initialized, so reading it needs no guard
+        static std::atomic<std::uint32_t> next {1};
+        thread_local std::uint32_t id = 0;
+        if (IMMER_UNLIKELY(!id))
+            id = next.fetch_add(1, std::memory_order_relaxed);
+        return id;
+    }
+
+    static std::int64_t count(std::int64_t s)
+    {
+        return (s - (s & (unit - 1))) / unit;
+    }
+
+    bool owned() const { return owner == this_thread(); }
+
+    void touch()
+    {
+        if (!(shared.load(std::memory_order_relaxed) & touched))
+            shared.fetch_or(touched, std::memory_order_relaxed);
+    }
+
+    // The owner drops the last reference it counted.  Other threads
+    // that drop theirs before the count is merged do not look at the
+    // owner count unless the shared one goes negative, so this has to
+    // tell whether it was the last one left.
+    bool merge()
+    {
+        biased.store(1, std::memory_order_release);
+        auto s = shared.fetch_or(merged, std::memory_order_acq_rel);
+        if (!(s & touched)) {
+            biased.store(0, std::memory_order_relaxed);
+            return true;
+        }
+        auto released = count(s) == 0 && claim();
+        biased.store(0, std::memory_order_release);
+        if (released)
+            wait_checking(false);
+        return released;
+    }
+
+    bool dec_shared()
+    {
+        auto s = shared.load(std::memory_order_relaxed);
+        auto checking = false;
+        auto next = s;
+        do {
+            // until the count is merged the owner count is positive,
+            // so only a negative shared count may leave no references
+            checking = !(s & merged) && count(s) <= 0;
+            next = (s | touched) - unit + (checking ? checker : 0);
+        } while (!shared.compare_exchange_weak(s, next,
+                                               std::memory_order_acq_rel,
+                                               std::memory_order_relaxed));
+        if (next & merged) {
+            auto released = count(next) == 0;
+            if (released)
+                wait_checking(true);
+            return released;
+        }
+        if (!checking)
+            return false;
+        detail::asymmetric_fence::heavy();
+        auto released =
+            biased.load(std::memory_order_acquire) / 2 + count(next) == 0
+            && claim();
+        shared.fetch_sub(checker, std::memory_order_release);
+        if (released)
+            wait_checking(true);
+        return released;
+    }
+
+    bool claim()
+    {
+        return !(shared.fetch_or(dead, std::memory_order_acq_rel) & dead);
+    }
+
+    // Once the object is known to be dead, no one can start looking
+    // at the counts, but other threads may still be doing it.
+    void wait_checking(bool owner_too)
+    {
+        while ((shared.load(std::memory_order_acquire) & checkers_mask) ||
+               (owner_too && (biased.load(std::memory_order_acquire) & 1)))
+            std::this_thread::yield();
+    }
+};
+
+} // namespace immer
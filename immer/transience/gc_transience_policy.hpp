@@ -21,6 +21,7 @@
 #pragma once
 
 #include <immer/heap/tags.hpp>
+#include <immer/detail/util.hpp>
 
 #include <memory>
 
@@ -51,7 +52,11 @@ struct gc_transience_policy
 
             struct owner
             {
-                edit token_ = heap_::allocate(1, norefs_tag{});
+                // the token must be a unique address, so failing to
+                // allocate it, like when an arena heap is used with no
+                // current arena, can not be ignored
+                edit token_ = detail::check_alloc(
+                    heap_::allocate(1, norefs_tag{}));
 
                 operator edit () { return token_; }
 
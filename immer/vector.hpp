@@ -24,6 +24,8 @@
 #include <immer/detail/rbts/rbtree_iterator.hpp>
 #include <immer/memory_policy.hpp>
 
+#include <functional>
+
 #if IMMER_DEBUG_PRINT
 #include <immer/flex_vector.hpp>
 #endif
@@ -42,6 +44,25 @@ template <typename T,
           detail::rbts::bits_t BL>
 class vector_transient;
 
+template <typename T,
+          typename MemoryPolicy,
+          detail::rbts::bits_t B,
+          detail::rbts::bits_t BL>
+class mapped_vector;
+
+template <typename T,
+          typename MemoryPolicy,
+          detail::rbts::bits_t B,
+          detail::rbts::bits_t BL>
+class vector_view;
+
+namespace detail {
+namespace rbts {
+template <typename Container>
+struct archive_loader;
+} // namespace rbts
+} // namespace detail
+
 /**
  * Immutable sequential container supporting both random access and
  * structural sharing.
@@ -112,6 +133,31 @@ public:
      */
     vector() = default;
 
+    /*!
+     * Constructs a vector containing the elements in the range `[first,
+     * last)`.  Leaves are filled directly from the input and the inner
+     * nodes are built bottom-up, which is significantly faster than
+     * repeated calls to `push_back`.  It may allocate memory and its
+     * complexity is @f$ O(size) @f$.
+     */
+    template <typename Iter,
+              typename = std::enable_if_t<detail::is_iterator<Iter>::value>>
+    vector(Iter first, Iter last)
+        : impl_{ impl_t::from_range(first, last) }
+    {}
+
+    /*!
+     * Returns a vector containing the elements of the range `r`, as in
+     * `vector(std::begin(r), std::end(r))`.
+     */
+    template <typename Range>
+    static vector from_range(const Range& r)
+    {
+        using std::begin;
+        using std::end;
+        return impl_t::from_range(begin(r), end(r));
+    }
+
     /*!
      * Returns an iterator pointing at the first element of the
      * collection. It does not allocate memory and its complexity is
@@ -225,6 +271,48 @@ public:
     void for_each_chunk(Fn&& fn) const
     { impl_.for_each_chunk(std::forward<Fn>(fn)); }
 
+    /*!
+     * Apply operation `fn` for every *chunk* of data containing the
+     * elements in the range `[first, last)`, as in
+     * `for_each_chunk(fn)`.  Only the leaves overlapping the range
+     * are visited and no memory is allocated, so this is much cheaper
+     * than slicing the vector first.  Undefined for `first > last` or
+     * `last > size()`.
+     */
+    template <typename Fn>
+    void for_each_chunk(size_type first, size_type last, Fn&& fn) const
+    { impl_.for_each_chunk(first, last, std::forward<Fn>(fn)); }
+
+    /*!
+     * Like `for_each_chunk(fn)`, but the traversal stops as soon as
+     * `fn` returns `false`.  Returns `true` when all the chunks were
+     * visited.
+     */
+    template <typename Fn>
+    bool for_each_chunk_p(Fn&& fn) const
+    { return impl_.for_each_chunk_p(std::forward<Fn>(fn)); }
+
+    /*!
+     * Like `for_each_chunk(first, last, fn)`, but the traversal stops
+     * as soon as `fn` returns `false`.  Returns `true` when all the
+     * chunks in the range were visited.
+     */
+    template <typename Fn>
+    bool for_each_chunk_p(size_type first, size_type last, Fn&& fn) const
+    { return impl_.for_each_chunk_p(first, last, std::forward<Fn>(fn)); }
+
+    /*!
+     * Returns whether the vectors are equal.  Subtrees that are
+     * shared between both vectors are not traversed, so comparing a
+     * vector with a modified version of itself is proportional to
+     * the size of the modification.  It does not allocate memory and
+     * its complexity is @f$ O(size) @f$ in the worst case.
+     */
+    bool operator==(const vector& other) const
+    { return impl_.equals(other.impl_); }
+    bool operator!=(const vector& other) const
+    { return !(*this == other); }
+
     /*!
      * Returns an @a transient form of this container, an
      * `immer::vector_transient`.
@@ -239,9 +327,20 @@ public:
     { flex_t{*this}.debug_print(); }
 #endif
 
+    // Semi-private
+    const impl_t& impl() const { return impl_; }
+
 private:
     friend flex_t;
     friend transient_type;
+    template <typename C>
+    friend struct detail::rbts::archive_loader;
+    template <typename T_, typename MP_,
+              detail::rbts::bits_t B_, detail::rbts::bits_t BL_>
+    friend class mapped_vector;
+    template <typename T_, typename MP_,
+              detail::rbts::bits_t B_, detail::rbts::bits_t BL_>
+    friend class vector_view;
 
     vector(impl_t impl)
         : impl_(std::move(impl))
@@ -278,4 +377,36 @@ private:
     impl_t impl_ = impl_t::empty;
 };
 
+/*!
+ * Returns a hash of the contents of `v`, combining the `std::hash` of
+ * its elements in order.  Equal vectors have the same hash, no matter
+ * how they were built.  It does not allocate memory.  Its complexity
+ * is @f$ O(size) @f$.  When the memory policy enables `cache_digests`,
+ * the digests of inner nodes are cached, so hashing a vector that
+ * shares most of its nodes with one hashed before only visits the
+ * nodes that are not shared.
+ */
+template <typename T,
+          typename MemoryPolicy,
+          detail::rbts::bits_t B,
+          detail::rbts::bits_t BL>
+std::size_t hash_value(const vector<T, MemoryPolicy, B, BL>& v)
+{
+    return v.impl().template hash<std::hash<T>>();
+}
+
 } // namespace immer
+
+namespace std {
+
+template <typename T,
+          typename MemoryPolicy,
+          immer::detail::rbts::bits_t B,
+          immer::detail::rbts::bits_t BL>
+struct hash<immer::vector<T, MemoryPolicy, B, BL>>
+{
+    std::size_t operator() (const immer::vector<T, MemoryPolicy, B, BL>& v) const
+    { return immer::hash_value(v); }
+};
+
+} // namespace std
@@ -0,0 +1,162 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <immer/detail/rbts/borrowed_tree.hpp>
+#include <immer/vector.hpp>
+
+namespace immer {
+
+/*!
+ * Non-owning, read-only view of an `immer::vector`.
+ *
+ * Copying a vector is cheap, but it still increments and later
+ * decrements the reference count of its root and tail.  When the same
+ * value is handed to many short lived tasks, these atomic operations
+ * on shared cache lines may be a bottleneck.  A view borrows the
+ * vector instead, so creating, copying and destroying it has no cost
+ * at all.  An owning vector can be obtained back from it whenever
+ * some task needs to keep the value around.
+ *
+ * @rst
+ *
+ * .. warning:: The view borrows the nodes of the vector it was created
+ *    from, without keeping them alive.  Some vector holding the same
+ *    value must outlive the view.  The iterators of a view refer to
+ *    the view itself, so they must not outlive it either.
+ *
+ * @endrst
+ */
+template <typename T,
+          typename MemoryPolicy   = default_memory_policy,
+          detail::rbts::bits_t B  = default_bits,
+          detail::rbts::bits_t BL = detail::rbts::derive_bits_leaf<T, MemoryPolicy, B>>
+class vector_view
+{
+public:
+    using vector_type = vector<T, MemoryPolicy, B, BL>;
+
+    using value_type = T;
+    using reference = const T&;
+    using size_type = detail::rbts::size_t;
+    using difference_type = std::ptrdiff_t;
+    using const_reference = const T&;
+
+    using iterator         = typename vector_type::iterator;
+    using const_iterator   = iterator;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+
+    /*!
+     * Views the vector `v`.  It does not allocate memory and its
+     * complexity is @f$ O(1) @f$.
+     */
+    vector_view(const vector_type& v)
+        : impl_{ v.impl() }
+    {}
+
+    vector_view(vector_type&&) = delete;
+
+    /*!
+     * Returns an iterator pointing at the first element of the
+     * collection. It does not allocate memory and its complexity is
+     * @f$ O(1) @f$.
+     */
+    iterator begin() const { return {impl()}; }
+
+    /*!
+     * Returns an iterator pointing just after the last element of the
+     * collection. It does not allocate and its complexity is @f$ O(1) @f$.
+     */
+    iterator end()   const { return {impl(), typename iterator::end_t{}}; }
+
+    /*!
+     * Returns an iterator that traverses the collection backwards,
+     * pointing at the first element of the reversed collection. It
+     * does not allocate memory and its complexity is @f$ O(1) @f$.
+     */
+    reverse_iterator rbegin() const { return reverse_iterator{end()}; }
+
+    /*!
+     * Returns an iterator that traverses the collection backwards,
+     * pointing after the last element of the reversed collection. It
+     * does not allocate memory and its complexity is @f$ O(1) @f$.
+     */
+    reverse_iterator rend()   const { return reverse_iterator{begin()}; }
+
+    /*!
+     * Returns the number of elements in the container.  It does
+     * not allocate memory and its complexity is @f$ O(1) @f$.
+     */
+    size_type size() const { return impl().size; }
+
+    /*!
+     * Returns `true` if there are no elements in the container.  It
+     * does not allocate memory and its complexity is @f$ O(1) @f$.
+     */
+    bool empty() const { return impl().size == 0; }
+
+    /*!
+     * Returns a `const` reference to the element at position `index`.
+     * It does not allocate memory and its complexity is *effectively*
+     * @f$ O(1) @f$.
+     */
+    reference operator[] (size_type index) const
+    { return impl().get(index); }
+
+    /*!
+     * Apply operation `fn` for every *chunk* of data in the vector, as
+     * in `vector::for_each_chunk`.
+     */
+    template <typename Fn>
+    void for_each_chunk(Fn&& fn) const
+    { impl().for_each_chunk(std::forward<Fn>(fn)); }
+
+    template <typename Fn>
+    void for_each_chunk(size_type first, size_type last, Fn&& fn) const
+    { impl().for_each_chunk(first, last, std::forward<Fn>(fn)); }
+
+    template <typename Fn>
+    bool for_each_chunk_p(Fn&& fn) const
+    { return impl().for_each_chunk_p(std::forward<Fn>(fn)); }
+
+    template <typename Fn>
+    bool for_each_chunk_p(size_type first, size_type last, Fn&& fn) const
+    { return impl().for_each_chunk_p(first, last, std::forward<Fn>(fn)); }
+
+    /*!
+     * Returns an owning vector with the viewed value, that can outlive
+     * the view.  It does not allocate memory and its complexity is
+     * @f$ O(1) @f$.
+     */
+    vector_type get() const { return impl(); }
+    operator vector_type() const { return get(); }
+
+    // Semi-private
+    decltype(auto) impl() const { return impl_.get(); }
+
+private:
+    using impl_t = std::decay_t<decltype(std::declval<vector_type>().impl())>;
+
+    detail::rbts::borrowed_tree<impl_t> impl_;
+};
+
+} // namespace immer
@@ -0,0 +1,208 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include <immer/archive.hpp>
+#include <immer/flex_vector.hpp>
+#include <immer/vector.hpp>
+
+#include <catch.hpp>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace immer {
+
+template <>
+struct archive_codec<std::string>
+{
+    static void save(std::ostream& out, const std::string& x)
+    {
+        auto n = std::uint32_t(x.size());
+        out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+        out.write(x.data(), n);
+    }
+
+    static std::string load(std::istream& in)
+    {
+        auto n = std::uint32_t{};
+        in.read(reinterpret_cast<char*>(&n), sizeof(n));
+        auto x = std::string(n, '\0');
+        if (!in.read(&x[0], n))
+            throw archive_error{"truncated string"};
+        return x;
+    }
+};
+
+} // namespace immer
+
+namespace {
+
+template <typename Container>
+std::string save_all(const std::vector<Container>& history)
+{
+    auto out = std::ostringstream{};
+    auto writer = immer::archive_writer<Container>{out};
+    for (auto& v : history)
+        writer.save(v);
+    CHECK(writer.size() == history.size());
+    return out.str();
+}
+
+template <typename Container>
+std::vector<Container> load_all(const std::string& data)
+{
+    auto in = std::istringstream{data};
+    auto reader = immer::archive_reader<Container>{in};
+    auto result = std::vector<Container>{};
+    auto v = Container{};
+    while (reader.load(v))
+        result.push_back(v);
+    return result;
+}
+
+template <typename Container>
+void check_round_trip(const std::vector<Container>& history)
+{
+    auto loaded = load_all<Container>(save_all(history));
+    REQUIRE(loaded.size() == history.size());
+    for (auto i = 0u; i < history.size(); ++i)
+        CHECK(loaded[i] == history[i]);
+}
+
+template <typename Container>
+std::vector<Container> make_history(unsigned n, unsigned versions)
+{
+    auto v = Container{};
+    for (auto i = 0u; i < n; ++i)
+        v = v.push_back(i);
+    auto history = std::vector<Container>{ v };
+    for (auto i = 0u; i < versions; ++i) {
+        v = v.set((i * 7919u) % n, i);
+        history.push_back(v);
+    }
+    return history;
+}
+
+} // anonymous namespace
+
+TEST_CASE("archive of vectors")
+{
+    using vector_t = immer::vector<unsigned>;
+
+    SECTION("empty")
+    {
+        check_round_trip(std::vector<vector_t>{ vector_t{} });
+        check_round_trip(std::vector<vector_t>{});
+    }
+
+    SECTION("history")
+    {
+        auto history = make_history<vector_t>(10000, 100);
+        check_round_trip(history);
+    }
+
+    SECTION("shared nodes are written once")
+    {
+        auto history = make_history<vector_t>(10000, 100);
+        auto one = save_all(std::vector<vector_t>{ history.back() });
+        auto all = save_all(history);
+        // every version only adds the path to the updated element
+        CHECK(all.size() < one.size() * 3);
+    }
+
+    SECTION("shared nodes are shared again")
+    {
+        auto history = make_history<vector_t>(10000, 2);
+        auto loaded = load_all<vector_t>(save_all(history));
+        auto& a = loaded[1].impl();
+        auto& b = loaded[2].impl();
+        CHECK(a.tail == b.tail);
+        CHECK(a.root != b.root);
+        auto children = ((a.tail_offset() - 1) >> a.shift) + 1;
+        auto different = 0u;
+        for (auto i = 0u; i < children; ++i)
+            different += a.root->inner()[i] != b.root->inner()[i];
+        CHECK(children > 1u);
+        CHECK(different == 1u);
+    }
+}
+
+TEST_CASE("archive of flex vectors")
+{
+    using vector_t = immer::flex_vector<unsigned>;
+
+    SECTION("history")
+    {
+        auto history = make_history<vector_t>(10000, 100);
+        check_round_trip(history);
+    }
+
+    SECTION("relaxed and sliced")
+    {
+        auto v = make_history<vector_t>(10000, 0).back();
+        auto history = std::vector<vector_t>{
+            v,
+            v.take(5000),
+            v.drop(123),
+            v.drop(123).take(33),
+            v.take(5000) + v.drop(123),
+            v.push_front(42u) + v.take(7),
+        };
+        check_round_trip(history);
+    }
+}
+
+TEST_CASE("archive of non trivially copyable values")
+{
+    using vector_t = immer::flex_vector<std::string>;
+    auto v = vector_t{};
+    for (auto i = 0u; i < 1000; ++i)
+        v = v.push_back(std::to_string(i));
+    check_round_trip(std::vector<vector_t>{ v, v.set(500, "foo"), v.drop(3) });
+}
+
+TEST_CASE("archive errors")
+{
+    using vector_t = immer::vector<unsigned>;
+    auto data = save_all(make_history<vector_t>(1000, 3));
+
+    SECTION("wrong type")
+    {
+        CHECK_THROWS_AS(load_all<immer::vector<double>>(data),
+                        immer::archive_error);
+    }
+
+    SECTION("relaxed nodes in vectors")
+    {
+        using flex_t = immer::flex_vector<unsigned>;
+        auto v = make_history<flex_t>(100, 0).back();
+        auto relaxed = save_all(std::vector<flex_t>{ v + v });
+        CHECK_THROWS_AS(load_all<vector_t>(relaxed), immer::archive_error);
+    }
+
+    SECTION("truncated")
+    {
+        for (auto n : { 3u, 30u, 300u, unsigned(data.size() - 1) })
+            CHECK_THROWS_AS(load_all<vector_t>(data.substr(0, n)),
+                            immer::archive_error);
+    }
+}
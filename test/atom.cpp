@@ -0,0 +1,140 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <immer/atom.hpp>
+#include <immer/vector.hpp>
+
+#include <catch.hpp>
+
+#include <thread>
+#include <vector>
+
+TEST_CASE("instantiation")
+{
+    immer::atom<immer::vector<int>> a{};
+    CHECK(a.load().size() == 0u);
+}
+
+TEST_CASE("load and store")
+{
+    auto v = immer::vector<int>{}.push_back(1).push_back(2);
+    immer::atom<immer::vector<int>> a{v};
+    CHECK(a.load() == v);
+
+    a.store(v.push_back(3));
+    CHECK(a.load() == v.push_back(3));
+
+    a = v;
+    CHECK(immer::vector<int>{a} == v);
+}
+
+TEST_CASE("exchange")
+{
+    auto v = immer::vector<int>{}.push_back(1);
+    immer::atom<immer::vector<int>> a{v};
+    auto old = a.exchange(v.push_back(2));
+    CHECK(old == v);
+    CHECK(a.load() == v.push_back(2));
+}
+
+TEST_CASE("update")
+{
+    immer::atom<immer::vector<int>> a{};
+    auto r = a.update([] (auto v) { return v.push_back(42); });
+    CHECK(r.size() == 1u);
+    CHECK(r[0] == 42);
+    CHECK(a.load() == r);
+
+    SECTION("exception safety")
+    {
+        CHECK_THROWS(a.update([] (auto v) -> immer::vector<int> {
+            throw std::runtime_error{"nope"};
+        }));
+        CHECK(a.load() == r);
+    }
+}
+
+TEST_CASE("concurrent updates and loads")
+{
+    const auto writers = 4u;
+    const auto readers = 4u;
+    const auto n = 1000u;
+
+    immer::atom<immer::vector<unsigned>> a{};
+    auto threads = std::vector<std::thread>{};
+    std::atomic<bool> torn{false};
+
+    for (auto i = 0u; i < writers; ++i)
+        threads.emplace_back([&] {
+            for (auto j = 0u; j < n; ++j)
+                a.update([] (auto v) { return v.push_back(v.size()); });
+        });
+    for (auto i = 0u; i < readers; ++i)
+        threads.emplace_back([&] {
+            auto last = 0u;
+            while (last < writers * n) {
+                auto v = a.load();
+                // every published version is a prefix of the final one
+                for (auto j = last; j < v.size(); ++j)
+                    if (v[j] != j) torn = true;
+                if (v.size() < last) torn = true;
+                last = v.size();
+            }
+        });
+    for (auto& t : threads)
+        t.join();
+
+    CHECK(!torn);
+    auto v = a.load();
+    CHECK(v.size() == writers * n);
+    for (auto i = 0u; i < v.size(); ++i)
+        CHECK(v[i] == i);
+}
+
+TEST_CASE("concurrent stores and exchanges")
+{
+    const auto n = 1000u;
+    immer::atom<immer::vector<unsigned>> a{};
+    auto threads = std::vector<std::thread>{};
+    std::atomic<bool> torn{false};
+
+    // all values stored are vectors whose elements equal their size
+    auto check = [&] (const immer::vector<unsigned>& v) {
+        for (auto x : v)
+            if (x != v.size()) torn = true;
+    };
+
+    for (auto i = 0u; i < 4u; ++i)
+        threads.emplace_back([&] {
+            for (auto j = 0u; j < n; ++j) {
+                auto v = immer::vector<unsigned>{};
+                for (auto k = 0u; k < j % 100; ++k)
+                    v = v.push_back(j % 100);
+                check(a.exchange(v));
+                a.store(v);
+                check(a.load());
+            }
+        });
+    for (auto& t : threads)
+        t.join();
+
+    CHECK(!torn);
+    check(a.load());
+}
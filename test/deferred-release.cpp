@@ -0,0 +1,139 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include <immer/deferred_release.hpp>
+#include <immer/flex_vector_transient.hpp>
+#include <immer/vector_transient.hpp>
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <thread>
+
+namespace {
+
+struct counted
+{
+    static std::atomic<int> live;
+
+    int value;
+
+    counted(int v) : value{v} { ++live; }
+    counted(const counted& x) : value{x.value} { ++live; }
+    ~counted() { --live; }
+};
+
+std::atomic<int> counted::live {0};
+
+template <typename Vector>
+Vector make_counted(int n)
+{
+    auto t = typename Vector::transient_type{};
+    for (auto i = 0; i < n; ++i)
+        t.push_back(counted{i});
+    return t.persistent();
+}
+
+} // anonymous namespace
+
+TEST_CASE("deferred release of vector")
+{
+    auto v = make_counted<immer::vector<counted>>(10000);
+    CHECK(counted::live == 10000);
+
+    immer::deferred_release(std::move(v));
+    CHECK(v.empty());
+    CHECK(counted::live == 10000);
+
+    constexpr auto leaf_size = 1 << immer::vector<counted>::bits_leaf;
+    auto rounds = 0;
+    auto last = counted::live.load();
+    while (immer::release_pending(4)) {
+        // each slice frees at most four leaves
+        CHECK(last - counted::live <= 4 * leaf_size);
+        last = counted::live;
+        ++rounds;
+    }
+    CHECK(rounds > 10);
+    CHECK(counted::live == 0);
+}
+
+TEST_CASE("deferred release keeps shared nodes")
+{
+    auto v = make_counted<immer::vector<counted>>(5000);
+    auto w = v.push_back(counted{5000});
+    immer::deferred_release(std::move(v));
+    while (immer::release_pending());
+    CHECK(counted::live == 5001);
+    CHECK(w.size() == 5001u);
+    for (auto i = 0u; i < w.size(); ++i)
+        CHECK(w[i].value == int(i));
+    w = {};
+    CHECK(counted::live == 0);
+}
+
+TEST_CASE("deferred release of flex vector")
+{
+    using flex_t = immer::flex_vector<counted>;
+    auto l = make_counted<flex_t>(3000);
+    auto r = make_counted<flex_t>(3001);
+    auto v = l.drop(7) + r.take(2999);
+    l = {};
+    r = {};
+    immer::deferred_release(std::move(v));
+    CHECK(v.empty());
+    immer::deferred_release(flex_t{});
+    while (immer::release_pending(1));
+    CHECK(counted::live == 0);
+}
+
+TEST_CASE("deferred release in background thread")
+{
+    std::atomic<bool> done{false};
+    auto reaper = std::thread{[&] {
+        while (!done)
+            if (!immer::release_pending())
+                std::this_thread::yield();
+        while (immer::release_pending());
+    }};
+    for (auto i = 0; i < 20; ++i)
+        immer::deferred_release(make_counted<immer::vector<counted>>(1000));
+    done = true;
+    reaper.join();
+    CHECK(counted::live == 0);
+}
+
+TEST_CASE("deferred release in slices and background thread")
+{
+    std::atomic<bool> done{false};
+    auto reaper = std::thread{[&] {
+        while (!done)
+            if (!immer::release_pending())
+                std::this_thread::yield();
+    }};
+    for (auto i = 0; i < 20; ++i)
+        immer::deferred_release(make_counted<immer::vector<counted>>(1000));
+    // zero means that the reaper is not working on anything either
+    while (immer::release_pending(1));
+    CHECK(counted::live == 0);
+    done = true;
+    reaper.join();
+}
@@ -0,0 +1,162 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include <immer/epoch_atom.hpp>
+#include <immer/vector.hpp>
+#include <immer/vector_view.hpp>
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct counted
+{
+    static std::atomic<int> live;
+
+    int value;
+
+    counted(int v) : value{v} { ++live; }
+    counted(const counted& x) : value{x.value} { ++live; }
+    ~counted() { --live; }
+};
+
+std::atomic<int> counted::live {0};
+
+void reclaim_all()
+{
+    while (immer::epoch_reclaim());
+}
+
+} // anonymous namespace
+
+TEST_CASE("epoch atom load and store")
+{
+    auto v = immer::vector<int>{}.push_back(1).push_back(2);
+    immer::epoch_atom<immer::vector<int>> a{v};
+    CHECK(a.load() == v);
+
+    a.store(v.push_back(3));
+    CHECK(a.load() == v.push_back(3));
+
+    a = v;
+    CHECK(immer::vector<int>{a} == v);
+
+    auto old = a.exchange(v.push_back(4));
+    CHECK(old == v);
+    CHECK(a.read([] (auto& x) { return x.size(); }) == 3u);
+
+    auto r = a.update([] (auto x) { return x.push_back(5); });
+    CHECK(r.size() == 4u);
+    CHECK(a.load() == r);
+    reclaim_all();
+}
+
+TEST_CASE("epoch atom defers destruction while reading")
+{
+    reclaim_all();
+    {
+        immer::epoch_atom<counted> a{counted{1}};
+        CHECK(counted::live == 1);
+        {
+            immer::epoch_guard g;
+            auto& x = a.get(g);
+            a.store(counted{2});
+            CHECK(immer::epoch_reclaim() == 1u);
+            CHECK(counted::live == 2);
+            CHECK(x.value == 1);
+            CHECK(a.get(g).value == 2);
+        }
+        reclaim_all();
+        CHECK(counted::live == 1);
+
+        SECTION("guards in other threads")
+        {
+            std::atomic<int> step {0};
+            auto reader = std::thread{[&] {
+                immer::epoch_guard g;
+                auto& x = a.get(g);
+                step = 1;
+                while (step != 2);
+                CHECK(x.value == 2);
+            }};
+            while (step != 1);
+            a.store(counted{3});
+            CHECK(immer::epoch_reclaim() == 1u);
+            CHECK(counted::live == 2);
+            step = 2;
+            reader.join();
+            reclaim_all();
+            CHECK(counted::live == 1);
+        }
+
+        SECTION("guards started after the store do not block")
+        {
+            a.store(counted{3});
+            immer::epoch_guard g;
+            CHECK(a.get(g).value == 3);
+            CHECK(immer::epoch_reclaim() == 0u);
+            CHECK(counted::live == 1);
+        }
+    }
+    reclaim_all();
+    CHECK(counted::live == 0);
+}
+
+TEST_CASE("epoch atom concurrent readers and writers")
+{
+    const auto writers = 2u;
+    const auto readers = 4u;
+    const auto n = 1000u;
+
+    immer::epoch_atom<immer::vector<unsigned>> a{};
+    auto threads = std::vector<std::thread>{};
+    std::atomic<bool> torn{false};
+
+    for (auto i = 0u; i < writers; ++i)
+        threads.emplace_back([&] {
+            for (auto j = 0u; j < n; ++j)
+                a.update([] (auto v) { return v.push_back(v.size()); });
+        });
+    for (auto i = 0u; i < readers; ++i)
+        threads.emplace_back([&] {
+            auto last = 0u;
+            while (last < writers * n) {
+                immer::epoch_guard g;
+                auto v = immer::vector_view<unsigned>{a.get(g)};
+                // every published version is a prefix of the final one
+                for (auto j = last; j < v.size(); ++j)
+                    if (v[j] != j) torn = true;
+                if (v.size() < last) torn = true;
+                last = v.size();
+            }
+        });
+    for (auto& t : threads)
+        t.join();
+
+    CHECK(!torn);
+    auto v = a.load();
+    CHECK(v.size() == writers * n);
+    reclaim_all();
+}
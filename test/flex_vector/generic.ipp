@@ -204,6 +204,48 @@ TEST_CASE("accumulate relaxed")
     }
 }
 
+TEST_CASE("parallel accumulate relaxed")
+{
+    const auto n = 666u;
+    auto v = make_test_flex_vector_front(0, n);
+    for (auto i : test_irange(0u, n)) {
+        auto vv = v.take(i) + v.drop(i);
+        CHECK(immer::parallel_accumulate(vv, 0u) == n * (n - 1) / 2);
+        CHECK(immer::parallel_transform_reduce(
+                  vv.drop(i), 0u, std::plus<>{},
+                  [] (auto x) { return x * 2; }) ==
+              2 * immer::accumulate(v.drop(i), 0u));
+    }
+}
+
+TEST_CASE("for each chunk range relaxed")
+{
+    const auto n = 666u;
+    auto v = make_test_flex_vector_front(0, n);
+    for (auto i : test_irange(0u, n)) {
+        auto vv = v.take(i) + v.drop(i);
+        for (auto first : test_irange(0u, n)) {
+            auto last = first + (i * 7) % (n - first + 1);
+            auto sum = 0u;
+            vv.for_each_chunk(first, last, [&] (auto f, auto l) {
+                sum = std::accumulate(f, l, sum);
+            });
+            CHECK(sum == (last * (last - 1) - first * (first - 1)) / 2);
+
+            auto count   = 0u;
+            auto stopped = false;
+            auto done = vv.for_each_chunk_p(first, last, [&] (auto f, auto l) {
+                CHECK(!stopped);
+                count += l - f;
+                stopped = count >= 10;
+                return !stopped;
+            });
+            CHECK(done == !stopped);
+            CHECK((stopped || count == last - first));
+        }
+    }
+}
+
 TEST_CASE("take relaxed")
 {
     const auto n = 666u;
@@ -240,6 +282,219 @@ TEST_CASE("drop")
     }
 }
 
+TEST_CASE("from range relaxed")
+{
+    const auto n = 666u;
+    auto r = boost::irange(0u, n);
+    for (auto i : test_irange(0u, n)) {
+        auto v = FLEX_VECTOR_T<unsigned>(r.begin(), r.begin() + i);
+        CHECK_VECTOR_EQUALS(v, boost::irange(0u, i));
+        CHECK(v + v.drop(i / 2) == make_test_flex_vector(0, i) +
+                                   make_test_flex_vector(i / 2, i));
+        CHECK_VECTOR_EQUALS(v.push_front(n).drop(1), v);
+    }
+    CHECK(FLEX_VECTOR_T<unsigned>::from_range(r) ==
+          make_test_flex_vector_front(0, n));
+}
+
+TEST_CASE("diff relaxed")
+{
+    const auto n = 666u;
+    auto v = make_test_flex_vector_front(0, n);
+
+    auto changes = std::vector<std::size_t>{};
+    auto inserts = std::vector<std::size_t>{};
+    auto erases  = std::vector<std::size_t>{};
+    auto check_diff = [&] (auto a, auto b) {
+        changes.clear();
+        inserts.clear();
+        erases.clear();
+        immer::diff(a, b,
+                    [&] (auto i, auto y) {
+                        CHECK(b[i] == y);
+                        inserts.push_back(i);
+                    },
+                    [&] (auto i, auto x) {
+                        CHECK(a[i] == x);
+                        erases.push_back(i);
+                    },
+                    [&] (auto i, auto x, auto y) {
+                        CHECK(x != y);
+                        CHECK(a[i] == x);
+                        CHECK(b[i] == y);
+                        changes.push_back(i);
+                    });
+        CHECK(a.size() + inserts.size() - erases.size() == b.size());
+    };
+    using idx_t = std::vector<std::size_t>;
+
+    for (auto i : test_irange(0u, n)) {
+        check_diff(v, v.set(i, n));
+        CHECK((changes == idx_t{i} && inserts.empty() && erases.empty()));
+        check_diff(v, v.drop(i));
+        CHECK((changes.empty() && inserts.empty()));
+        CHECK_VECTOR_EQUALS(erases, boost::irange(0u, i));
+        check_diff(v.take(i), v);
+        CHECK((changes.empty() && erases.empty()));
+        CHECK_VECTOR_EQUALS(inserts, boost::irange(i, n));
+        check_diff(v, v.take(i) + v.drop(i));
+        CHECK((changes.empty() && inserts.empty() && erases.empty()));
+        check_diff(make_test_flex_vector(0, n) + v, v + v);
+        CHECK((changes.empty() && inserts.empty() && erases.empty()));
+        check_diff(v.push_front(n), v);
+        CHECK((changes.empty() && inserts.empty() && erases == idx_t{0}));
+        check_diff(v, v.insert(i, n));
+        CHECK((changes.empty() && inserts == idx_t{i} && erases.empty()));
+        check_diff(v, v.erase(i));
+        CHECK((changes.empty() && inserts.empty() && erases == idx_t{i}));
+        check_diff(v, v.push_front(n).push_back(n));
+        CHECK((changes.empty() && inserts == idx_t{0, n + 1}
+               && erases.empty()));
+    }
+}
+
+namespace {
+
+std::size_t diff_comparisons = 0;
+
+struct diff_counted
+{
+    unsigned value;
+
+    bool operator== (const diff_counted& other) const
+    {
+        ++diff_comparisons;
+        return value == other.value;
+    }
+};
+
+} // anonymous namespace
+
+TEST_CASE("diff cost follows the edits")
+{
+    const auto n = 50000u;
+    auto v = make_test_flex_vector<FLEX_VECTOR_T<diff_counted>>(0, n);
+
+    auto edits = 0u;
+    auto check_cost = [&] (auto a, auto b) {
+        edits = 0u;
+        diff_comparisons = 0u;
+        immer::diff(a, b,
+                    [&] (auto, auto&&) { ++edits; },
+                    [&] (auto, auto&&) { ++edits; },
+                    [&] (auto, auto&&, auto&&) { ++edits; });
+        CHECK(edits == 1u);
+        CHECK(diff_comparisons < n / 10);
+    };
+
+    for (auto i = 0u; i < n; i += 997u) {
+        check_cost(v, v.insert(i, {n}));
+        check_cost(v, v.erase(i));
+        check_cost(v, v.set(i, {n}));
+    }
+    check_cost(v, v.push_front({n}));
+    check_cost(v.push_front({n}), v);
+}
+
+TEST_CASE("insert")
+{
+    const auto n = 666u;
+    auto check = [&] (auto v) {
+        for (auto i : test_irange(0u, n + 1)) {
+            auto vv = v.insert(i, 42u);
+            auto r  = std::vector<unsigned>(v.begin(), v.end());
+            r.insert(r.begin() + i, 42u);
+            CHECK_VECTOR_EQUALS(vv, r);
+        }
+    };
+
+    SECTION("regular") { check(make_test_flex_vector(0, n)); }
+    SECTION("relaxed") { check(make_test_flex_vector_front(0, n)); }
+
+    SECTION("vector")
+    {
+        auto v  = make_test_flex_vector_front(0, n);
+        auto xs = make_test_flex_vector(n, n + 42);
+        for (auto i : test_irange(0u, n + 1)) {
+            auto vv = v.insert(i, xs);
+            auto r  = std::vector<unsigned>(v.begin(), v.end());
+            r.insert(r.begin() + i, xs.begin(), xs.end());
+            CHECK_VECTOR_EQUALS(vv, r);
+        }
+    }
+
+    SECTION("move")
+    {
+        auto v = FLEX_VECTOR_T<unsigned>{};
+        auto r = std::vector<unsigned>{};
+        for (auto i : test_irange(0u, n)) {
+            auto pos = (i * 7u) % (r.size() + 1);
+            v = std::move(v).insert(pos, i);
+            r.insert(r.begin() + pos, i);
+        }
+        CHECK_VECTOR_EQUALS(v, r);
+    }
+}
+
+TEST_CASE("erase")
+{
+    const auto n = 666u;
+    auto check = [&] (auto v) {
+        for (auto i : test_irange(0u, n)) {
+            auto vv = v.erase(i);
+            auto r  = std::vector<unsigned>(v.begin(), v.end());
+            r.erase(r.begin() + i);
+            CHECK_VECTOR_EQUALS(vv, r);
+        }
+        for (auto i : test_irange(0u, n)) {
+            auto last = std::min(n, i + 42u);
+            auto vv = v.erase(i, last);
+            auto r  = std::vector<unsigned>(v.begin(), v.end());
+            r.erase(r.begin() + i, r.begin() + last);
+            CHECK_VECTOR_EQUALS(vv, r);
+        }
+    };
+
+    SECTION("regular") { check(make_test_flex_vector(0, n)); }
+    SECTION("relaxed") { check(make_test_flex_vector_front(0, n)); }
+
+    SECTION("after inserting")
+    {
+        auto v = make_test_flex_vector(0, n);
+        auto r = std::vector<unsigned>(v.begin(), v.end());
+        for (auto i = 0u; i < 4 * n; ++i) {
+            auto pos = (i * 37u) % (r.size() + 1);
+            v = v.insert(pos, n + i);
+            r.insert(r.begin() + pos, n + i);
+        }
+        CHECK_VECTOR_EQUALS(v, r);
+        for (auto i = 0u; r.size() > n; ++i) {
+            auto pos  = (i * 37u) % r.size();
+            auto last = std::min(r.size(), pos + 1 + i % 5u);
+            v = v.erase(pos, last);
+            r.erase(r.begin() + pos, r.begin() + last);
+        }
+        CHECK_VECTOR_EQUALS(v, r);
+        CHECK_VECTOR_EQUALS(v.push_back(n).push_front(n) + v,
+                            boost::join(
+                                boost::join(boost::irange(n, n + 1), r),
+                                boost::join(boost::irange(n, n + 1), r)));
+    }
+
+    SECTION("move")
+    {
+        auto v = make_test_flex_vector_front(0, n);
+        auto r = std::vector<unsigned>(v.begin(), v.end());
+        for (auto k = 0u; !r.empty(); ++k) {
+            auto pos = (k * 37u) % r.size();
+            auto last = std::min(r.size(), pos + 3u);
+            v = std::move(v).erase(pos, last);
+            r.erase(r.begin() + pos, r.begin() + last);
+            CHECK_VECTOR_EQUALS(v, r);
+        }
+    }
+}
+
 #if IMMER_SLOW_TESTS
 TEST_CASE("reconcat")
 {
@@ -359,6 +614,86 @@ TEST_CASE("iterator relaxed")
         CHECK(50u  == *(i2 - 50));
         CHECK(-30  == (i2 - 30) - i2);
     }
+
+    SECTION("jumps back and forth")
+    {
+        auto iter = v.begin();
+        auto i = 0u;
+        for (auto k : test_irange(0u, n)) {
+            auto next = (i + 7919u * k) % n;
+            iter += static_cast<std::ptrdiff_t>(next) - i;
+            i = next;
+            CHECK(*iter == i);
+            CHECK(iter - v.begin() == static_cast<std::ptrdiff_t>(i));
+        }
+    }
+}
+
+TEST_CASE("equals relaxed")
+{
+    const auto n = 666u;
+    auto v = make_test_flex_vector_front(0, n);
+
+    CHECK(v == v);
+    CHECK(v == make_test_flex_vector(0, n));
+    CHECK(make_test_flex_vector(0, n) == v);
+    CHECK(v == make_flex_vector_concat(0, n));
+    CHECK(v != v.push_back(42));
+    CHECK(v != v.push_front(42));
+    CHECK(v != v.drop(1));
+
+    SECTION("one element changed")
+    {
+        for (auto i : test_irange(0u, n)) {
+            auto u = v.set(i, i + 1);
+            CHECK(u != v);
+            CHECK(v != u);
+            CHECK(u.set(i, i) == v);
+            CHECK(make_test_flex_vector(0, n) != u);
+        }
+    }
+
+    SECTION("reconcatenated")
+    {
+        for (auto i : test_irange(0u, n)) {
+            auto u = v.take(i) + v.drop(i);
+            CHECK(u == v);
+            CHECK(v == u);
+            CHECK(u.set(i, 0u) == v.set(i, 0u));
+            CHECK(u.set(i, n) != v);
+        }
+    }
+}
+
+TEST_CASE("hash relaxed")
+{
+    const auto n = 666u;
+    auto v = make_test_flex_vector(0, n);
+    auto h = std::hash<FLEX_VECTOR_T<unsigned>>{};
+    for (auto i : test_irange(0u, n)) {
+        auto vv = v.take(i) + v.drop(i);
+        CHECK(h(vv) == h(v));
+        CHECK(h(vv.drop(i)) == h(make_test_flex_vector_front(i, n)));
+        CHECK(h(vv.push_front(42)) != h(v));
+    }
+
+    SECTION("cached digests follow in place updates")
+    {
+        auto rebuilt = [] (const auto& x) {
+            auto r = FLEX_VECTOR_T<unsigned>{};
+            for (auto e : x) r = r.push_back(e);
+            return r;
+        };
+        auto w = v.take(n / 3) + v.drop(n / 3);
+        for (auto i : test_irange(0u, n / 10)) {
+            CHECK(h(w) == h(rebuilt(w)));
+            w = std::move(w).set(i * 7, i);
+            w = std::move(w).push_front(i);
+            w = std::move(w) + v.take(i);
+            w = std::move(w).drop(i);
+        }
+        CHECK(h(w) == h(rebuilt(w)));
+    }
 }
 
 TEST_CASE("adopt regular vector contents")
@@ -369,6 +704,7 @@ TEST_CASE("adopt regular vector contents")
         v = v.push_back(i);
         auto fv = FLEX_VECTOR_T<unsigned>{v};
         CHECK_VECTOR_EQUALS_X(v, fv, [] (auto&& v) { return &v; });
+        CHECK(immer::hash_value(fv) == immer::hash_value(v));
     }
 }
 
@@ -430,6 +766,48 @@ TEST_CASE("exception safety relaxed")
         IMMER_TRACE_E(d.happenings);
     }
 
+    SECTION("insert")
+    {
+        using value_t = typename dadaist_vector_t::value_type;
+        auto v = make_test_flex_vector_front<dadaist_vector_t>(0, n);
+        auto ir = boost::irange(0u, n);
+        auto r  = std::vector<unsigned>(ir.begin(), ir.end());
+        auto d = dadaism{};
+        for (auto i = 0u; i < n;) {
+            auto pos = (i * 37u) % r.size();
+            auto s = d.next();
+            try {
+                v = v.insert(pos, value_t{n + i});
+                r.insert(r.begin() + pos, n + i);
+                ++i;
+            } catch (dada_error) {}
+            CHECK_VECTOR_EQUALS(v, r);
+        }
+        CHECK(d.happenings > 0);
+        IMMER_TRACE_E(d.happenings);
+    }
+
+    SECTION("erase")
+    {
+        auto v = make_test_flex_vector_front<dadaist_vector_t>(0, n);
+        auto ir = boost::irange(0u, n);
+        auto r  = std::vector<unsigned>(ir.begin(), ir.end());
+        auto d = dadaism{};
+        for (auto i = 0u; r.size() > n / 2;) {
+            auto pos  = (i * 37u) % r.size();
+            auto last = std::min(r.size(), pos + 1 + i % 5u);
+            auto s = d.next();
+            try {
+                v = v.erase(pos, last);
+                r.erase(r.begin() + pos, r.begin() + last);
+                ++i;
+            } catch (dada_error) {}
+            CHECK_VECTOR_EQUALS(v, r);
+        }
+        CHECK(d.happenings > 0);
+        IMMER_TRACE_E(d.happenings);
+    }
+
     SECTION("concat")
     {
         auto v = make_test_flex_vector<dadaist_vector_t>(0, n);
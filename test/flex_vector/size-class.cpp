@@ -0,0 +1,36 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <immer/flex_vector.hpp>
+#include <immer/vector.hpp>
+
+using size_class_memory_policy = immer::memory_policy<
+    immer::size_class_free_list_heap_policy<immer::malloc_heap>,
+    immer::default_refcount_policy>;
+
+template <typename T>
+using test_flex_vector_t = immer::flex_vector<T, size_class_memory_policy>;
+
+template <typename T>
+using test_vector_t = immer::vector<T, size_class_memory_policy>;
+
+#define FLEX_VECTOR_T test_flex_vector_t
+#define VECTOR_T      test_vector_t
+#include "generic.ipp"
@@ -22,6 +22,9 @@
 #include "../util.hpp"
 
 #include <immer/algorithm.hpp>
+#include <immer/heap/heap_policy.hpp>
+#include <immer/heap/malloc_heap.hpp>
+#include <immer/refcount/refcount_policy.hpp>
 
 #include <catch.hpp>
 #include <boost/range/adaptors.hpp>
@@ -31,6 +34,7 @@
 #include <numeric>
 #include <vector>
 #include <array>
+#include <random>
 
 #ifndef FLEX_VECTOR_T
 #error "define the vector template to use in FLEX_VECTOR_T"
@@ -113,6 +117,131 @@ TEST_CASE("drop move")
     CHECK_VECTOR_EQUALS(v, boost::irange(1u, 2u));
 }
 
+TEST_CASE("insert and erase")
+{
+    const auto n = 666u;
+    auto t = make_test_flex_vector_front(0, n).transient();
+    auto r = std::vector<unsigned>(t.begin(), t.end());
+
+    for (auto i : test_irange(0u, n)) {
+        auto pos = (i * 13u) % (r.size() + 1);
+        t.insert(pos, n + i);
+        r.insert(r.begin() + pos, n + i);
+    }
+    CHECK_VECTOR_EQUALS(t, r);
+
+    auto xs = make_test_flex_vector_front(0, 42u);
+    t.insert(n / 2, xs);
+    r.insert(r.begin() + n / 2, xs.begin(), xs.end());
+    CHECK_VECTOR_EQUALS(t, r);
+
+    auto ys = make_test_flex_vector_front(0, 3u);
+    t.insert(n / 3, ys);
+    r.insert(r.begin() + n / 3, ys.begin(), ys.end());
+    CHECK_VECTOR_EQUALS(t, r);
+
+    for (auto k = 0u; !r.empty(); ++k) {
+        auto pos = (k * 37u) % r.size();
+        if (r.size() % 2) {
+            t.erase(pos);
+            r.erase(r.begin() + pos);
+        } else {
+            auto last = std::min(r.size(), pos + 5u);
+            t.erase(pos, last);
+            r.erase(r.begin() + pos, r.begin() + last);
+        }
+        CHECK_VECTOR_EQUALS(t, r);
+    }
+}
+
+namespace {
+
+template <typename V>
+void check_mixed_edits(unsigned seeds, unsigned steps)
+{
+    for (auto seed : test_irange(0u, seeds)) {
+        auto g = std::mt19937{seed};
+        auto v = make_test_flex_vector_front<V>(0, 40u);
+        auto r = std::vector<unsigned>(v.begin(), v.end());
+        for (auto step = 0u; step < steps; ++step) {
+            auto x  = unsigned(g() % 1000u);
+            auto n  = r.size();
+            auto i  = n ? g() % (n + 1) : 0u;
+            auto j  = n ? g() % n : 0u;
+            auto op = g() % 11u;
+            if (op == 0) {
+                v = v.insert(i, x);
+                r.insert(r.begin() + i, x);
+            } else if (op == 1 && n) {
+                v = v.erase(j);
+                r.erase(r.begin() + j);
+            } else if (op == 2) {
+                auto t = v.transient();
+                t.insert(i, x);
+                r.insert(r.begin() + i, x);
+                v = t.persistent();
+            } else if (op == 3 && n) {
+                auto t = v.transient();
+                t.erase(j);
+                r.erase(r.begin() + j);
+                v = t.persistent();
+            } else if (op == 4) {
+                v = v.push_front(x);
+                r.insert(r.begin(), x);
+            } else if (op == 5) {
+                auto t = v.transient();
+                t.push_back(x);
+                r.push_back(x);
+                v = t.persistent();
+            } else if (op == 6) {
+                auto t = v.transient();
+                t.take(i);
+                r.resize(i);
+                v = t.persistent();
+            } else if (op == 7) {
+                auto t = v.transient();
+                t.drop(i);
+                r.erase(r.begin(), r.begin() + i);
+                v = t.persistent();
+            } else if (op == 8 && n) {
+                v = std::move(v).erase(j);
+                r.erase(r.begin() + j);
+            } else if (op == 9) {
+                v = std::move(v).insert(i, x);
+                r.insert(r.begin() + i, x);
+            } else if (op == 10) {
+                v = v.take(i) + v;
+                auto l = std::vector<unsigned>(r.begin(), r.begin() + i);
+                r.insert(r.begin(), l.begin(), l.end());
+                if (r.size() > 300u) {
+                    v = v.take(100u);
+                    r.resize(100u);
+                }
+            }
+            CHECK_VECTOR_EQUALS(v, r);
+        }
+    }
+}
+
+} // anonymous namespace
+
+TEST_CASE("mixed transient and persistent edits")
+{
+    SECTION("default")
+    {
+        check_mixed_edits<FLEX_VECTOR_T<unsigned>>(20u, 200u);
+    }
+
+    SECTION("small branching")
+    {
+        using memory_t = immer::memory_policy<
+            immer::heap_policy<immer::malloc_heap>,
+            immer::refcount_policy>;
+        check_mixed_edits<immer::flex_vector<unsigned, memory_t, 2u, 2u>>(
+            20u, 200u);
+    }
+}
+
 TEST_CASE("exception safety relaxed")
 {
     using dadaist_vector_t = typename dadaist_vector<FLEX_VECTOR_T<unsigned>>::type;
@@ -0,0 +1,423 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "../util.hpp"
+#include "../dada.hpp"
+
+#include <catch.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <unordered_set>
+#include <vector>
+
+#ifndef MAP_T
+#error "define the map template to use in MAP_T"
+#endif
+
+template <typename T=unsigned>
+auto make_generator()
+{
+    auto engine = std::default_random_engine{42};
+    auto distribution = std::uniform_int_distribution<T>{};
+    return std::bind(distribution, engine);
+}
+
+struct conflictor
+{
+    unsigned v1;
+    unsigned v2;
+
+    bool operator== (const conflictor& x) const
+    { return v1 == x.v1 && v2 == x.v2; }
+};
+
+struct hash_conflictor
+{
+    std::size_t operator() (const conflictor& x) const
+    { return x.v1; }
+};
+
+auto make_values_with_collisions(unsigned n)
+{
+    auto gen = make_generator();
+    auto vals = std::vector<std::pair<conflictor, unsigned>>{};
+    auto vals_ = std::unordered_set<unsigned>{};
+    auto i = 0u;
+    std::generate_n(std::back_inserter(vals), n, [&] {
+        auto newv = 0u;
+        do {
+            newv = gen();
+        } while (vals_.count(newv));
+        vals_.insert(newv);
+        return std::make_pair(conflictor{newv % (n / 4), newv}, i++);
+    });
+    return vals;
+}
+
+auto make_test_map(unsigned n)
+{
+    auto s = MAP_T<unsigned, unsigned>{};
+    for (auto i = 0u; i < n; ++i)
+        s = s.insert({i, i});
+    return s;
+}
+
+auto make_test_map(const std::vector<std::pair<conflictor, unsigned>>& vals)
+{
+    auto s = MAP_T<conflictor, unsigned, hash_conflictor>{};
+    for (auto&& v : vals)
+        s = s.insert(v);
+    return s;
+}
+
+TEST_CASE("instantiation")
+{
+    auto v = MAP_T<int, int>{};
+    CHECK(v.size() == 0u);
+    CHECK(v.empty());
+}
+
+TEST_CASE("basic insertion")
+{
+    auto v1 = MAP_T<int, int>{};
+    CHECK(v1.count(42) == 0);
+
+    auto v2 = v1.insert({42, {}});
+    CHECK(v1.count(42) == 0);
+    CHECK(v2.count(42) == 1);
+
+    auto v3 = v2.insert({42, {}});
+    CHECK(v1.count(42) == 0);
+    CHECK(v2.count(42) == 1);
+    CHECK(v3.count(42) == 1);
+    CHECK(v3.size() == 1);
+}
+
+TEST_CASE("accessor")
+{
+    const auto n = 666u;
+    auto v = make_test_map(n);
+    CHECK(v[0] == 0);
+    CHECK(v[42] == 42);
+    CHECK(v[665] == 665);
+    CHECK(v[666] == 0);
+    CHECK(v[1234] == 0);
+}
+
+TEST_CASE("at")
+{
+    const auto n = 666u;
+    auto v = make_test_map(n);
+    CHECK(v.at(0) == 0);
+    CHECK(v.at(42) == 42);
+    CHECK(v.at(665) == 665);
+    CHECK_THROWS_AS(v.at(666), std::out_of_range);
+    CHECK_THROWS_AS(v.at(1234), std::out_of_range);
+}
+
+TEST_CASE("find")
+{
+    const auto n = 666u;
+    auto v = make_test_map(n);
+    CHECK(*v.find(0) == 0);
+    CHECK(*v.find(42) == 42);
+    CHECK(*v.find(665) == 665);
+    CHECK(v.find(666) == nullptr);
+    CHECK(v.find(1234) == nullptr);
+}
+
+TEST_CASE("set")
+{
+    const auto n = 666u;
+    auto v = make_test_map(n);
+    auto u = v.set(42, 1000u).set(1234, 7u);
+    CHECK(u.size() == n + 1);
+    CHECK(u[42] == 1000u);
+    CHECK(u[1234] == 7u);
+    CHECK(v.size() == n);
+    CHECK(v[42] == 42u);
+    CHECK(v.count(1234) == 0);
+}
+
+TEST_CASE("equals and setting")
+{
+    const auto n = 666u;
+    auto v = make_test_map(n);
+    for (auto i = 0u; i < n; ++i) {
+        v = v.set(i, i * 2);
+        CHECK(v[i] == i * 2);
+    }
+    CHECK(v.size() == n);
+    for (auto i = 0u; i < n; ++i)
+        CHECK(v[i] == i * 2);
+}
+
+TEST_CASE("iterator")
+{
+    const auto N = 666u;
+    auto v = make_test_map(N);
+
+    SECTION("empty set")
+    {
+        auto s = MAP_T<unsigned, unsigned>{};
+        CHECK(s.begin() == s.end());
+    }
+
+    SECTION("works with range loop")
+    {
+        auto seen = std::unordered_set<unsigned>{};
+        for (const auto& x : v) {
+            CHECK(x.first == x.second);
+            CHECK(seen.insert(x.first).second);
+        }
+        CHECK(seen.size() == v.size());
+        for (auto i = 0u; i < N; ++i)
+            CHECK(seen.count(i) == 1);
+    }
+
+    SECTION("iterator and collisions")
+    {
+        auto vals = make_values_with_collisions(N);
+        auto s = make_test_map(vals);
+        auto seen = std::unordered_set<unsigned>{};
+        for (const auto& x : s)
+            CHECK(seen.insert(x.second).second);
+        CHECK(seen.size() == s.size());
+        CHECK(s.size() == N);
+    }
+
+    SECTION("agrees with for_each_chunk")
+    {
+        auto count = std::size_t{};
+        v.for_each_chunk([&] (auto f, auto l) {
+            for (; f != l; ++f, ++count)
+                CHECK(f->first == f->second);
+        });
+        CHECK(count == v.size());
+    }
+}
+
+TEST_CASE("update")
+{
+    const auto n = 666u;
+    auto v = make_test_map(n);
+
+    SECTION("existing keys")
+    {
+        auto u = v;
+        for (auto i = 0u; i < n; ++i)
+            u = u.update(i, [] (auto x) { return x + 1; });
+        CHECK(u.size() == n);
+        for (auto i = 0u; i < n; ++i) {
+            CHECK(u[i] == i + 1);
+            CHECK(v[i] == i);
+        }
+    }
+
+    SECTION("new keys")
+    {
+        auto u = v;
+        for (auto i = n; i < 2 * n; ++i)
+            u = u.update(i, [] (auto x) { return x + 1; });
+        CHECK(u.size() == 2 * n);
+        for (auto i = n; i < 2 * n; ++i)
+            CHECK(u[i] == 1u);
+        CHECK(v.size() == n);
+    }
+}
+
+TEST_CASE("erase")
+{
+    const auto n = 666u;
+
+    SECTION("not found")
+    {
+        auto v = make_test_map(n);
+        auto u = v.erase(1234);
+        CHECK(u.size() == n);
+        CHECK(u.impl().root == v.impl().root);
+    }
+
+    SECTION("all, one by one")
+    {
+        auto v = make_test_map(n);
+        auto u = v;
+        for (auto i = 0u; i < n; ++i) {
+            u = u.erase(i);
+            CHECK(u.size() == n - i - 1);
+            CHECK(u.count(i) == 0);
+            if (i + 1 < n)
+                CHECK(u[n - 1] == n - 1);
+        }
+        CHECK(u.empty());
+        CHECK(u.begin() == u.end());
+        CHECK(v.size() == n);
+        for (auto i = 0u; i < n; ++i)
+            CHECK(v[i] == i);
+    }
+}
+
+TEST_CASE("collisions")
+{
+    const auto n = 666u;
+    auto vals = make_values_with_collisions(n);
+    auto v = make_test_map(vals);
+    CHECK(v.size() == n);
+    for (auto&& x : vals)
+        CHECK(v[x.first] == x.second);
+
+    SECTION("erase")
+    {
+        auto u = v;
+        for (auto i = 0u; i < n; ++i) {
+            u = u.erase(vals[i].first);
+            CHECK(u.size() == n - i - 1);
+            CHECK(u.count(vals[i].first) == 0);
+            for (auto j = i + 1; j < n; j += 7)
+                CHECK(u[vals[j].first] == vals[j].second);
+        }
+        CHECK(u.empty());
+    }
+
+    SECTION("set")
+    {
+        auto u = v;
+        for (auto&& x : vals)
+            u = u.set(x.first, x.second + 1);
+        CHECK(u.size() == n);
+        for (auto&& x : vals) {
+            CHECK(u[x.first] == x.second + 1);
+            CHECK(v[x.first] == x.second);
+        }
+    }
+}
+
+namespace {
+
+struct constant_hash
+{
+    template <typename T>
+    std::size_t operator() (const T&) const { return 42; }
+};
+
+} // anonymous namespace
+
+TEST_CASE("full hash collisions")
+{
+    const auto n = 66u;
+    auto v = MAP_T<unsigned, unsigned, constant_hash>{};
+    for (auto i = 0u; i < n; ++i)
+        v = v.set(i, i);
+    CHECK(v.size() == n);
+    for (auto i = 0u; i < n; ++i)
+        CHECK(v[i] == i);
+
+    auto count = 0u;
+    for (auto&& x : v) {
+        CHECK(x.first == x.second);
+        ++count;
+    }
+    CHECK(count == n);
+
+    auto u = v;
+    for (auto i = 0u; i < n; i += 2)
+        u = u.erase(i);
+    CHECK(u.size() == n / 2);
+    for (auto i = 0u; i < n; ++i)
+        CHECK(u.count(i) == i % 2);
+    for (auto i = 1u; i < n; i += 2)
+        u = u.erase(i);
+    CHECK(u.empty());
+    CHECK(v.size() == n);
+}
+
+TEST_CASE("exception safety")
+{
+    constexpr auto n = 666u;
+
+    using dadaist_map_t = MAP_T<
+        unsigned, dadaist<unsigned>,
+        std::hash<unsigned>, std::equal_to<unsigned>,
+        dadaist_memory_policy<
+            typename MAP_T<unsigned, unsigned>::memory_policy>>;
+
+    SECTION("insert")
+    {
+        auto v = dadaist_map_t{};
+        auto d = dadaism{};
+        for (auto i = 0u; v.size() < n;) {
+            auto s = d.next();
+            try {
+                v = v.set(i, i);
+                ++i;
+            } catch (dada_error) {}
+            for (auto j = 0u; j < i; j += 3)
+                CHECK(v.at(j).value == j);
+        }
+        CHECK(d.happenings > 0);
+        IMMER_TRACE_E(d.happenings);
+    }
+
+    SECTION("set existing")
+    {
+        auto v = dadaist_map_t{};
+        for (auto i = 0u; i < n; ++i)
+            v = v.set(i, i);
+        auto d = dadaism{};
+        for (auto i = 0u; i < n;) {
+            auto s = d.next();
+            try {
+                v = v.set(i, i + 1);
+                ++i;
+            } catch (dada_error) {}
+            CHECK(v.size() == n);
+            for (auto j = 0u; j < i; j += 3)
+                CHECK(v.at(j).value == j + 1);
+            for (auto j = i; j < n; j += 3)
+                CHECK(v.at(j).value == j);
+        }
+        CHECK(d.happenings > 0);
+        IMMER_TRACE_E(d.happenings);
+    }
+
+    SECTION("erase")
+    {
+        auto v = dadaist_map_t{};
+        for (auto i = 0u; i < n; ++i)
+            v = v.set(i, i);
+        auto d = dadaism{};
+        for (auto i = 0u; i < n;) {
+            auto s = d.next();
+            try {
+                v = v.erase(i);
+                ++i;
+            } catch (dada_error) {}
+            CHECK(v.size() == n - i);
+            for (auto j = i; j < n; j += 3)
+                CHECK(v.at(j).value == j);
+        }
+        CHECK(d.happenings > 0);
+        IMMER_TRACE_E(d.happenings);
+    }
+}
@@ -0,0 +1,137 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#define IMMER_HEAP_STATS 1
+
+#include <immer/heap/free_list_heap.hpp>
+#include <immer/heap/heap_stats.hpp>
+#include <immer/heap/malloc_heap.hpp>
+#include <immer/heap/thread_local_free_list_heap.hpp>
+
+#include <catch.hpp>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace {
+
+immer::heap_stats find_stats(const char* heap,
+                             std::size_t size,
+                             std::thread::id thread = std::this_thread::get_id())
+{
+    for (auto s : immer::heap_stats_snapshot())
+        if (!std::strcmp(s.heap, heap) && s.size == size && s.thread == thread)
+            return s;
+    return { heap, size, thread, 0, 0, 0, 0, 0, 0, 0, true };
+}
+
+} // anonymous namespace
+
+TEST_CASE("malloc stats")
+{
+    auto old = find_stats("malloc_heap", 0);
+    auto p = immer::malloc_heap::allocate(42u);
+    auto s = find_stats("malloc_heap", 0);
+    CHECK(s.tracks_bytes);
+    CHECK(s.bytes_in_use() == old.bytes_in_use() + 42);
+    immer::malloc_heap::deallocate(p);
+    s = find_stats("malloc_heap", 0);
+    CHECK(s.allocations == old.allocations + 1);
+    CHECK(s.deallocations == old.deallocations + 1);
+    CHECK(s.bytes_allocated == old.bytes_allocated + 42);
+    CHECK(s.bytes_deallocated == old.bytes_deallocated + 42);
+    CHECK(s.bytes_in_use() == old.bytes_in_use());
+}
+
+TEST_CASE("free list stats")
+{
+    using global_heap = immer::free_list_heap<24u, 8, immer::malloc_heap>;
+    using heap = immer::thread_local_free_list_heap<24u, 8, global_heap>;
+
+    auto p = heap::allocate(24u);
+    auto s = find_stats("thread_local_free_list_heap", 24u);
+    CHECK(s.allocations == 1u);
+    CHECK(s.misses == 1u);
+    CHECK(s.bytes_in_use() == 24);
+    CHECK(find_stats("free_list_heap", 24u).misses == 1u);
+
+    heap::deallocate(p);
+    s = find_stats("thread_local_free_list_heap", 24u);
+    CHECK(s.deallocations == 1u);
+    CHECK(s.bytes_parked() == 24);
+
+    p = heap::allocate(24u);
+    s = find_stats("thread_local_free_list_heap", 24u);
+    CHECK(s.hits == 1u);
+    CHECK(s.parked == 0);
+
+    SECTION("finished threads")
+    {
+        std::thread{[] {
+            heap::deallocate(heap::allocate(24u));
+        }}.join();
+        auto f = find_stats("thread_local_free_list_heap", 24u,
+                            std::thread::id{});
+        CHECK(f.allocations == 1u);
+        CHECK(f.deallocations == 1u);
+        CHECK(f.parked == 0);
+        CHECK(find_stats("free_list_heap", 24u, std::thread::id{}).parked == 1);
+    }
+
+    heap::deallocate(p);
+}
+
+namespace {
+
+// frees its objects when the thread finishes, after the thread stats
+// block was retired, because it is constructed before it
+struct late_frees
+{
+    std::vector<void*> objects;
+    ~late_frees()
+    {
+        for (auto p : objects)
+            immer::malloc_heap::deallocate(p);
+    }
+};
+
+} // anonymous namespace
+
+TEST_CASE("frees after the thread stats are retired")
+{
+    constexpr auto threads = 4u;
+    constexpr auto objects = 1000u;
+    auto old = find_stats("malloc_heap", 0, std::thread::id{});
+
+    auto ts = std::vector<std::thread>{};
+    for (auto i = 0u; i < threads; ++i)
+        ts.emplace_back([] {
+            thread_local late_frees frees;
+            for (auto j = 0u; j < objects; ++j)
+                frees.objects.push_back(immer::malloc_heap::allocate(8u));
+        });
+    for (auto& t : ts)
+        t.join();
+
+    auto s = find_stats("malloc_heap", 0, std::thread::id{});
+    CHECK(s.allocations == old.allocations + threads * objects);
+    CHECK(s.deallocations == old.deallocations + threads * objects);
+    CHECK(s.bytes_in_use() == old.bytes_in_use());
+}
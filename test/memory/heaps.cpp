@@ -22,9 +22,14 @@
 #include <immer/heap/free_list_heap.hpp>
 #include <immer/heap/thread_local_free_list_heap.hpp>
 #include <immer/heap/gc_heap.hpp>
+#include <immer/heap/size_class_heap.hpp>
+#include <immer/heap/arena_heap.hpp>
+#include <immer/heap/slab_heap.hpp>
 
 #include <catch.hpp>
+#include <atomic>
 #include <numeric>
+#include <thread>
 
 void do_stuff_to(void* buf, std::size_t size)
 {
@@ -57,6 +62,109 @@ TEST_CASE("gc")
     }
 }
 
+TEST_CASE("slab")
+{
+    using heap = immer::slab_heap<1u << 16>;
+
+    SECTION("basic")
+    {
+        auto p = heap::allocate(42u);
+        do_stuff_to(p, 42u);
+        heap::deallocate(p);
+    }
+
+    SECTION("reuse")
+    {
+        auto p = heap::allocate(42u);
+        heap::deallocate(p);
+        auto u = heap::allocate(40u);
+        CHECK(u == p);
+        heap::deallocate(u);
+    }
+
+    SECTION("slabs")
+    {
+        auto slabs = heap::slab_count();
+        void* ps[2000];
+        for (auto& p : ps) {
+            p = heap::allocate(64u);
+            do_stuff_to(p, 64u);
+        }
+        CHECK(heap::slab_count() > slabs + 1);
+        CHECK(heap::mapped_bytes() >= heap::slab_count() * (1u << 16));
+        for (auto p : ps)
+            heap::deallocate(p);
+        CHECK(heap::slab_count() <= slabs + 1);
+    }
+
+    SECTION("many sizes")
+    {
+        void* ps[64];
+        for (auto i = 0u; i < 64u; ++i) {
+            ps[i] = heap::allocate((i + 1) * 16u);
+            do_stuff_to(ps[i], (i + 1) * 16u);
+        }
+        for (auto p : ps)
+            heap::deallocate(p);
+    }
+
+    SECTION("big")
+    {
+        auto slabs = heap::slab_count();
+        auto p = heap::allocate(100000u);
+        do_stuff_to(p, 100000u);
+        CHECK(heap::slab_count() == slabs + 1);
+        heap::deallocate(p);
+        CHECK(heap::slab_count() == slabs);
+    }
+}
+
+TEST_CASE("arena")
+{
+    using heap = immer::arena_heap;
+
+    SECTION("basic")
+    {
+        immer::arena a;
+        auto p = heap::allocate(42u);
+        do_stuff_to(p, 42u);
+        heap::deallocate(p);
+    }
+
+    SECTION("bump")
+    {
+        immer::arena a{256u};
+        CHECK(immer::arena::current() == &a);
+        auto p = static_cast<char*>(heap::allocate(8u));
+        auto u = static_cast<char*>(heap::allocate(8u));
+        CHECK(u - p == alignof(std::max_align_t));
+        auto big = heap::allocate(1000u);
+        do_stuff_to(big, 1000u);
+        auto v = static_cast<char*>(heap::allocate(8u));
+        CHECK(v - u == alignof(std::max_align_t));
+    }
+
+    SECTION("nested")
+    {
+        immer::arena a;
+        {
+            immer::arena b;
+            CHECK(immer::arena::current() == &b);
+        }
+        CHECK(immer::arena::current() == &a);
+    }
+
+    SECTION("no arena")
+    {
+        CHECK(heap::allocate(42u) == nullptr);
+        auto p = heap::allocate_immortal(42u);
+        do_stuff_to(p, 42u);
+        immer::malloc_heap::deallocate(p);
+    }
+
+    CHECK(immer::arena::current() == nullptr);
+}
+
 template <typename Heap>
 void test_free_list_heap()
 {
@@ -97,3 +205,246 @@ TEST_CASE("unsafe free_list")
 {
     test_free_list_heap<immer::unsafe_free_list_heap<42u, 2, immer::malloc_heap>>();
 }
+
+TEST_CASE("free list budget")
+{
+    using heap = immer::free_list_heap<24u, 8, immer::malloc_heap>;
+    constexpr auto block = 24u + sizeof(immer::free_list_node);
+
+    immer::trim_free_lists();
+    auto old_budget = immer::free_list_budget();
+    immer::set_free_list_budget(2 * block);
+
+    auto p1 = heap::allocate(24u);
+    auto p2 = heap::allocate(24u);
+    auto p3 = heap::allocate(24u);
+    heap::deallocate(p1);
+    heap::deallocate(p2);
+    heap::deallocate(p3);
+    CHECK(immer::free_list_parked_bytes() == 2 * block);
+
+    SECTION("reuse gives back budget")
+    {
+        auto p = heap::allocate(24u);
+        CHECK(immer::free_list_parked_bytes() == block);
+        heap::deallocate(p);
+        CHECK(immer::free_list_parked_bytes() == 2 * block);
+    }
+
+    SECTION("trim")
+    {
+        immer::trim_free_lists();
+        CHECK(immer::free_list_parked_bytes() == 0u);
+    }
+
+    immer::trim_free_lists();
+    immer::set_free_list_budget(old_budget);
+}
+
+TEST_CASE("unsafe free list budget")
+{
+    using heap = immer::unsafe_free_list_heap<24u, 8, immer::malloc_heap>;
+    constexpr auto block = 24u + sizeof(immer::free_list_node);
+
+    immer::trim_free_lists();
+    auto old_budget = immer::free_list_budget();
+
+    SECTION("reserved in batches")
+    {
+        auto p1 = heap::allocate(24u);
+        auto p2 = heap::allocate(24u);
+        heap::deallocate(p1);
+        CHECK(immer::free_list_parked_bytes() == 8 * block);
+        heap::deallocate(p2);
+        CHECK(immer::free_list_parked_bytes() == 8 * block);
+        p1 = heap::allocate(24u);
+        CHECK(immer::free_list_parked_bytes() == 8 * block);
+        heap::deallocate(p1);
+    }
+
+    SECTION("falls back to single objects")
+    {
+        immer::set_free_list_budget(2 * block);
+        auto p1 = heap::allocate(24u);
+        auto p2 = heap::allocate(24u);
+        auto p3 = heap::allocate(24u);
+        heap::deallocate(p1);
+        heap::deallocate(p2);
+        heap::deallocate(p3);
+        CHECK(immer::free_list_parked_bytes() == 2 * block);
+    }
+
+    immer::trim_free_lists();
+    CHECK(immer::free_list_parked_bytes() == 0u);
+    immer::set_free_list_budget(old_budget);
+}
+
+struct counting_heap
+{
+    static std::size_t live;
+
+    static void* allocate(std::size_t size)
+    {
+        ++live;
+        return immer::malloc_heap::allocate(size);
+    }
+
+    static void deallocate(void* data)
+    {
+        --live;
+        immer::malloc_heap::deallocate(data);
+    }
+};
+
+std::size_t counting_heap::live = 0;
+
+TEST_CASE("trim thread local free list")
+{
+    using heap = immer::thread_local_free_list_heap<
+        24u, 8, immer::free_list_heap<24u, 8, counting_heap>>;
+
+    immer::trim_free_lists();
+    auto p = heap::allocate(24u);
+    heap::deallocate(p);
+    CHECK(counting_heap::live == 1u);
+    CHECK(immer::free_list_parked_bytes() == 0u);
+
+    immer::trim_free_lists();
+    CHECK(counting_heap::live == 0u);
+    CHECK(immer::free_list_parked_bytes() == 0u);
+}
+
+TEST_CASE("thread local free list batches")
+{
+    using heap = immer::thread_local_free_list_heap<
+        24u, 4, immer::free_list_heap<24u, 4, counting_heap>>;
+
+    immer::trim_free_lists();
+    auto live = counting_heap::live;
+    void* ps[4];
+    for (auto& p : ps)
+        p = heap::allocate(24u);
+    CHECK(counting_heap::live == live + 4);
+
+    // magazines freed by other thread are reused by this one
+    std::thread{[&] {
+        for (auto p : ps)
+            heap::deallocate(p);
+    }}.join();
+    CHECK(counting_heap::live == live + 4);
+    for (auto& p : ps)
+        p = heap::allocate(24u);
+    CHECK(counting_heap::live == live + 4);
+
+    for (auto p : ps)
+        heap::deallocate(p);
+    immer::trim_free_lists();
+    CHECK(counting_heap::live == live);
+}
+
+TEST_CASE("trim idle free list of other thread")
+{
+    using heap = immer::thread_local_free_list_heap<
+        24u, 4, immer::free_list_heap<24u, 4, counting_heap>, true>;
+
+    immer::trim_free_lists();
+    auto live = counting_heap::live;
+    void* ps[3];
+    for (auto& p : ps)
+        p = heap::allocate(24u);
+
+    std::atomic<bool> parked{false};
+    std::atomic<bool> done{false};
+    auto t = std::thread{[&] {
+        for (auto p : ps)
+            heap::deallocate(p);
+        parked = true;
+        while (!done)
+            std::this_thread::yield();
+    }};
+    while (!parked)
+        std::this_thread::yield();
+
+    // the previous magazine is taken away from the other thread
+    immer::trim_free_lists();
+    CHECK(counting_heap::live == live + 1);
+
+    done = true;
+    t.join();
+    immer::trim_free_lists();
+    CHECK(counting_heap::live == live);
+}
+
+TEST_CASE("free list keeps single objects")
+{
+    using heap = immer::free_list_heap<24u, 100, counting_heap>;
+
+    immer::trim_free_lists();
+    auto live = counting_heap::live;
+    void* ps[100];
+    for (auto& p : ps)
+        p = heap::allocate(24u);
+    for (auto p : ps)
+        heap::deallocate(p);
+    CHECK(counting_heap::live == live + 100);
+    CHECK(immer::free_list_parked_bytes() == 100 * (24u + sizeof(immer::free_list_node)));
+
+    for (auto& p : ps)
+        p = heap::allocate(24u);
+    CHECK(counting_heap::live == live + 100);
+    CHECK(immer::free_list_parked_bytes() == 0u);
+
+    for (auto p : ps)
+        heap::deallocate(p);
+    immer::trim_free_lists();
+    CHECK(counting_heap::live == live);
+}
+
+template <std::size_t Size>
+using test_class_heap = immer::unsafe_free_list_heap<Size, 2, immer::malloc_heap>;
+
+TEST_CASE("size class free list")
+{
+    using heap = immer::size_class_heap<test_class_heap, 64u, 16u, 32u>;
+
+    CHECK(heap::size_class(1u) == 1u);
+    CHECK(heap::size_class(16u) == 1u);
+    CHECK(heap::size_class(17u) == 2u);
+    CHECK(heap::size_class(33u) == 0u);
+    CHECK(heap::size_class(64u) == 0u);
+
+    SECTION("basic")
+    {
+        auto p = heap::allocate(42u);
+        do_stuff_to(p, 42u);
+        heap::deallocate(p);
+    }
+
+    SECTION("reuse within the same class")
+    {
+        auto p = heap::allocate(20u);
+        do_stuff_to(p, 20u);
+        heap::deallocate(p);
+
+        auto u = heap::allocate(32u);
+        do_stuff_to(u, 32u);
+        heap::deallocate(u);
+        CHECK(u == p);
+    }
+
+    SECTION("classes do not share memory")
+    {
+        auto p = heap::allocate(10u);
+        do_stuff_to(p, 10u);
+        heap::deallocate(p);
+
+        auto u = heap::allocate(50u);
+        do_stuff_to(u, 50u);
+        auto v = heap::allocate(10u);
+        do_stuff_to(v, 10u);
+        CHECK(u != p);
+        CHECK(v == p);
+        heap::deallocate(u);
+        heap::deallocate(v);
+    }
+}
@@ -18,12 +18,17 @@
 // along with immer.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include <immer/refcount/biased_refcount_policy.hpp>
 #include <immer/refcount/refcount_policy.hpp>
 #include <immer/refcount/unsafe_refcount_policy.hpp>
 #include <immer/refcount/no_refcount_policy.hpp>
 
 #include <catch.hpp>
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 TEST_CASE("no refcount has no data")
 {
     static_assert(std::is_empty<immer::no_refcount_policy>{}, "");
@@ -75,3 +80,110 @@ TEST_CASE("thread unsafe refcount")
 {
     test_refcount<immer::unsafe_refcount_policy>();
 }
+
+template <typename RefcountPolicy>
+void test_released_once()
+{
+    for (auto round = 0; round < 100; ++round) {
+        RefcountPolicy elem{};
+        std::atomic<int> released{0};
+        auto threads = std::vector<std::thread>{};
+        for (auto i = 0; i < 4; ++i)
+            elem.inc();
+        for (auto i = 0; i < 4; ++i)
+            threads.emplace_back([&] {
+                for (auto j = 0; j < 100; ++j) {
+                    elem.inc();
+                    released += elem.dec();
+                }
+                released += elem.dec();
+            });
+        released += elem.dec();
+        for (auto& t : threads)
+            t.join();
+        CHECK(released == 1);
+    }
+}
+
+TEST_CASE("refcount is released once")
+{
+    test_released_once<immer::refcount_policy>();
+}
+
+TEST_CASE("biased refcount")
+{
+    test_refcount<immer::biased_refcount_policy>();
+}
+
+TEST_CASE("biased refcount is released once")
+{
+    test_released_once<immer::biased_refcount_policy>();
+}
+
+TEST_CASE("biased refcount handoff")
+{
+    using refcount = immer::biased_refcount_policy;
+
+    SECTION("other thread releases last")
+    {
+        refcount elem{};
+        elem.inc();
+        CHECK(!elem.dec());
+        auto released = true;
+        std::thread{[&] { released = elem.dec(); }}.join();
+        CHECK(released);
+    }
+
+    SECTION("owner releases last")
+    {
+        refcount elem{};
+        elem.inc();
+        auto released = true;
+        std::thread{[&] { released = elem.dec(); }}.join();
+        CHECK(!released);
+        CHECK(elem.dec());
+    }
+
+    SECTION("owner releases references from other threads")
+    {
+        refcount elem{};
+        std::thread{[&] {
+            elem.inc();
+            elem.inc();
+        }}.join();
+        CHECK(!elem.dec());
+        CHECK(!elem.dec());
+        CHECK(elem.dec());
+    }
+
+    SECTION("other thread releases after the owner")
+    {
+        refcount elem{};
+        std::thread{[&] { elem.inc(); }}.join();
+        CHECK(!elem.dec());
+        auto unique = false;
+        auto released = false;
+        std::thread{[&] {
+            elem.inc();
+            CHECK(!elem.dec());
+            unique = elem.unique();
+            released = elem.dec();
+        }}.join();
+        CHECK(unique);
+        CHECK(released);
+    }
+
+    SECTION("only the owner sees it unique")
+    {
+        refcount elem{};
+        CHECK(elem.unique());
+        auto unique = true;
+        std::thread{[&] { unique = elem.unique(); }}.join();
+        CHECK(!unique);
+        elem.inc();
+        CHECK(!elem.unique());
+        std::thread{[&] { elem.dec(); }}.join();
+        CHECK(elem.unique());
+        CHECK(elem.dec());
+    }
+}
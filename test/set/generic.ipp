@@ -0,0 +1,134 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "../util.hpp"
+
+#include <catch.hpp>
+
+#include <unordered_set>
+
+#ifndef SET_T
+#error "define the set template to use in SET_T"
+#endif
+
+auto make_test_set(unsigned n)
+{
+    auto s = SET_T<unsigned>{};
+    for (auto i = 0u; i < n; ++i)
+        s = s.insert(i);
+    return s;
+}
+
+namespace {
+
+struct low_bits_hash
+{
+    std::size_t operator() (unsigned x) const { return x % 7; }
+};
+
+} // anonymous namespace
+
+TEST_CASE("instantiation")
+{
+    auto v = SET_T<int>{};
+    CHECK(v.size() == 0u);
+    CHECK(v.empty());
+}
+
+TEST_CASE("basic insertion")
+{
+    auto v1 = SET_T<int>{};
+    CHECK(v1.count(42) == 0);
+
+    auto v2 = v1.insert(42);
+    CHECK(v1.count(42) == 0);
+    CHECK(v2.count(42) == 1);
+
+    auto v3 = v2.insert(42);
+    CHECK(v1.count(42) == 0);
+    CHECK(v2.count(42) == 1);
+    CHECK(v3.count(42) == 1);
+    CHECK(v3.size() == 1);
+}
+
+TEST_CASE("insert a lot")
+{
+    const auto n = 666u;
+    auto s = make_test_set(n);
+    CHECK(s.size() == n);
+    for (auto i = 0u; i < n; ++i) {
+        CHECK(s.count(i) == 1);
+        CHECK(*s.find(i) == i);
+    }
+    CHECK(s.count(n) == 0);
+    CHECK(s.find(n) == nullptr);
+}
+
+TEST_CASE("iterator")
+{
+    const auto n = 666u;
+    auto s = make_test_set(n);
+    auto seen = std::unordered_set<unsigned>{};
+    for (auto&& x : s)
+        CHECK(seen.insert(x).second);
+    CHECK(seen.size() == n);
+    CHECK(SET_T<unsigned>{}.begin() == SET_T<unsigned>{}.end());
+}
+
+TEST_CASE("erase")
+{
+    const auto n = 666u;
+    auto s = make_test_set(n);
+    auto u = s;
+    for (auto i = 0u; i < n; ++i) {
+        u = u.erase(i);
+        CHECK(u.size() == n - i - 1);
+        CHECK(u.count(i) == 0);
+        if (i + 1 < n)
+            CHECK(u.count(i + 1) == 1);
+    }
+    CHECK(u.empty());
+    CHECK(s.size() == n);
+    CHECK(s.erase(n).size() == n);
+}
+
+TEST_CASE("collisions")
+{
+    const auto n = 666u;
+    auto s = SET_T<unsigned, low_bits_hash>{};
+    for (auto i = 0u; i < n; ++i)
+        s = s.insert(i);
+    CHECK(s.size() == n);
+    for (auto i = 0u; i < n; ++i)
+        CHECK(s.count(i) == 1);
+
+    auto seen = std::unordered_set<unsigned>{};
+    for (auto&& x : s)
+        CHECK(seen.insert(x).second);
+    CHECK(seen.size() == n);
+
+    auto u = s;
+    for (auto i = 0u; i < n; ++i) {
+        u = u.erase(i);
+        CHECK(u.size() == n - i - 1);
+        CHECK(u.count(i) == 0);
+    }
+    CHECK(u.empty());
+}
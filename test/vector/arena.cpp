@@ -0,0 +1,69 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <immer/vector.hpp>
+#include <immer/vector_transient.hpp>
+#include <immer/heap/arena_heap.hpp>
+
+#include <new>
+#include <thread>
+
+// every node allocated by the tests lives until the program ends
+immer::arena test_arena;
+
+template <typename T>
+using test_vector_t = immer::vector<T, immer::arena_memory_policy, 3u>;
+
+#define VECTOR_T test_vector_t
+#include "generic.ipp"
+
+TEST_CASE("no current arena")
+{
+    auto empty = false;
+    auto threw = false;
+    std::thread{[&] {
+        auto v = test_vector_t<int>{};
+        empty = v.empty();
+        try {
+            v.push_back(42);
+        } catch (const std::bad_alloc&) {
+            threw = true;
+        }
+    }}.join();
+    CHECK(empty);
+    CHECK(threw);
+}
+
+TEST_CASE("transient with no current arena")
+{
+    auto v = test_vector_t<int>{}.push_back(1).push_back(2);
+    auto threw = false;
+    std::thread{[&] {
+        try {
+            auto t = v.transient();
+            t.set(0, 999);
+        } catch (const std::bad_alloc&) {
+            threw = true;
+        }
+    }}.join();
+    CHECK(threw);
+    CHECK(v[0] == 1);
+    CHECK(v[1] == 2);
+}
@@ -0,0 +1,56 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <immer/vector.hpp>
+#include <immer/refcount/biased_refcount_policy.hpp>
+
+#include <thread>
+
+using biased_memory_policy = immer::memory_policy<
+    immer::heap_policy<immer::malloc_heap>,
+    immer::biased_refcount_policy>;
+
+template <typename T>
+using test_vector_t = immer::vector<T, biased_memory_policy>;
+
+#define VECTOR_T test_vector_t
+#include "generic.ipp"
+
+TEST_CASE("biased refcount across threads")
+{
+    auto v = test_vector_t<unsigned>{};
+    for (auto i = 0u; i < 1000u; ++i)
+        v = v.push_back(i);
+
+    auto results = std::vector<unsigned>(4u);
+    auto threads = std::vector<std::thread>{};
+    for (auto i = 0u; i < 4u; ++i)
+        threads.emplace_back([v, i, &results] {
+            auto w = v;
+            for (auto j = 0u; j < 1000u; ++j)
+                w = w.set(j, w[j] + i);
+            results[i] = w[999];
+        });
+    v = {};
+    for (auto& t : threads)
+        t.join();
+    for (auto i = 0u; i < 4u; ++i)
+        CHECK(results[i] == 999 + i);
+}
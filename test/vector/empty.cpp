@@ -0,0 +1,83 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <immer/vector.hpp>
+#include <immer/vector_transient.hpp>
+#include <immer/flex_vector.hpp>
+#include <immer/flex_vector_transient.hpp>
+
+#include <catch.hpp>
+
+#include <vector>
+
+namespace {
+
+using memory_t = immer::default_memory_policy;
+constexpr auto B  = immer::default_bits;
+constexpr auto BL = immer::detail::rbts::derive_bits_leaf<int, memory_t, B>;
+
+template <typename Vector, typename Impl>
+void check_empty_nodes_are_not_counted()
+{
+    using node_t = typename Impl::node_t;
+
+    auto root = Impl::empty.root;
+    auto tail = Impl::empty.tail;
+    CHECK(root->is_immortal());
+    CHECK(tail->is_immortal());
+    CHECK(!node_t::refs(root).unique());
+    CHECK(!node_t::refs(tail).unique());
+
+    auto root_refs = node_t::refs(root).refcount.load();
+    auto tail_refs = node_t::refs(tail).refcount.load();
+    {
+        auto v  = Vector{};
+        auto vs = std::vector<Vector>(42, v);
+        CHECK(node_t::refs(root).refcount.load() == root_refs);
+        CHECK(node_t::refs(tail).refcount.load() == tail_refs);
+
+        auto t = v.transient();
+        t.push_back(42);
+        CHECK(t.size() == 1);
+        CHECK(v.size() == 0);
+        CHECK(tail->leaf() != &*t.begin());
+    }
+    CHECK(node_t::refs(root).refcount.load() == root_refs);
+    CHECK(node_t::refs(tail).refcount.load() == tail_refs);
+}
+
+} // anonymous namespace
+
+TEST_CASE("empty nodes are not reference counted")
+{
+    SECTION("vector")
+    {
+        check_empty_nodes_are_not_counted<
+            immer::vector<int, memory_t, B, BL>,
+            immer::detail::rbts::rbtree<int, memory_t, B, BL>>();
+    }
+
+    SECTION("flex_vector")
+    {
+        check_empty_nodes_are_not_counted<
+            immer::flex_vector<int, memory_t, B, BL>,
+            immer::detail::rbts::rrbtree<int, memory_t, B, BL>>();
+    }
+}
@@ -27,7 +27,9 @@
 #include <boost/range/adaptors.hpp>
 
 #include <algorithm>
+#include <atomic>
 #include <numeric>
+#include <unordered_set>
 #include <vector>
 
 #ifndef VECTOR_T
@@ -191,6 +193,70 @@ TEST_CASE("iterator")
         CHECK(50u  == *(i2 - 50));
         CHECK(-30  == (i2 - 30) - i2);
     }
+
+    SECTION("jumps back and forth")
+    {
+        auto iter = v.begin();
+        auto i = 0u;
+        for (auto k : test_irange(0u, n)) {
+            auto next = (i + 7919u * k) % n;
+            iter += static_cast<std::ptrdiff_t>(next) - i;
+            i = next;
+            CHECK(*iter == i);
+            CHECK(iter - v.begin() == static_cast<std::ptrdiff_t>(i));
+        }
+    }
+}
+
+TEST_CASE("hash")
+{
+    const auto n = 666u;
+    auto v = make_test_vector(0, n);
+    auto h = std::hash<VECTOR_T<unsigned>>{};
+
+    CHECK(h(v) == h(make_test_vector(0, n)));
+    CHECK(h(v) == immer::hash_value(v));
+    CHECK(h(VECTOR_T<unsigned>{}) == h(VECTOR_T<unsigned>{}));
+
+    SECTION("depends on the contents")
+    {
+        for (auto i : test_irange(0u, n)) {
+            CHECK(h(v.set(i, n)) != h(v));
+            CHECK(h(v.set(i, n).set(i, i)) == h(v));
+            CHECK(h(v.take(i)) == h(make_test_vector(0, i)));
+        }
+    }
+
+    SECTION("cached digests follow in place updates")
+    {
+        auto rebuilt = [] (const auto& x) {
+            auto r = VECTOR_T<unsigned>{};
+            for (auto e : x) r = r.push_back(e);
+            return r;
+        };
+        auto w = make_test_vector(0, n);
+        for (auto i : test_irange(0u, n)) {
+            CHECK(h(w) == h(rebuilt(w)));
+            w = std::move(w).set(i, n - i);
+        }
+        for (auto i : test_irange(0u, n))
+            w = std::move(w).push_back(i);
+        CHECK(h(w) == h(rebuilt(w)));
+        w = std::move(w).take(n / 2);
+        CHECK(h(w) == h(rebuilt(w)));
+        w = std::move(w).push_back(42u);
+        CHECK(h(w) == h(rebuilt(w)));
+    }
+
+    SECTION("works in unordered containers")
+    {
+        auto s = std::unordered_set<VECTOR_T<unsigned>>{};
+        for (auto i : test_irange(0u, n))
+            s.insert(v.take(i));
+        for (auto i : test_irange(0u, n))
+            CHECK(s.count(make_test_vector(0, i)) == 1);
+        CHECK(s.count(make_test_vector(1, 3)) == 0);
+    }
 }
 
 TEST_CASE("accumulate")
@@ -206,6 +272,273 @@ TEST_CASE("accumulate")
     }
 }
 
+TEST_CASE("for each chunk range")
+{
+    const auto n = 666u;
+    auto v = make_test_vector(0, n);
+
+    auto collect = [&] (auto first, auto last) {
+        auto r = std::vector<unsigned>{};
+        v.for_each_chunk(first, last, [&] (auto f, auto l) {
+            CHECK(f < l);
+            r.insert(r.end(), f, l);
+        });
+        return r;
+    };
+
+    SECTION("visits exactly the range")
+    {
+        for (auto first : test_irange(0u, n)) {
+            for (auto last = first; last <= n; last += 1 + last % 37) {
+                auto r = collect(first, last);
+                auto expected = std::vector<unsigned>(last - first);
+                std::iota(expected.begin(), expected.end(), first);
+                CHECK(r == expected);
+            }
+        }
+    }
+
+    SECTION("empty ranges")
+    {
+        CHECK(collect(0u, 0u).empty());
+        CHECK(collect(42u, 42u).empty());
+        CHECK(collect(n, n).empty());
+    }
+
+    SECTION("early exit")
+    {
+        for (auto stop : test_irange(1u, n)) {
+            auto count = 0u;
+            auto done = v.for_each_chunk_p([&] (auto f, auto l) {
+                for (; f != l; ++f)
+                    if (*f == stop) return false;
+                    else ++count;
+                return true;
+            });
+            CHECK(!done);
+            CHECK(count == stop);
+        }
+        CHECK(v.for_each_chunk_p([] (auto, auto) { return true; }));
+        auto next = 10u;
+        CHECK(v.for_each_chunk_p(10u, 20u, [&] (auto f, auto l) {
+            for (; f != l; ++f)
+                if (*f != next++) return false;
+            return true;
+        }));
+        CHECK(next == 20u);
+    }
+}
+
+TEST_CASE("parallel")
+{
+    const auto n = 666u;
+    auto v = make_test_vector(0, n);
+
+    SECTION("accumulate")
+    {
+        for (auto i : test_irange(0u, n)) {
+            auto vv = v.take(i);
+            CHECK(immer::parallel_accumulate(vv, 0u) ==
+                  immer::accumulate(vv, 0u));
+        }
+    }
+
+    SECTION("for each chunk")
+    {
+        std::atomic<std::size_t> count{0};
+        std::atomic<std::size_t> sum{0};
+        immer::parallel_for_each_chunk(v, [&] (auto first, auto last) {
+            count += last - first;
+            sum   += std::accumulate(first, last, std::size_t{});
+        });
+        CHECK(count == n);
+        CHECK(sum == n * (n - 1) / 2);
+    }
+
+    SECTION("transform reduce keeps order")
+    {
+        auto r = immer::parallel_transform_reduce(
+            v, std::vector<unsigned>{},
+            [] (auto a, auto b) {
+                a.insert(a.end(), b.begin(), b.end());
+                return a;
+            },
+            [] (auto x) { return std::vector<unsigned>{x}; });
+        CHECK_VECTOR_EQUALS(r, boost::irange(0u, n));
+    }
+
+    SECTION("custom executor")
+    {
+        auto tasks = 0u;
+        auto exec  = [&] (auto&& fn) { ++tasks; fn(); };
+        CHECK(immer::parallel_accumulate(v, 0u, std::plus<>{}, exec) ==
+              immer::accumulate(v, 0u));
+        CHECK(tasks > 0u);
+    }
+
+    SECTION("exceptions")
+    {
+        CHECK_THROWS_AS(
+            immer::parallel_for_each_chunk(v, [] (auto, auto) {
+                throw std::runtime_error{"boom"};
+            }),
+            std::runtime_error);
+    }
+}
+
+TEST_CASE("equals")
+{
+    const auto n = 666u;
+    auto v = make_test_vector(0, n);
+
+    CHECK(v == v);
+    CHECK(v == make_test_vector(0, n));
+    CHECK(v != v.push_back(42));
+    CHECK(v != v.take(n - 1));
+    CHECK(VECTOR_T<unsigned>{} == VECTOR_T<unsigned>{});
+    CHECK(VECTOR_T<unsigned>{} != v);
+
+    SECTION("one element changed")
+    {
+        for (auto i : test_irange(0u, n)) {
+            auto u = v.set(i, i + 1);
+            CHECK(u != v);
+            CHECK(v != u);
+            CHECK(u.set(i, i) == v);
+            CHECK(v == u.set(i, i));
+        }
+    }
+
+    SECTION("prefixes")
+    {
+        for (auto i : test_irange(1u, n)) {
+            auto u = v.take(i);
+            CHECK(u == make_test_vector(0, i));
+            CHECK(u != make_test_vector(1, i + 1));
+        }
+    }
+}
+
+TEST_CASE("from range")
+{
+    const auto n = 666u;
+
+    SECTION("iterators")
+    {
+        for (auto i : test_irange(0u, n)) {
+            auto r = boost::irange(0u, i);
+            auto v = VECTOR_T<unsigned>(r.begin(), r.end());
+            CHECK_VECTOR_EQUALS(v, r);
+            CHECK(v == make_test_vector(0, i));
+            CHECK(v.push_back(i) == make_test_vector(0, i + 1));
+        }
+    }
+
+    SECTION("trivially copyable")
+    {
+        auto r = std::vector<unsigned>(n);
+        std::iota(r.begin(), r.end(), 0u);
+        for (auto i : test_irange(0u, n)) {
+            auto v = VECTOR_T<unsigned>(r.data(), r.data() + i);
+            CHECK_VECTOR_EQUALS(v, boost::irange(0u, i));
+            auto w = VECTOR_T<unsigned>(r.begin(), r.begin() + i);
+            CHECK_VECTOR_EQUALS(w, boost::irange(0u, i));
+        }
+    }
+
+    SECTION("from_range")
+    {
+        auto r = std::vector<std::string>{};
+        for (auto i : test_irange(0u, n)) {
+            auto v = VECTOR_T<std::string>::from_range(r);
+            CHECK_VECTOR_EQUALS(v, r);
+            r.push_back(std::to_string(i));
+        }
+    }
+}
+
+TEST_CASE("diff")
+{
+    const auto n = 666u;
+    auto v = make_test_vector(0, n);
+
+    auto inserted    = std::vector<unsigned>{};
+    auto inserted_at = std::vector<std::size_t>{};
+    auto erased      = std::vector<unsigned>{};
+    auto erased_at   = std::vector<std::size_t>{};
+    auto changed     = std::vector<std::pair<unsigned, unsigned>>{};
+    auto changed_at  = std::vector<std::size_t>{};
+    auto do_diff     = [&] (auto a, auto b) {
+        inserted.clear();
+        inserted_at.clear();
+        erased.clear();
+        erased_at.clear();
+        changed.clear();
+        changed_at.clear();
+        immer::diff(a, b,
+                    [&] (auto i, auto x) {
+                        inserted_at.push_back(i);
+                        inserted.push_back(x);
+                    },
+                    [&] (auto i, auto x) {
+                        erased_at.push_back(i);
+                        erased.push_back(x);
+                    },
+                    [&] (auto i, auto x, auto y) {
+                        changed_at.push_back(i);
+                        changed.push_back({x, y});
+                    });
+    };
+
+    SECTION("same")
+    {
+        do_diff(v, v);
+        CHECK(inserted.empty());
+        CHECK(erased.empty());
+        CHECK(changed.empty());
+    }
+
+    SECTION("changes")
+    {
+        for (auto i : test_irange(0u, n)) {
+            do_diff(v, v.set(i, n));
+            CHECK(inserted.empty());
+            CHECK(erased.empty());
+            CHECK(changed.size() == 1);
+            CHECK(changed[0] == std::make_pair(i, n));
+            CHECK(changed_at[0] == i);
+        }
+    }
+
+    SECTION("push and take")
+    {
+        for (auto i : test_irange(0u, n)) {
+            auto u = v.take(i);
+            do_diff(u, v);
+            CHECK_VECTOR_EQUALS(inserted, boost::irange(i, n));
+            CHECK_VECTOR_EQUALS(inserted_at, boost::irange(i, n));
+            CHECK(erased.empty());
+            CHECK(changed.empty());
+            do_diff(v, u.push_back(n));
+            CHECK(inserted.empty());
+            CHECK_VECTOR_EQUALS(erased, boost::irange(i + 1, n));
+            CHECK_VECTOR_EQUALS(erased_at, boost::irange(i + 1, n));
+            CHECK(changed.size() == 1);
+            CHECK(changed_at == std::vector<std::size_t>{i});
+        }
+    }
+
+    SECTION("unrelated")
+    {
+        do_diff(v, make_test_vector(1, n + 2));
+        CHECK(inserted.size() == 1u);
+        CHECK(inserted_at == std::vector<std::size_t>{n});
+        CHECK(erased.empty());
+        CHECK(changed.size() == n);
+        CHECK_VECTOR_EQUALS(changed_at, boost::irange(0u, n));
+    }
+}
+
 TEST_CASE("vector of strings")
 {
     const auto n = 666u;
@@ -229,6 +562,7 @@ TEST_CASE("vector of strings")
 struct non_default
 {
     unsigned value;
+    non_default(unsigned v) : value{v} {}
     non_default() = delete;
     operator unsigned() const { return value; }
 
@@ -316,6 +650,26 @@ TEST_CASE("exception safety")
         IMMER_TRACE_E(d.happenings);
     }
 
+    SECTION("from range")
+    {
+        auto r = std::vector<dadaist<unsigned>>{};
+        for (auto i = 0u; i < n; ++i)
+            r.push_back({i});
+        auto d = dadaism{};
+        for (auto i = 0u; i < n;) {
+            auto s = d.next();
+            auto v = dadaist_vector_t{};
+            try {
+                v = dadaist_vector_t(r.begin(), r.begin() + i);
+                CHECK_VECTOR_EQUALS(v, boost::irange(0u, i++));
+            } catch (dada_error) {
+                CHECK_VECTOR_EQUALS(v, boost::irange(0u, 0u));
+            }
+        }
+        CHECK(d.happenings > 0);
+        IMMER_TRACE_E(d.happenings);
+    }
+
     SECTION("take")
     {
         auto v = make_test_vector<dadaist_vector_t>(0, n);
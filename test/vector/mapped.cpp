@@ -0,0 +1,180 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <immer/mapped_vector.hpp>
+#include <immer/vector_transient.hpp>
+
+#include <catch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+namespace {
+
+struct temp_file
+{
+    std::string path;
+
+    temp_file()
+    {
+        char name[] = "/tmp/immer-mapped-XXXXXX";
+        auto fd = ::mkstemp(name);
+        REQUIRE(fd >= 0);
+        ::close(fd);
+        path = name;
+    }
+
+    ~temp_file() { std::remove(path.c_str()); }
+};
+
+template <typename Vector>
+Vector make_test_vector(std::size_t n)
+{
+    auto v = Vector{};
+    for (auto i = 0u; i < n; ++i)
+        v = v.push_back(i);
+    return v;
+}
+
+template <typename Vector>
+void save(const std::string& path, const Vector& v)
+{
+    auto out = std::ofstream{path, std::ios::binary};
+    immer::write_mapped(out, v);
+}
+
+template <typename Vector>
+void check_test_vector(const Vector& v, std::size_t n)
+{
+    CHECK(v.size() == n);
+    for (auto i = 0u; i < n; ++i)
+        CHECK(v[i] == i);
+}
+
+} // anonymous namespace
+
+TEST_CASE("round trip")
+{
+    auto f = temp_file{};
+    for (auto n : { 0u, 1u, 32u, 33u, 666u, 1024u, 1057u, 40000u }) {
+        save(f.path, make_test_vector<immer::vector<unsigned>>(n));
+        immer::mapped_vector<unsigned> m{f.path};
+        check_test_vector(m.get(), n);
+    }
+}
+
+TEST_CASE("derived versions")
+{
+    auto f = temp_file{};
+    const auto n = 2000u;
+    save(f.path, make_test_vector<immer::vector<unsigned>>(n));
+
+    SECTION("update")
+    {
+        immer::mapped_vector<unsigned> m{f.path};
+        auto v = m.get().set(42, 0u).push_back(n).take(1500);
+        check_test_vector(m.get(), n);
+        CHECK(v.size() == 1500);
+        CHECK(v[42] == 0u);
+        CHECK(v[43] == 43u);
+    }
+
+    SECTION("transient")
+    {
+        immer::mapped_vector<unsigned> m{f.path};
+        auto t = m.get().transient();
+        for (auto i = 0u; i < n; ++i)
+            t.set(i, n - i);
+        t.push_back(n);
+        auto v = t.persistent();
+        check_test_vector(m.get(), n);
+        CHECK(v.size() == n + 1);
+        CHECK(v[0] == n);
+        CHECK(v[n] == n);
+    }
+
+    SECTION("copies outlive their derived versions")
+    {
+        immer::mapped_vector<unsigned> m{f.path};
+        auto v = immer::vector<unsigned>{};
+        {
+            auto c = m.get();
+            v = c.push_back(n);
+        }
+        CHECK(v.size() == n + 1);
+        CHECK(v[n - 1] == n - 1);
+        check_test_vector(m.get(), n);
+    }
+}
+
+TEST_CASE("errors")
+{
+    auto f = temp_file{};
+
+    SECTION("missing file")
+    {
+        CHECK_THROWS_AS(immer::mapped_vector<unsigned>{f.path + ".none"},
+                        std::system_error);
+    }
+
+    SECTION("not a mapped vector")
+    {
+        {
+            auto out = std::ofstream{f.path, std::ios::binary};
+            out << "not a mapped vector, but long enough to contain a header"
+                << std::string(128, '!');
+        }
+        CHECK_THROWS_AS(immer::mapped_vector<unsigned>{f.path},
+                        immer::mapped_error);
+    }
+
+    SECTION("different type")
+    {
+        save(f.path, make_test_vector<immer::vector<unsigned>>(100));
+        using other_t = immer::mapped_vector<unsigned long long>;
+        CHECK_THROWS_AS(other_t{f.path}, immer::mapped_error);
+    }
+
+    SECTION("truncated")
+    {
+        save(f.path, make_test_vector<immer::vector<unsigned>>(10000));
+        REQUIRE(::truncate(f.path.c_str(), 4096) == 0);
+        CHECK_THROWS_AS(immer::mapped_vector<unsigned>{f.path},
+                        immer::mapped_error);
+    }
+
+    SECTION("size too big")
+    {
+        save(f.path, make_test_vector<immer::vector<unsigned>>(100));
+        {
+            using header_t = immer::detail::rbts::mapped_header<int>;
+            auto size = std::uint64_t{1} << 40;
+            auto out = std::fstream{f.path, std::ios::binary |
+                                    std::ios::in | std::ios::out};
+            out.seekp(offsetof(header_t, size));
+            out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        }
+        CHECK_THROWS_AS(immer::mapped_vector<unsigned>{f.path},
+                        immer::mapped_error);
+    }
+}
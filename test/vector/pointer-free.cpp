@@ -0,0 +1,129 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include <immer/vector.hpp>
+#include <immer/vector_transient.hpp>
+#include <immer/heap/malloc_heap.hpp>
+
+#include <catch.hpp>
+
+#include <string>
+
+namespace {
+
+struct norefs_counting_heap
+{
+    static std::size_t norefs;
+    static std::size_t refs;
+
+    static void* allocate(std::size_t size)
+    {
+        ++refs;
+        return immer::malloc_heap::allocate(size);
+    }
+
+    static void* allocate(std::size_t size, immer::norefs_tag)
+    {
+        ++norefs;
+        return immer::malloc_heap::allocate(size);
+    }
+
+    template <typename... Tags>
+    static void deallocate(void* data, Tags...)
+    { immer::malloc_heap::deallocate(data); }
+};
+
+std::size_t norefs_counting_heap::norefs = 0;
+std::size_t norefs_counting_heap::refs   = 0;
+
+using counting_memory = immer::memory_policy<
+    immer::heap_policy<norefs_counting_heap>,
+    immer::no_refcount_policy,
+    immer::gc_transience_policy,
+    false>;
+
+template <typename T>
+using counting_vector = immer::vector<T, counting_memory>;
+
+struct point { double x, y; };
+
+template <typename Vector, typename Fn>
+void count_allocations(std::size_t n, Fn make_value)
+{
+    norefs_counting_heap::norefs = 0;
+    norefs_counting_heap::refs   = 0;
+    auto v = Vector{};
+    for (auto i = 0u; i < n; ++i)
+        v = v.push_back(make_value(i));
+}
+
+} // anonymous namespace
+
+namespace immer {
+
+template <>
+struct is_pointer_free<point> : std::true_type {};
+
+} // namespace immer
+
+TEST_CASE("pointer free leaves")
+{
+    SECTION("arithmetic")
+    {
+        CHECK(immer::is_pointer_free<int>::value);
+        CHECK(immer::is_pointer_free<double>::value);
+        CHECK(!immer::is_pointer_free<int*>::value);
+        CHECK(!immer::is_pointer_free<std::string>::value);
+    }
+
+    SECTION("leaves of ints are not scanned")
+    {
+        count_allocations<counting_vector<int>>(
+            1000, [] (auto i) { return int(i); });
+        CHECK(norefs_counting_heap::norefs > 0);
+    }
+
+    SECTION("leaves of specialized types are not scanned")
+    {
+        count_allocations<counting_vector<point>>(
+            1000, [] (auto i) { return point{ double(i), double(i) }; });
+        CHECK(norefs_counting_heap::norefs > 0);
+    }
+
+    SECTION("leaves of pointers are scanned")
+    {
+        count_allocations<counting_vector<int*>>(
+            1000, [] (auto) { return nullptr; });
+        CHECK(norefs_counting_heap::norefs == 0);
+    }
+
+    SECTION("transient leaves are scanned while they keep the token")
+    {
+        auto t = counting_vector<int>{}.transient();
+        norefs_counting_heap::norefs = 0;
+        for (auto i = 0; i < 1000; ++i)
+            t.push_back(i);
+        CHECK(norefs_counting_heap::norefs == 0);
+        auto v = t.persistent();
+        CHECK(v.size() == 1000);
+        CHECK(v[999] == 999);
+    }
+}
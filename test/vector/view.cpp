@@ -0,0 +1,130 @@
+//
+// immer - immutable data structures for C++
+// Copyright (C) 2016, 2017 Juan Pedro Bolivar Puente
+//
+// This file is part of immer.
+//
+// immer is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// immer is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with immer.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include <immer/vector_view.hpp>
+#include <immer/flex_vector_view.hpp>
+#include <immer/algorithm.hpp>
+
+#include <catch.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+namespace {
+
+template <typename Vector>
+Vector make_test_vector(std::size_t n)
+{
+    auto v = Vector{};
+    for (auto i = 0u; i < n; ++i)
+        v = v.push_back(i);
+    return v;
+}
+
+template <typename View, typename Vector>
+void check_view(const Vector& v)
+{
+    using node_t = typename std::decay_t<decltype(v.impl())>::node_t;
+    auto root_refs = node_t::refs(v.impl().root).refcount.load();
+    auto tail_refs = node_t::refs(v.impl().tail).refcount.load();
+
+    auto views = std::vector<View>(42, View{v});
+    for (auto& x : views) {
+        CHECK(x.size() == v.size());
+        CHECK(x.empty() == v.empty());
+        for (auto i = 0u; i < x.size(); ++i)
+            CHECK(x[i] == i);
+        CHECK(std::equal(x.begin(), x.end(), v.begin(), v.end()));
+        CHECK(std::equal(x.rbegin(), x.rend(), v.rbegin(), v.rend()));
+        auto sum = 0u;
+        x.for_each_chunk([&] (auto f, auto l) {
+            sum = std::accumulate(f, l, sum);
+        });
+        CHECK(sum == immer::accumulate(v, 0u));
+    }
+    CHECK(node_t::refs(v.impl().root).refcount.load() == root_refs);
+    CHECK(node_t::refs(v.impl().tail).refcount.load() == tail_refs);
+
+    Vector owned = views.front();
+    CHECK(owned == v);
+    CHECK(views.back().get() == v);
+}
+
+} // anonymous namespace
+
+TEST_CASE("vector_view")
+{
+    using vector_t = immer::vector<unsigned>;
+    using view_t   = immer::vector_view<unsigned>;
+
+    SECTION("empty")  { check_view<view_t>(vector_t{}); }
+    SECTION("small")  { check_view<view_t>(make_test_vector<vector_t>(10)); }
+    SECTION("big")    { check_view<view_t>(make_test_vector<vector_t>(1000)); }
+
+    SECTION("owned value outlives the view")
+    {
+        auto owned = vector_t{};
+        {
+            auto v = make_test_vector<vector_t>(1000);
+            owned = view_t{v};
+        }
+        CHECK(owned.size() == 1000);
+        CHECK(owned[999] == 999);
+    }
+
+    SECTION("viewed object goes away while its value is owned")
+    {
+        auto v = make_test_vector<vector_t>(1000);
+        auto x = [&] {
+            auto copy = v;
+            return view_t{copy};
+        }();
+        CHECK(x.size() == 1000);
+        CHECK(x[999] == 999);
+        CHECK(x.get() == v);
+    }
+
+    SECTION("algorithms")
+    {
+        auto v = make_test_vector<vector_t>(1000);
+        auto x = view_t{v};
+        CHECK(immer::accumulate(x, 0u) == 999u * 1000u / 2u);
+        CHECK(immer::parallel_accumulate(x, 0u) == 999u * 1000u / 2u);
+    }
+}
+
+TEST_CASE("flex_vector_view")
+{
+    using vector_t = immer::flex_vector<unsigned>;
+    using view_t   = immer::flex_vector_view<unsigned>;
+
+    SECTION("empty")  { check_view<view_t>(vector_t{}); }
+    SECTION("small")  { check_view<view_t>(make_test_vector<vector_t>(10)); }
+    SECTION("big")    { check_view<view_t>(make_test_vector<vector_t>(1000)); }
+
+    SECTION("relaxed")
+    {
+        auto v = make_test_vector<vector_t>(1000);
+        v = v.drop(1).push_front(0u) + v.drop(1000);
+        check_view<view_t>(v);
+    }
+}